@@ -52,6 +52,8 @@
  */
 slist_tpl <weg_t *> alle_wege;
 
+uint16 weg_t::current_statistics_month = 0;
+
 
 /**
  * Get list of all ways
@@ -173,6 +175,7 @@ void weg_t::init_statistics()
 			statistics[month][type] = 0;
 		}
 	}
+	statistics_month = current_statistics_month;
 }
 
 
@@ -242,6 +245,9 @@ void weg_t::rdwr(loadsave_t *file)
 		}
 	}
 
+	if(  file->is_saving()  ) {
+		roll_statistics();
+	}
 	for(  int type=0;  type<MAX_WAY_STATISTICS;  type++  ) {
 		for(  int month=0;  month<MAX_WAY_STAT_MONTHS;  month++  ) {
 			sint32 w = statistics[month][type];
@@ -250,6 +256,7 @@ void weg_t::rdwr(loadsave_t *file)
 			// DBG_DEBUG("weg_t::rdwr()", "statistics[%d][%d]=%d", month, type, statistics[month][type]);
 		}
 	}
+	statistics_month = current_statistics_month;
 
 	if(file->get_experimental_version() >= 1)
 	{
@@ -327,13 +334,13 @@ void weg_t::info(cbuffer_t & buf) const
 	}
 
 #if 1
-	buf.printf(translator::translate("convoi passed last\nmonth %i\n"), statistics[1][1]);
+	buf.printf(translator::translate("convoi passed last\nmonth %i\n"), get_statistics(1, 1));
 #else
 	// Debug - output stats
 	buf.append("\n");
 	for (int type=0; type<MAX_WAY_STATISTICS; type++) {
 		for (int month=0; month<MAX_WAY_STAT_MONTHS; month++) {
-			buf.printf("%d ", statistics[month][type]);
+			buf.printf("%d ", get_statistics(month, type));
 		}
 	buf.append("\n");
 	}
@@ -639,14 +646,15 @@ void weg_t::check_diagonal()
  * new month
  * @author hsiegeln
  */
-void weg_t::neuer_monat()
+void weg_t::roll_statistics()
 {
+	const uint16 age = current_statistics_month - statistics_month;
 	for (int type=0; type<MAX_WAY_STATISTICS; type++) {
-		for (int month=MAX_WAY_STAT_MONTHS-1; month>0; month--) {
-			statistics[month][type] = statistics[month-1][type];
+		for (int month=MAX_WAY_STAT_MONTHS-1; month>=0; month--) {
+			statistics[month][type] = month >= age ? statistics[month-age][type] : 0;
 		}
-		statistics[0][type] = 0;
 	}
+	statistics_month = current_statistics_month;
 }
 
 
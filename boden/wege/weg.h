@@ -79,6 +79,17 @@ private:
 	*/
 	sint16 statistics[MAX_WAY_STAT_MONTHS][MAX_WAY_STATISTICS];
 
+	/**
+	* The statistics are rolled over lazily: statistics[0] belongs to the month
+	* statistics_month, which is compared with current_statistics_month.
+	* Saves iterating all ways at the start of each month.
+	*/
+	uint16 statistics_month;
+	static uint16 current_statistics_month;
+
+	// brings statistics up to current_statistics_month
+	void roll_statistics();
+
 	/**
 	* Way type description
 	* @author Hj. Malthaner
@@ -295,20 +306,36 @@ public:
 	* book statistics - is called very often and therefore inline
 	* @author hsiegeln
 	*/
-	void book(int amount, way_statistics type) { statistics[0][type] += amount; }
+	void book(int amount, way_statistics type)
+	{
+		if(  statistics_month != current_statistics_month  ) {
+			roll_statistics();
+		}
+		statistics[0][type] += amount;
+	}
+
+	/**
+	* return statistics value of the given month (0 = current month)
+	*/
+	int get_statistics(int month, int type) const
+	{
+		const int age = (uint16)(current_statistics_month - statistics_month);
+		return month >= age ? statistics[month - age][type] : 0;
+	}
 
 	/**
 	* return statistics value
 	* always returns last month's value
 	* @author hsiegeln
 	*/
-	int get_statistics(int type) const { return statistics[1][type]; }
+	int get_statistics(int type) const { return get_statistics(1, type); }
 
 	/**
-	* new month
+	* new month for the statistics of all ways
+	* (each way rolls its values over when it is next booked or saved)
 	* @author hsiegeln
 	*/
-	void neuer_monat();
+	static void neuer_monat() { current_statistics_month++; }
 
 	void check_diagonal();
 
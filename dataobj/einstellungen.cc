@@ -1395,6 +1395,8 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 	umgebung_t::show_names = contents.get_int("show_names", umgebung_t::show_names );
 	umgebung_t::show_month = contents.get_int("show_month", umgebung_t::show_month );
 	umgebung_t::max_acceleration = contents.get_int("fast_forward", umgebung_t::max_acceleration );
+	umgebung_t::num_threads = clamp( contents.get_int("threads", umgebung_t::num_threads ), 1, 33 );
+	umgebung_t::sparse_path_matrix = contents.get_int("sparse_path_matrix", umgebung_t::sparse_path_matrix )!=0;
 	umgebung_t::fps = contents.get_int("frames_per_second",umgebung_t::fps );
 	umgebung_t::simple_drawing_tile_size = contents.get_int("simple_drawing_tile_size",umgebung_t::simple_drawing_tile_size );
 	umgebung_t::visualize_schedule = contents.get_int("visualize_schedule",umgebung_t::visualize_schedule )!=0;
@@ -1405,7 +1407,9 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 	umgebung_t::additional_client_frames_behind = contents.get_int("additional_client_frames_behind", umgebung_t::additional_client_frames_behind);
 	umgebung_t::network_frames_per_step = contents.get_int("server_frames_per_step", umgebung_t::network_frames_per_step );
 	umgebung_t::server_sync_steps_between_checks = contents.get_int("server_frames_between_checks", umgebung_t::server_sync_steps_between_checks );
+	umgebung_t::dump_state_digest = contents.get_int("dump_state_digest", umgebung_t::dump_state_digest )!=0;
 	umgebung_t::pause_server_no_clients = contents.get_int("pause_server_no_clients", umgebung_t::pause_server_no_clients );
+	umgebung_t::network_thread = contents.get_int("network_thread", umgebung_t::network_thread )!=0;
 
 	umgebung_t::server_announce = contents.get_int("announce_server", umgebung_t::server_announce );
 	umgebung_t::server_announce = contents.get_int("server_announce", umgebung_t::server_announce );
@@ -1582,6 +1586,7 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 	}
 
 	umgebung_t::autosave = (contents.get_int("autosave", umgebung_t::autosave) );
+	umgebung_t::background_save = contents.get_int("background_save", umgebung_t::background_save )!=0;
 
 	// routing stuff
 	uint16 city_short_range_percentage = passenger_routing_local_chance;
@@ -2064,6 +2069,10 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 		loadsave_t::set_savemode(loadsave_t::bzip2 );
 	} else if(strcmp(str, "xml_bzip2") == 0) {
 		loadsave_t::set_savemode(loadsave_t::xml_bzip2 );
+	} else if(strcmp(str, "zipped_blocks") == 0) {
+		loadsave_t::set_savemode(loadsave_t::zipped_blocks );
+	} else if(strcmp(str, "xml_zipped_blocks") == 0) {
+		loadsave_t::set_savemode(loadsave_t::xml_zipped_blocks );
 	}
 
 	/*
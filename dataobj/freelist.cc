@@ -12,6 +12,17 @@
 #include <valgrind/memcheck.h>
 #endif
 
+// worker threads allocate list nodes too (see utils/worker_pool.h)
+#ifdef MULTI_THREAD
+#include <pthread.h>
+static pthread_mutex_t freelist_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define FREELIST_LOCK() pthread_mutex_lock( &freelist_mutex )
+#define FREELIST_UNLOCK() pthread_mutex_unlock( &freelist_mutex )
+#else
+#define FREELIST_LOCK()
+#define FREELIST_UNLOCK()
+#endif
+
 
 struct nodelist_node_t
 {
@@ -88,6 +99,8 @@ void *freelist_t::gimme_node(size_t size)
 		list = &(all_lists[size/4]);
 	}
 
+	FREELIST_LOCK();
+
 	// need new memory?
 	if(*list==NULL) {
 		int num_elements = 32764/(int)size;
@@ -135,6 +148,8 @@ void *freelist_t::gimme_node(size_t size)
 	VALGRIND_MAKE_MEM_UNDEFINED(tmp, size);
 #endif // valgrind
 
+	FREELIST_UNLOCK();
+
 	return (void *)tmp;
 }
 
@@ -180,8 +195,10 @@ void freelist_t::putback_node( size_t size, void *p )
 
 	// putback to first node
 	nodelist_node_t *tmp = (nodelist_node_t *)p;
+	FREELIST_LOCK();
 	tmp->next = *list;
 	*list = tmp;
+	FREELIST_UNLOCK();
 }
 
 
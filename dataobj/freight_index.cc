@@ -0,0 +1,104 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "../simware.h"
+#include "freight_index.h"
+
+
+template<class key_t>
+static void add_position(inthashtable_tpl<key_t, vector_tpl<uint32> > &table, key_t key, uint32 pos)
+{
+	vector_tpl<uint32> *list = table.access( key );
+	if(  list == NULL  ) {
+		table.put( key );
+		list = table.access( key );
+	}
+	if(  list->empty()  ||  list->back() < pos  ) {
+		// the usual case: appended to the array
+		list->append( pos );
+	}
+	else {
+		list->insert_at( std::lower_bound( list->begin(), list->end(), pos ) - list->begin(), pos );
+	}
+}
+
+
+template<class key_t>
+static void remove_position(inthashtable_tpl<key_t, vector_tpl<uint32> > &table, key_t key, uint32 pos)
+{
+	vector_tpl<uint32> *list = table.access( key );
+	if(  list == NULL  ) {
+		return;
+	}
+	uint32 *const i = std::lower_bound( list->begin(), list->end(), pos );
+	if(  i != list->end()  &&  *i == pos  ) {
+		list->remove_at( i - list->begin() );
+	}
+	if(  list->empty()  ) {
+		table.remove( key );
+	}
+}
+
+
+uint32 freight_index_t::get_destination_key(const ware_t &ware)
+{
+	return ware.get_ziel().get_id() | ((uint32)ware.get_origin().get_id() << 16);
+}
+
+
+freight_index_t::freight_index_t(const vector_tpl<ware_t> &warray)
+{
+	for(  uint32 pos = 0;  pos < warray.get_count();  pos++  ) {
+		set_entry( pos, NULL, warray[pos] );
+		if(  warray[pos].menge == 0  ) {
+			set_empty( pos );
+		}
+	}
+}
+
+
+void freight_index_t::set_entry(uint32 pos, const ware_t *old, const ware_t &neu)
+{
+	if(  old  ) {
+		remove_position( by_transfer, old->get_zwischenziel().get_id(), pos );
+		remove_position( by_destination, get_destination_key( *old ), pos );
+	}
+	add_position( by_transfer, neu.get_zwischenziel().get_id(), pos );
+	add_position( by_destination, get_destination_key( neu ), pos );
+}
+
+
+void freight_index_t::change_transfer(uint32 pos, halthandle_t old_transfer, halthandle_t new_transfer)
+{
+	if(  old_transfer != new_transfer  ) {
+		remove_position( by_transfer, old_transfer.get_id(), pos );
+		add_position( by_transfer, new_transfer.get_id(), pos );
+	}
+}
+
+
+void freight_index_t::set_empty(uint32 pos)
+{
+	free_entries.append( pos );
+	std::push_heap( free_entries.begin(), free_entries.end(), std::greater<uint32>() );
+}
+
+
+bool freight_index_t::take_empty(const vector_tpl<ware_t> &warray, uint32 &pos)
+{
+	while(  !free_entries.empty()  ) {
+		std::pop_heap( free_entries.begin(), free_entries.end(), std::greater<uint32>() );
+		pos = free_entries.back();
+		free_entries.pop_back();
+		// skip entries which were filled again in the meantime
+		if(  pos < warray.get_count()  &&  warray[pos].menge == 0  ) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#ifndef dataobj_freight_index_h
+#define dataobj_freight_index_h
+
+#include "../simtypes.h"
+#include "../halthandle_t.h"
+#include "../tpl/vector_tpl.h"
+#include "../tpl/inthashtable_tpl.h"
+
+class ware_t;
+
+
+/**
+ * Index over the waiting goods of one category at a halt, i.e. over the
+ * packets in haltestelle_t::waren[catg]. The packets stay where they are
+ * (so the order in the array and the savegame do not change); the index
+ * only knows their positions:
+ *  - by next transfer, for loading a convoy (hole_ab)
+ *  - by destination and origin, for merging arriving packets
+ *  - the empty entries, which are reused before the array grows
+ * The position lists are ascending, so searching them finds the same
+ * packet as scanning the whole array. Empty entries stay in the lists
+ * of the packet they held last.
+ *
+ * A halt keeps an index only for arrays of at least MIN_PACKETS entries;
+ * for smaller ones scanning the array is just as fast.
+ */
+class freight_index_t
+{
+public:
+	enum { MIN_PACKETS = 64 };
+
+private:
+	inthashtable_tpl<uint16, vector_tpl<uint32> > by_transfer;
+	inthashtable_tpl<uint32, vector_tpl<uint32> > by_destination;
+
+	// the empty entries as heap with the lowest position on top
+	vector_tpl<uint32> free_entries;
+
+	static uint32 get_destination_key(const ware_t &ware);
+
+public:
+	freight_index_t(const vector_tpl<ware_t> &warray);
+
+	/**
+	 * The entry at pos was appended (old==NULL) or replaced by neu.
+	 */
+	void set_entry(uint32 pos, const ware_t *old, const ware_t &neu);
+
+	/**
+	 * The next transfer of the packet at pos was changed by merging.
+	 */
+	void change_transfer(uint32 pos, halthandle_t old_transfer, halthandle_t new_transfer);
+
+	/**
+	 * The packet at pos was taken away (its menge is now zero).
+	 */
+	void set_empty(uint32 pos);
+
+	/**
+	 * Removes the lowest empty entry from the free list.
+	 * @return false, if there is no empty entry
+	 */
+	bool take_empty(const vector_tpl<ware_t> &warray, uint32 &pos);
+
+	// positions of the packets to this next transfer (ascending) or NULL
+	const vector_tpl<uint32> *get_transfer_entries(halthandle_t transfer) { return by_transfer.access( transfer.get_id() ); }
+
+	// positions of the packets with the destination and origin of ware (ascending) or NULL
+	const vector_tpl<uint32> *get_destination_entries(const ware_t &ware) { return by_destination.access( get_destination_key( ware ) ); }
+};
+
+#endif
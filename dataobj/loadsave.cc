@@ -12,6 +12,9 @@
 #include "../simmem.h"
 #include "../simdebug.h"
 #include "../utils/plainstring.h"
+#include "../utils/worker_pool.h"
+#include "../utils/simthread.h"
+#include "../tpl/vector_tpl.h"
 #include "loadsave.h"
 
 #include "../utils/simstring.h"
@@ -21,33 +24,315 @@
 
 #define INVALID_RDWR_ID (-1)
 
+
+/*
+ * zipped_blocks format:
+ *   "SBLK", block size
+ *   per block: compressed length, uncompressed length, zlib data
+ *   0, 0
+ *   index: compressed and uncompressed length of each block, number of blocks, "SBLK"
+ *   optionally the table of contents:
+ *     number of sections, per section: name length, name, offset in the uncompressed data
+ *     number of infos, per info: name length, name, data length, data
+ *     length of the table of contents, "STOC"
+ * All numbers are 32 bit little endian.
+ */
+// size of loadsave_t::io_buffer
+#define IO_BUFFER_SIZE (256*1024)
+
+// size of the memory chunks of background saving
+#define MEMORY_CHUNK_SIZE (1024*1024)
+
+#define BLOCKS_MAGIC "SBLK"
+#define BLOCKS_SIZE (1024*1024)
+#define TOC_MAGIC "STOC"
+
+// one block of the zipped_blocks format, (de)compressed by a worker thread
+struct loadsave_block_t : public worker_job_t
+{
+	Bytef *raw;
+	uint32 raw_len;
+	Bytef *zipped;
+	uLongf zipped_len;
+	bool compress;
+	bool ok;
+
+	// while reading: the block has been waited for, and position of the next byte
+	bool ready;
+	uint32 read_pos;
+
+	loadsave_block_t() : raw(NULL), raw_len(0), zipped(NULL), zipped_len(0), compress(true), ok(true), ready(false), read_pos(0) {}
+
+	~loadsave_block_t()
+	{
+		free(raw);
+		free(zipped);
+	}
+
+	virtual void run()
+	{
+		if(  compress  ) {
+			uLongf len = compressBound(raw_len);
+			ok = ::compress( zipped, &len, raw, raw_len )==Z_OK;
+			zipped_len = len;
+		}
+		else {
+			uLongf len = BLOCKS_SIZE;
+			ok = uncompress( raw, &len, zipped, zipped_len )==Z_OK  &&  len==raw_len;
+		}
+	}
+};
+
+
+static void put_uint32(FILE *fp, uint32 v)
+{
+	const uint8 buf[4] = { (uint8)v, (uint8)(v>>8), (uint8)(v>>16), (uint8)(v>>24) };
+	fwrite( buf, 1, 4, fp );
+}
+
+static bool get_uint32(FILE *fp, uint32 &v)
+{
+	uint8 buf[4];
+	if(  fread( buf, 1, 4, fp )!=4  ) {
+		return false;
+	}
+	v = buf[0] | (buf[1]<<8) | (buf[2]<<16) | ((uint32)buf[3]<<24);
+	return true;
+}
+
+static void put_string(FILE *fp, const std::string &str)
+{
+	put_uint32( fp, str.size() );
+	fwrite( str.data(), 1, str.size(), fp );
+}
+
+static bool get_string(FILE *fp, std::string &str, uint32 max_len)
+{
+	uint32 len;
+	if(  !get_uint32( fp, len )  ||  len>max_len  ) {
+		return false;
+	}
+	str.resize( len );
+	return len==0  ||  fread( &str[0], 1, len, fp )==len;
+}
+
+
+// table of contents of the zipped_blocks format, see loadsave_t::begin_section()
+struct loadsave_toc_t
+{
+	vector_tpl<std::string> section_names;
+	vector_tpl<uint32> section_offsets;
+	vector_tpl<std::string> info_names;
+	vector_tpl<std::string> info_data;
+
+	// reading: position in the file and in the uncompressed data of each block
+	vector_tpl<uint32> block_file_pos;
+	vector_tpl<uint32> block_data_pos;
+	bool loaded;
+
+	loadsave_toc_t() : loaded(false) {}
+
+	void clear()
+	{
+		section_names.clear();
+		section_offsets.clear();
+		info_names.clear();
+		info_data.clear();
+		block_file_pos.clear();
+		block_data_pos.clear();
+		loaded = false;
+	}
+
+	bool empty() const { return section_names.empty()  &&  info_names.empty(); }
+
+	void write(FILE *fp) const
+	{
+		const long start = ftell( fp );
+		put_uint32( fp, section_names.get_count() );
+		for(  uint32 i=0;  i<section_names.get_count();  i++  ) {
+			put_string( fp, section_names[i] );
+			put_uint32( fp, section_offsets[i] );
+		}
+		put_uint32( fp, info_names.get_count() );
+		for(  uint32 i=0;  i<info_names.get_count();  i++  ) {
+			put_string( fp, info_names[i] );
+			put_string( fp, info_data[i] );
+		}
+		put_uint32( fp, (uint32)(ftell( fp )-start) );
+		fwrite( TOC_MAGIC, 1, 4, fp );
+	}
+
+	/**
+	 * reads the table of contents and the block index from the end of the file
+	 * @return false if there is none (or the file is broken)
+	 */
+	bool read(FILE *fp)
+	{
+		clear();
+		char magic[4];
+		uint32 toc_len, block_count;
+		if(  fseek( fp, -8, SEEK_END )!=0  ||  !get_uint32( fp, toc_len )  ||  fread( magic, 1, 4, fp )!=4  ||  memcmp( magic, TOC_MAGIC, 4 )!=0  ) {
+			return false;
+		}
+		const long toc_start = ftell( fp ) - 8 - (long)toc_len;
+		// block index in front of it
+		if(  toc_start<16  ||  fseek( fp, toc_start-8, SEEK_SET )!=0  ||  !get_uint32( fp, block_count )  ||  fread( magic, 1, 4, fp )!=4  ||  memcmp( magic, BLOCKS_MAGIC, 4 )!=0
+		     ||  (long)block_count*8 > toc_start-8  ||  fseek( fp, toc_start-8-(long)block_count*8, SEEK_SET )!=0  ) {
+			return false;
+		}
+		uint32 file_pos = 8, data_pos = 0;
+		for(  uint32 i=0;  i<block_count;  i++  ) {
+			uint32 zipped_len, raw_len;
+			if(  !get_uint32( fp, zipped_len )  ||  !get_uint32( fp, raw_len )  ) {
+				return false;
+			}
+			block_file_pos.append( file_pos );
+			block_data_pos.append( data_pos );
+			file_pos += 8 + zipped_len;
+			data_pos += raw_len;
+		}
+		// the end of the data
+		block_data_pos.append( data_pos );
+
+		uint32 count;
+		if(  fseek( fp, toc_start, SEEK_SET )!=0  ||  !get_uint32( fp, count )  ) {
+			return false;
+		}
+		for(  uint32 i=0;  i<count;  i++  ) {
+			std::string name;
+			uint32 offset;
+			if(  !get_string( fp, name, toc_len )  ||  !get_uint32( fp, offset )  ) {
+				return false;
+			}
+			section_names.append( name );
+			section_offsets.append( offset );
+		}
+		if(  !get_uint32( fp, count )  ) {
+			return false;
+		}
+		for(  uint32 i=0;  i<count;  i++  ) {
+			std::string name, data;
+			if(  !get_string( fp, name, toc_len )  ||  !get_string( fp, data, toc_len )  ) {
+				return false;
+			}
+			info_names.append( name );
+			info_data.append( data );
+		}
+		loaded = true;
+		return true;
+	}
+};
+
+
 struct file_descriptors_t {
 	FILE *fp;
 	gzFile gzfp;
 	BZFILE *bzfp;
 	int bse;
-	file_descriptors_t() : fp(NULL), gzfp(NULL), bzfp(NULL), bse(BZ_OK+1) {}
+
+	// zipped_blocks: ring of blocks, the oldest of the pending (submitted) ones is blocks[first]
+	loadsave_block_t *blocks;
+	uint32 block_count;
+	uint32 first;
+	uint32 pending;
+	bool blocks_end;  // reading: no more blocks in the file
+	bool blocks_error;
+	vector_tpl<uint32> blocks_index;  // writing: lengths of the blocks written
+	loadsave_toc_t toc;
+	uint32 data_pos;  // writing: uncompressed bytes written so far
+	loadsave_stream_t *stream;  // writing: copy of the file, reading: instead of the file
+
+	// background saving: the data written so far; only the last chunk is not full
+	bool in_memory;
+	vector_tpl<char *> memory;
+	uint32 memory_fill;
+
+	file_descriptors_t() : fp(NULL), gzfp(NULL), bzfp(NULL), bse(BZ_OK+1),
+		blocks(NULL), block_count(0), first(0), pending(0), blocks_end(false), blocks_error(false), data_pos(0), stream(NULL),
+		in_memory(false), memory_fill(MEMORY_CHUNK_SIZE) {}
+
+	~file_descriptors_t()
+	{
+		delete [] blocks;
+		FOR(vector_tpl<char *>, const chunk, memory) {
+			free( chunk );
+		}
+	}
+
+	void init_blocks()
+	{
+		delete [] blocks;
+		// enough blocks to keep all threads busy, and one to fill meanwhile
+		block_count = worker_pool_t::get_thread_count()+2;
+		blocks = new loadsave_block_t[block_count];
+		for(  uint32 i=0;  i<block_count;  i++  ) {
+			blocks[i].raw = MALLOCN( Bytef, BLOCKS_SIZE );
+			blocks[i].zipped = MALLOCN( Bytef, compressBound(BLOCKS_SIZE) );
+		}
+		first = pending = 0;
+		blocks_end = blocks_error = false;
+		blocks_index.clear();
+	}
+
+	void term_blocks()
+	{
+		if(  blocks  ) {
+			// nothing must be left running
+			for(  uint32 i=0;  i<block_count;  i++  ) {
+				worker_pool_t::wait( blocks+i );
+			}
+			delete [] blocks;
+			blocks = NULL;
+		}
+		block_count = 0;
+	}
+
+	loadsave_block_t &current() { return blocks[(first+pending)%block_count]; }
 };
 
 
 loadsave_t::mode_t loadsave_t::save_mode = bzip2;	// default to use for saving
 
+#ifdef MULTI_THREAD
+static pthread_t background_thread;
+static bool background_thread_running = false;
+#endif
+
+
+void loadsave_t::wait_for_background_save()
+{
+#ifdef MULTI_THREAD
+	if(  background_thread_running  ) {
+		pthread_join( background_thread, NULL );
+		background_thread_running = false;
+	}
+#endif
+}
+
+
 loadsave_t::loadsave_t() : filename()
 {
 	mode = 0;
 	saving = false;
 	fd = new file_descriptors_t();
+	io_buffer = MALLOCN( uint8, IO_BUFFER_SIZE );
+	io_pos = io_end = 0;
 }
 
 loadsave_t::~loadsave_t()
 {
 	close();
 	delete fd;
+	free( io_buffer );
 }
 
 bool loadsave_t::rd_open(const char *filename)
 {
 	close();
+	// it might be the file still being written
+	wait_for_background_save();
+	io_pos = io_end = 0;
+	fd->toc.clear();
 
 	version = 0;
 	mode = zipped;
@@ -63,9 +348,17 @@ bool loadsave_t::rd_open(const char *filename)
 		if(  buf[0]=='B'  &&  buf[1]=='Z'  ) {
 			mode = bzip2;
 		}
+		else if(  memcmp( buf, BLOCKS_MAGIC, 4 )==0  ) {
+			mode = zipped_blocks;
+		}
 		fseek(fd->fp,0,SEEK_SET);
 	}
 
+	if(  mode==zipped_blocks  &&  !open_blocks_for_reading( buf )  ) {
+		close();
+		return false;
+	}
+
 	if(  mode==bzip2  ) {
 		fd->bse = BZ_OK+1;
 		fd->bzfp = NULL;
@@ -74,12 +367,13 @@ bool loadsave_t::rd_open(const char *filename)
 		if(  fd->bse==BZ_OK  ) {
 			// else: use zlib
 			MEMZERO(buf);
-			if(  BZ2_bzRead( &fd->bse, fd->bzfp, buf, sizeof(SAVEGAME_PREFIX) )==sizeof(SAVEGAME_PREFIX)  &&  fd->bse==BZ_OK  ) {
+			// a game smaller than the buffer already reaches the end of the stream here
+			if(  BZ2_bzRead( &fd->bse, fd->bzfp, buf, sizeof(SAVEGAME_PREFIX) )==sizeof(SAVEGAME_PREFIX)  &&  (fd->bse==BZ_OK  ||  fd->bse==BZ_STREAM_END)  ) {
 				// get the rest of the string
 				for(  int i=sizeof(SAVEGAME_PREFIX);  buf[i-1]>=32  &&  i<79;  i++  ) {
 					buf[i] = lsgetc();
 				}
-				ok = fd->bse==BZ_OK;
+				ok = fd->bse==BZ_OK  ||  fd->bse==BZ_STREAM_END;
 			}
 		}
 		// BZ-Header but wrong data ...
@@ -89,7 +383,7 @@ bool loadsave_t::rd_open(const char *filename)
 		}
 	}
 
-	if(  mode!=bzip2  ) {
+	if(  mode!=bzip2  &&  mode!=zipped_blocks  ) {
 		fclose(fd->fp);
 		// and now with zlib ...
 		fd->gzfp = gzopen(filename, "rb");
@@ -100,6 +394,42 @@ bool loadsave_t::rd_open(const char *filename)
 	}
 	saving = false;
 
+	if(  !read_header( buf )  ) {
+		return false;
+	}
+	this->filename = filename;
+	return true;
+}
+
+
+bool loadsave_t::rd_open(loadsave_stream_t *stream)
+{
+	close();
+	io_pos = io_end = 0;
+	fd->toc.clear();
+
+	version = 0;
+	mode = zipped_blocks;
+	experimental_version = 0;
+	fd->stream = stream;
+	char buf[80];
+	if(  !open_blocks_for_reading( buf )  ) {
+		close();
+		return false;
+	}
+	saving = false;
+
+	if(  !read_header( buf )  ) {
+		return false;
+	}
+	this->filename = "";
+	return true;
+}
+
+
+// buf holds the first line of the file
+bool loadsave_t::read_header(char *buf)
+{
 	if(strncmp(buf, SAVEGAME_PREFIX, sizeof(SAVEGAME_PREFIX) - 1)) {
 		if(strncmp(buf, XML_SAVEGAME_PREFIX, sizeof(XML_SAVEGAME_PREFIX)-1)!=0) {
 			close();
@@ -159,7 +489,6 @@ bool loadsave_t::rd_open(const char *filename)
 	if(*pak_extension==0) {
 		strcpy( pak_extension, "(unknown)" );
 	}
-	this->filename = filename;
 	return true;
 }
 
@@ -176,10 +505,15 @@ void loadsave_t::rdwr_string(std::string &s) {
 }
 
 
-bool loadsave_t::wr_open(const char *filename, mode_t m, const char *pak_extension, const char *savegame_version, const char *savegame_version_ex)
+bool loadsave_t::wr_open(const char *filename, mode_t m, const char *pak_extension, const char *savegame_version, const char *savegame_version_ex, bool background, loadsave_stream_t *stream)
 {
 	mode = m;
 	close();
+	wait_for_background_save();
+	fd->toc.clear();
+	fd->data_pos = 0;
+	// the background thread must not write to the stream
+	fd->stream = is_zipped_blocks()  &&  !background ? stream : NULL;
 
 	if(  is_zipped()  ) {
 		// using zlib
@@ -189,6 +523,14 @@ bool loadsave_t::wr_open(const char *filename, mode_t m, const char *pak_extensi
 		// no compression
 		fd->fp = fopen(filename, "wb");
 	}
+	else if(  is_zipped_blocks()  ) {
+		fd->fp = fopen(filename, "wb");
+		if(  fd->fp  ) {
+			write_file( BLOCKS_MAGIC, 4 );
+			put_file_uint32( BLOCKS_SIZE );
+			fd->init_blocks();
+		}
+	}
 	else if(  is_bzip2()  ) {
 		// XML or bzip ...
 		fd->fp = fopen(filename, "wb");
@@ -213,6 +555,13 @@ bool loadsave_t::wr_open(const char *filename, mode_t m, const char *pak_extensi
 		return false;
 	}
 	saving = true;
+	io_pos = 0;
+	io_end = IO_BUFFER_SIZE;
+#ifdef MULTI_THREAD
+	fd->in_memory = background;
+#else
+	(void)background;
+#endif
 
 	// get the right extension
 	const char *start = pak_extension;
@@ -274,12 +623,25 @@ const char *loadsave_t::close()
 {
 	const char *success = NULL;
 
-	if(  is_xml()  &&  saving  &&  (!is_bzip2()  ||  fd->bse==BZ_OK)
+	if(  is_xml()  &&  saving  &&  !fd->in_memory  &&  (!is_bzip2()  ||  fd->bse==BZ_OK)
 	     &&  (is_zipped()  ?  fd->gzfp != NULL :  fd->fp != NULL) ) {
-		// only write when close and no error occurred
+		// only write when close and no error occurred (with background saving in the other thread)
 		const char *end = "\n</Simutrans>\n";
 		write( end, strlen(end) );
 	}
+	if(  saving  ) {
+		flush_buffer();
+	}
+	io_pos = io_end = 0;
+	if(  fd->in_memory  ) {
+		start_background_write();
+		return NULL;
+	}
+	if(  is_zipped_blocks()  &&  (fd->fp  ||  fd->stream)  ) {
+		success = close_blocks();
+		fd->fp = NULL;
+	}
+	fd->stream = NULL;
 	if(  is_zipped()  &&  fd->gzfp) {
 		int err_no;
 		const char *err_str = gzerror( fd->gzfp, &err_no );
@@ -294,7 +656,7 @@ const char *loadsave_t::close()
 			/* BZLIB seems to eat the last byte, if it is at odd position
 				* => we just write a dummy zero padding byte
 				*/
-			write( "", 1 );
+			write_raw( "", 1 );
 			BZ2_bzWriteClose( &fd->bse, fd->bzfp, 0, NULL, NULL );
 		}
 		else {
@@ -304,7 +666,7 @@ const char *loadsave_t::close()
 		fd->bzfp = fd->fp = NULL;
 		fd->bse = BZ_STREAM_END;
 	}
-	if(  !is_bzip2()  &&  !is_zipped()  &&  fd->fp  ) {
+	if(  !is_bzip2()  &&  !is_zipped()  &&  !is_zipped_blocks()  &&  fd->fp  ) {
 		int err_no = ferror(fd->fp);
 		fclose(fd->fp);
 		if(err_no!=0) {
@@ -325,47 +687,94 @@ const char *loadsave_t::close()
  */
 bool loadsave_t::is_eof()
 {
-	if(is_bzip2()) {
-		// any error is EOF ...
-		return fd->bse!=BZ_OK;
-	}
-	else {
-		return gzeof(fd->gzfp) != 0;
+	// any error is EOF ...
+	return io_pos==io_end  &&  !fill_buffer();
+}
+
+
+void loadsave_t::flush_buffer()
+{
+	if(  io_pos>0  ) {
+		fd->data_pos += io_pos;
+		write_raw( io_buffer, io_pos );
+		io_pos = 0;
 	}
 }
 
 
+// false if nothing more could be read
+bool loadsave_t::fill_buffer()
+{
+	io_pos = 0;
+	io_end = read_raw( io_buffer, IO_BUFFER_SIZE );
+	return io_end>0;
+}
+
+
 void loadsave_t::lsputc(int c)
 {
-	if(is_zipped()) {
-		gzputc(fd->gzfp, c);
-	}
-	else if(is_bzip2()) {
-		uint8 ch = c;
-		write( &ch, 1 );
-	}
-	else {
-		fputc(c, fd->fp);
+	if(  io_pos==io_end  ) {
+		flush_buffer();
 	}
+	io_buffer[io_pos++] = (uint8)c;
 }
 
+
 int loadsave_t::lsgetc()
 {
-	if(is_bzip2()) {
-		uint8 c[2];
-		if(  fd->bse==BZ_OK  ) {
-			BZ2_bzRead( &fd->bse, fd->bzfp, c, 1);
+	if(  io_pos==io_end  &&  !fill_buffer()  ) {
+		return -1;
+	}
+	return io_buffer[io_pos++];
+}
+
+
+size_t loadsave_t::write(const void *buf, size_t len)
+{
+	if(  io_pos+len > io_end  ) {
+		flush_buffer();
+		if(  len >= io_end  ) {
+			// large enough to go directly to the file
+			fd->data_pos += len;
+			return write_raw( buf, len );
 		}
-		return fd->bse==BZ_OK ? c[0] : -1;
 	}
-	else {
-		return gzgetc(fd->gzfp);
+	memcpy( io_buffer+io_pos, buf, len );
+	io_pos += len;
+	return len;
+}
+
+
+size_t loadsave_t::read(void *buf, size_t len)
+{
+	uint8 *p = (uint8 *)buf;
+	size_t done = 0;
+	while(  done<len  ) {
+		if(  io_pos==io_end  ) {
+			if(  len-done >= IO_BUFFER_SIZE  ) {
+				// large enough to read directly
+				return done + read_raw( p+done, len-done );
+			}
+			if(  !fill_buffer()  ) {
+				break;
+			}
+		}
+		const size_t n = len-done < io_end-io_pos ? len-done : io_end-io_pos;
+		memcpy( p+done, io_buffer+io_pos, n );
+		io_pos += n;
+		done += n;
 	}
+	return done;
 }
 
-size_t loadsave_t::write(const void *buf, size_t len)
+
+size_t loadsave_t::write_raw(const void *buf, size_t len)
 {
-	if(is_zipped()) {
+	if(fd->in_memory) {
+		write_memory( buf, len );
+		return len;
+	}
+	else if(is_zipped()) {
 		return gzwrite(fd->gzfp, const_cast<void *>(buf), len);
 	}
 	else if(is_bzip2()) {
@@ -373,22 +782,420 @@ size_t loadsave_t::write(const void *buf, size_t len)
 		assert(fd->bse==BZ_OK);
 		return len;
 	}
+	else if(is_zipped_blocks()) {
+		write_blocks( buf, len );
+		return len;
+	}
 	else {
 		return fwrite(buf, 1, len, fd->fp);
 	}
 }
 
-size_t loadsave_t::read(void *buf, size_t len)
+
+size_t loadsave_t::read_raw(void *buf, size_t len)
 {
 	if(is_bzip2()) {
 		if(  fd->bse==BZ_OK  ) {
-			BZ2_bzRead( &fd->bse, fd->bzfp, buf, len);
+			// the last piece ends with BZ_STREAM_END
+			const int n = BZ2_bzRead( &fd->bse, fd->bzfp, buf, len);
+			return fd->bse==BZ_OK  ||  fd->bse==BZ_STREAM_END ? n : 0;
 		}
-		return fd->bse==BZ_OK ? len : 0;
+		return 0;
+	}
+	else if(is_zipped_blocks()) {
+		return read_blocks( buf, len );
 	}
 	else {
-		return gzread(fd->gzfp, buf, len);
+		const int n = gzread(fd->gzfp, buf, len);
+		return n>0 ? n : 0;
+	}
+}
+
+
+/*************** background saving *************/
+
+void loadsave_t::write_memory(const void *buf, size_t len)
+{
+	const char *p = (const char *)buf;
+	while(  len>0  ) {
+		if(  fd->memory_fill==MEMORY_CHUNK_SIZE  ) {
+			fd->memory.append( MALLOCN( char, MEMORY_CHUNK_SIZE ) );
+			fd->memory_fill = 0;
+		}
+		const size_t n = len < MEMORY_CHUNK_SIZE-fd->memory_fill ? len : MEMORY_CHUNK_SIZE-fd->memory_fill;
+		memcpy( fd->memory.back()+fd->memory_fill, p, n );
+		fd->memory_fill += n;
+		p += n;
+		len -= n;
+	}
+}
+
+
+// hands the open file and the collected data over to a new thread
+void loadsave_t::start_background_write()
+{
+	loadsave_t *bg = new loadsave_t();
+	file_descriptors_t *tmp = bg->fd;
+	bg->fd = fd;
+	fd = tmp;
+	bg->fd->in_memory = false;
+	bg->mode = mode;
+	bg->saving = saving;
+	bg->version = version;
+	bg->experimental_version = experimental_version;
+	bg->ident = ident;
+	tstrncpy( bg->pak_extension, pak_extension, lengthof(pak_extension) );
+	bg->filename = filename;
+	bg->io_pos = 0;
+	bg->io_end = IO_BUFFER_SIZE;
+	saving = false;
+
+#ifdef MULTI_THREAD
+	if(  pthread_create( &background_thread, NULL, background_write, bg )==0  ) {
+		background_thread_running = true;
+		return;
+	}
+	dbg->warning( "loadsave_t::close()", "could not start background thread, saving directly" );
+#endif
+	background_write( bg );
+}
+
+
+void *loadsave_t::background_write(void *ls)
+{
+	loadsave_t *bg = (loadsave_t *)ls;
+	file_descriptors_t *fd = bg->fd;
+	for(  uint32 i=0;  i<fd->memory.get_count();  i++  ) {
+		const bool last = i+1==fd->memory.get_count();
+		bg->write_raw( fd->memory[i], last ? fd->memory_fill : MEMORY_CHUNK_SIZE );
+		free( fd->memory[i] );
+		fd->memory[i] = NULL;
+	}
+	fd->memory.clear();
+	fd->memory_fill = MEMORY_CHUNK_SIZE;
+	const char *err = bg->close();
+	if(  err  ) {
+		dbg->error( "loadsave_t::background_write()", "saving %s failed: %s", bg->filename.c_str(), err );
+	}
+	delete bg;
+	return NULL;
+}
+
+
+/*************** block layer of the zipped_blocks format *************/
+
+void loadsave_t::write_blocks(const void *buf, size_t len)
+{
+	const Bytef *p = (const Bytef *)buf;
+	while(  len>0  ) {
+		loadsave_block_t &b = fd->current();
+		const size_t n = len < BLOCKS_SIZE-b.raw_len ? len : BLOCKS_SIZE-b.raw_len;
+		memcpy( b.raw+b.raw_len, p, n );
+		b.raw_len += n;
+		p += n;
+		len -= n;
+		if(  b.raw_len==BLOCKS_SIZE  ) {
+			submit_write_block();
+		}
+	}
+}
+
+
+// the current block is full: compress it, and write the oldest one if all blocks are in use
+void loadsave_t::submit_write_block()
+{
+	loadsave_block_t &b = fd->current();
+	b.compress = true;
+	worker_pool_t::submit( &b );
+	fd->pending ++;
+	if(  fd->pending==fd->block_count  ) {
+		flush_write_block();
+	}
+}
+
+
+// writes the oldest pending block to the file
+void loadsave_t::flush_write_block()
+{
+	loadsave_block_t &b = fd->blocks[fd->first];
+	worker_pool_t::wait( &b );
+	if(  b.ok  ) {
+		put_file_uint32( b.zipped_len );
+		put_file_uint32( b.raw_len );
+		write_file( b.zipped, b.zipped_len );
+		fd->blocks_index.append( b.zipped_len );
+		fd->blocks_index.append( b.raw_len );
+	}
+	else {
+		fd->blocks_error = true;
+	}
+	b.raw_len = 0;
+	fd->first = (fd->first+1) % fd->block_count;
+	fd->pending --;
+}
+
+
+// the block layer writes through here, so the stream gets the same data as the file
+void loadsave_t::write_file(const void *buf, size_t len)
+{
+	fwrite( buf, 1, len, fd->fp );
+	if(  fd->stream  &&  !fd->stream->write( buf, len )  ) {
+		// the file is still needed
+		fd->stream = NULL;
+	}
+}
+
+
+bool loadsave_t::read_file(void *buf, size_t len)
+{
+	if(  fd->stream  ) {
+		return fd->stream->read( buf, len );
+	}
+	return fread( buf, 1, len, fd->fp )==len;
+}
+
+
+void loadsave_t::put_file_uint32(uint32 v)
+{
+	const uint8 buf[4] = { (uint8)v, (uint8)(v>>8), (uint8)(v>>16), (uint8)(v>>24) };
+	write_file( buf, 4 );
+}
+
+
+bool loadsave_t::get_file_uint32(uint32 &v)
+{
+	uint8 buf[4];
+	if(  !read_file( buf, 4 )  ) {
+		return false;
+	}
+	v = buf[0] | (buf[1]<<8) | (buf[2]<<16) | ((uint32)buf[3]<<24);
+	return true;
+}
+
+
+// starts reading the blocks, and reads the first line of the game into buf (80 chars)
+bool loadsave_t::open_blocks_for_reading(char *buf)
+{
+	uint32 block_size;
+	char magic[4];
+	if(  !read_file( magic, 4 )  ||  memcmp( magic, BLOCKS_MAGIC, 4 )!=0  ||  !get_file_uint32( block_size )  ||  block_size>BLOCKS_SIZE  ) {
+		return false;
+	}
+	fd->init_blocks();
+	// only the first block: often just the header is needed,
+	// the others are started when it has been used up
+	submit_read_block();
+	if(  fd->blocks_error  ) {
+		return false;
+	}
+
+	memset( buf, 0, 80 );
+	if(  read( buf, sizeof(SAVEGAME_PREFIX) )!=sizeof(SAVEGAME_PREFIX)  ) {
+		return false;
+	}
+	// get the rest of the string
+	for(  int i=sizeof(SAVEGAME_PREFIX);  buf[i-1]>=32  &&  i<79;  i++  ) {
+		buf[i] = lsgetc();
+	}
+	return true;
+}
+
+
+// reads the next block from the file into the next free slot and submits it
+bool loadsave_t::submit_read_block()
+{
+	if(  fd->blocks_end  ||  fd->blocks_error  ) {
+		return false;
+	}
+	loadsave_block_t &b = fd->current();
+	uint32 zipped_len, raw_len;
+	if(  !get_file_uint32( zipped_len )  ||  !get_file_uint32( raw_len )  ) {
+		fd->blocks_error = true;
+		return false;
+	}
+	if(  zipped_len==0  &&  raw_len==0  ) {
+		// end marker, the index follows
+		fd->blocks_end = true;
+		return false;
+	}
+	if(  raw_len>BLOCKS_SIZE  ||  zipped_len>compressBound(BLOCKS_SIZE)  ||  !read_file( b.zipped, zipped_len )  ) {
+		fd->blocks_error = true;
+		return false;
+	}
+	b.zipped_len = zipped_len;
+	b.raw_len = raw_len;
+	b.read_pos = 0;
+	b.ready = false;
+	b.compress = false;
+	worker_pool_t::submit( &b );
+	fd->pending ++;
+	return true;
+}
+
+
+size_t loadsave_t::read_blocks(void *buf, size_t len)
+{
+	Bytef *p = (Bytef *)buf;
+	size_t done = 0;
+	while(  done<len  &&  fd->pending>0  &&  !fd->blocks_error  ) {
+		loadsave_block_t &b = fd->blocks[fd->first];
+		if(  !b.ready  ) {
+			worker_pool_t::wait( &b );
+			b.ready = true;
+			if(  !b.ok  ) {
+				fd->blocks_error = true;
+				break;
+			}
+		}
+		const size_t n = len-done < b.raw_len-b.read_pos ? len-done : b.raw_len-b.read_pos;
+		memcpy( p+done, b.raw+b.read_pos, n );
+		b.read_pos += n;
+		done += n;
+		if(  b.read_pos==b.raw_len  ) {
+			// used up: decompress as many blocks ahead as there are slots
+			b.ready = false;
+			fd->first = (fd->first+1) % fd->block_count;
+			fd->pending --;
+			while(  fd->pending<fd->block_count  &&  submit_read_block()  ) {
+			}
+		}
 	}
+	return done;
+}
+
+
+const char *loadsave_t::close_blocks()
+{
+	if(  saving  &&  fd->blocks  ) {
+		if(  fd->current().raw_len>0  ) {
+			submit_write_block();
+		}
+		while(  fd->pending>0  ) {
+			flush_write_block();
+		}
+		// end marker and index; the stream ends with the marker
+		put_file_uint32( 0 );
+		put_file_uint32( 0 );
+		fd->stream = NULL;
+		FOR(vector_tpl<uint32>, const l, fd->blocks_index) {
+			put_uint32( fd->fp, l );
+		}
+		put_uint32( fd->fp, fd->blocks_index.get_count()/2 );
+		fwrite( BLOCKS_MAGIC, 1, 4, fd->fp );
+		if(  !fd->toc.empty()  ) {
+			fd->toc.write( fd->fp );
+		}
+	}
+	fd->term_blocks();
+
+	const char *success = NULL;
+	if(  fd->blocks_error  ) {
+		success = "block compression failed";
+	}
+	if(  fd->fp  ) {
+		const int err_no = ferror(fd->fp);
+		fclose(fd->fp);
+		if(  err_no!=0  ) {
+			success = strerror(err_no);
+		}
+	}
+	return success;
+}
+
+
+void loadsave_t::begin_section(const char *name)
+{
+	if(  saving  ) {
+		fd->toc.section_names.append( name );
+		fd->toc.section_offsets.append( fd->data_pos+io_pos );
+	}
+}
+
+
+void loadsave_t::add_info(const char *name, const std::string &data)
+{
+	if(  saving  ) {
+		fd->toc.info_names.append( name );
+		fd->toc.info_data.append( data );
+	}
+}
+
+
+bool loadsave_t::seek_section(const char *name)
+{
+	if(  saving  ||  !is_zipped_blocks()  ||  fd->fp==NULL  ) {
+		return false;
+	}
+	loadsave_toc_t &toc = fd->toc;
+	if(  !toc.loaded  ) {
+		const long pos = ftell( fd->fp );
+		const bool ok = toc.read( fd->fp );
+		fseek( fd->fp, pos, SEEK_SET );
+		if(  !ok  ) {
+			return false;
+		}
+	}
+	uint32 offset = 0;
+	bool found = false;
+	for(  uint32 i=0;  i<toc.section_names.get_count()  &&  !found;  i++  ) {
+		if(  toc.section_names[i]==name  ) {
+			offset = toc.section_offsets[i];
+			found = true;
+		}
+	}
+	// the block containing the offset
+	uint32 block = 0;
+	while(  block+1<toc.block_file_pos.get_count()  &&  toc.block_data_pos[block+1]<=offset  ) {
+		block ++;
+	}
+	if(  !found  ||  block>=toc.block_file_pos.get_count()  ||  offset>=toc.block_data_pos[block+1]  ) {
+		return false;
+	}
+
+	// forget the blocks decompressed so far
+	for(  uint32 i=0;  i<fd->block_count;  i++  ) {
+		worker_pool_t::wait( fd->blocks+i );
+		fd->blocks[i].ready = false;
+	}
+	fd->first = fd->pending = 0;
+	fd->blocks_end = fd->blocks_error = false;
+	io_pos = io_end = 0;
+
+	if(  fseek( fd->fp, toc.block_file_pos[block], SEEK_SET )!=0  ||  !submit_read_block()  ) {
+		return false;
+	}
+	loadsave_block_t &b = fd->blocks[fd->first];
+	worker_pool_t::wait( &b );
+	b.ready = true;
+	if(  !b.ok  ) {
+		fd->blocks_error = true;
+		return false;
+	}
+	b.read_pos = offset - toc.block_data_pos[block];
+	return true;
+}
+
+
+bool loadsave_t::read_info(const char *filename, const char *name, std::string &data)
+{
+	wait_for_background_save();
+	FILE *fp = fopen( filename, "rb" );
+	if(  fp==NULL  ) {
+		return false;
+	}
+	loadsave_toc_t toc;
+	char magic[4];
+	bool found = false;
+	if(  fread( magic, 1, 4, fp )==4  &&  memcmp( magic, BLOCKS_MAGIC, 4 )==0  &&  toc.read( fp )  ) {
+		for(  uint32 i=0;  i<toc.info_names.get_count()  &&  !found;  i++  ) {
+			if(  toc.info_names[i]==name  ) {
+				data = toc.info_data[i];
+				found = true;
+			}
+		}
+	}
+	fclose( fp );
+	return found;
 }
 
 
@@ -398,7 +1205,7 @@ size_t loadsave_t::read(void *buf, size_t len)
 
 
 
-void loadsave_t::rdwr_byte(sint8 &c)
+void loadsave_t::rdwr_byte_slow(sint8 &c)
 {
 	if(!is_xml()) {
 		if(saving) {
@@ -415,15 +1222,8 @@ void loadsave_t::rdwr_byte(sint8 &c)
 	}
 }
 
-void loadsave_t::rdwr_byte(uint8 &c)
-{
-	sint8 cc=c;
-	rdwr_byte(cc);
-	c = (uint8)cc;
-}
 
-
-void loadsave_t::rdwr_short(sint16 &i)
+void loadsave_t::rdwr_short_slow(sint16 &i)
 {
 	if(!is_xml()) {
 		if (saving) {
@@ -450,15 +1250,8 @@ void loadsave_t::rdwr_short(sint16 &i)
 	}
 }
 
-void loadsave_t::rdwr_short(uint16 &i)
-{
-	sint16 ii=i;
-	rdwr_short(ii);
-	i = (uint16)ii;
-}
-
 
-void loadsave_t::rdwr_long(sint32 &l)
+void loadsave_t::rdwr_long_slow(sint32 &l)
 {
 	if(!is_xml()) {
 		if (saving) {
@@ -485,15 +1278,8 @@ void loadsave_t::rdwr_long(sint32 &l)
 	}
 }
 
-void loadsave_t::rdwr_long(uint32 &l)
-{
-	sint32 ll=l;
-	rdwr_long(ll);
-	l = (uint32)ll;
-}
-
 
-void loadsave_t::rdwr_longlong(sint64 &ll)
+void loadsave_t::rdwr_longlong_slow(sint64 &ll)
 {
 	if(!is_xml()) {
 		if (saving) {
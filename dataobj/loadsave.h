@@ -12,6 +12,7 @@
 #define NOMINMAX 1
 
 #include <stdio.h>
+#include <string.h>
 #include <string>
 
 #include "../simtypes.h"
@@ -19,6 +20,24 @@
 class plainstring;
 struct file_descriptors_t;
 
+/**
+ * The compressed data of a zipped_blocks game besides the file while saving,
+ * or instead of a file while loading: to send a game over the network while
+ * it is saved, and to load it while it is received.
+ * Seeking and the table of contents are not available from a stream.
+ */
+class loadsave_stream_t
+{
+public:
+	virtual ~loadsave_stream_t() {}
+
+	// false on an error; the file is still written completely then
+	virtual bool write(const void *buf, size_t len) = 0;
+
+	// reads exactly len bytes, false on an error or at the end
+	virtual bool read(void *buf, size_t len) = 0;
+};
+
 /**
  * loadsave_t:
  *
@@ -28,6 +47,8 @@ struct file_descriptors_t;
  * </p>
  * Can now read and write 3 formats: text, binary and zipped
  * Input format is automatically detected.
+ * zipped_blocks splits the data into independently compressed blocks,
+ * which are compressed and decompressed on the worker threads.
  * Output format has a default, changeable with set_savemode, but can be
  * overwritten in wr_open.
  *
@@ -37,7 +58,7 @@ struct file_descriptors_t;
 
 class loadsave_t {
 public:
-	enum mode_t { text=1, xml=2, binary=0, zipped=4, xml_zipped=6, bzip2=8, xml_bzip2=10 };
+	enum mode_t { text=1, xml=2, binary=0, zipped=4, xml_zipped=6, bzip2=8, xml_bzip2=10, zipped_blocks=16, xml_zipped_blocks=18 };
 
 private:
 	int mode;
@@ -51,6 +72,18 @@ private:
 
 	file_descriptors_t *fd;
 
+	/**
+	 * All data passes through this buffer, so the compressors are called
+	 * with large chunks only. While saving io_end is the size of the buffer,
+	 * while loading the number of bytes read into it.
+	 */
+	uint8 *io_buffer;
+	uint32 io_pos;
+	uint32 io_end;
+
+	void flush_buffer();
+	bool fill_buffer();
+
 	// Hajo: putc got a name clash on my system
 	void lsputc(int c);
 
@@ -59,6 +92,56 @@ private:
 	size_t write(const void * buf, size_t len);
 	size_t read(void *buf, size_t len);
 
+	// unbuffered access to the file
+	size_t write_raw(const void * buf, size_t len);
+	size_t read_raw(void *buf, size_t len);
+
+	// binary numbers directly to/from the buffer, if it has room; false for xml
+	template<class T> bool rdwr_buffered(T &v)
+	{
+		if(  (mode & xml)  ||  io_pos+sizeof(T) > io_end  ) {
+			return false;
+		}
+		if(  saving  ) {
+			const T e = endian(v);
+			memcpy( io_buffer+io_pos, &e, sizeof(T) );
+		}
+		else {
+			T e;
+			memcpy( &e, io_buffer+io_pos, sizeof(T) );
+			v = endian(e);
+		}
+		io_pos += sizeof(T);
+		return true;
+	}
+
+	// all other cases of the rdwr_ functions below
+	void rdwr_byte_slow(sint8 &c);
+	void rdwr_short_slow(sint16 &i);
+	void rdwr_long_slow(sint32 &i);
+	void rdwr_longlong_slow(sint64 &i);
+
+	// reads the rest of the header after the format has been recognized
+	bool read_header(char *buf);
+
+	// the block layer of zipped_blocks, its data goes through write_file/read_file
+	void write_file(const void *buf, size_t len);
+	bool read_file(void *buf, size_t len);
+	void put_file_uint32(uint32 v);
+	bool get_file_uint32(uint32 &v);
+	bool open_blocks_for_reading(char *buf);
+	void write_blocks(const void *buf, size_t len);
+	size_t read_blocks(void *buf, size_t len);
+	void submit_write_block();
+	void flush_write_block();
+	bool submit_read_block();
+	const char *close_blocks();
+
+	// background saving: data is collected in memory and written by another thread
+	void write_memory(const void *buf, size_t len);
+	void start_background_write();
+	static void *background_write(void *ls);
+
 	void rdwr_xml_number(sint64 &s, const char *typ);
 
 
@@ -76,9 +159,35 @@ public:
 	~loadsave_t();
 
 	bool rd_open(const char *filename);
-	bool wr_open(const char *filename, mode_t mode, const char *pak_extension, const char *savegame_version, const char *savegame_version_ex );
+	// reads a game in the zipped_blocks format from the stream
+	bool rd_open(loadsave_stream_t *stream);
+	/**
+	 * With background=true everything written is kept in memory, and close()
+	 * returns at once while another thread compresses and writes the file.
+	 * Errors are then only logged. Without MULTI_THREAD it is ignored.
+	 * In the zipped_blocks format everything written to the file (without the
+	 * table of contents) is written to the stream too, if there is one.
+	 */
+	bool wr_open(const char *filename, mode_t mode, const char *pak_extension, const char *savegame_version, const char *savegame_version_ex, bool background=false, loadsave_stream_t *stream=NULL );
 	const char *close();
 
+	// blocks until a background save has been written completely; rd_open and wr_open do this
+	static void wait_for_background_save();
+
+	/**
+	 * Table of contents, only stored in the zipped_blocks format.
+	 * While saving, begin_section() notes the current position under a name,
+	 * so seek_section() can continue reading there later: only the data from
+	 * the block containing it on is decompressed.
+	 * add_info() stores some data besides the actual savegame (like a summary
+	 * for the file browser), read_info() gets it back by reading only the end
+	 * of the file. All are harmless no-ops for the other formats.
+	 */
+	void begin_section(const char *name);
+	bool seek_section(const char *name);
+	void add_info(const char *name, const std::string &data);
+	static bool read_info(const char *filename, const char *name, std::string &data);
+
 	static void set_savemode(mode_t mode) { save_mode = mode; }
 	/**
 	 * Checks end-of-file
@@ -90,18 +199,34 @@ public:
 	bool is_saving() const { return saving; }
 	bool is_zipped() const { return mode&zipped; }
 	bool is_bzip2() const { return mode&bzip2; }
+	bool is_zipped_blocks() const { return mode&zipped_blocks; }
 	bool is_xml() const { return mode&xml; }
 	uint32 get_version() const { return version; }
 	uint32 get_experimental_version() const { return experimental_version; }
 	const char *get_pak_extension() const { return pak_extension; }
 
-	void rdwr_byte(sint8 &c);
-	void rdwr_byte(uint8 &c);
-	void rdwr_short(sint16 &i);
-	void rdwr_short(uint16 &i);
-	void rdwr_long(sint32 &i);
-	void rdwr_long(uint32 &i);
-	void rdwr_longlong(sint64 &i);
+	void rdwr_byte(sint8 &c)
+	{
+		if(  (mode & xml)==0  &&  io_pos < io_end  ) {
+			if(  saving  ) {
+				io_buffer[io_pos] = c;
+			}
+			else {
+				c = io_buffer[io_pos];
+			}
+			io_pos ++;
+		}
+		else {
+			rdwr_byte_slow(c);
+		}
+	}
+	// the unsigned variants work on the same bytes, so a variable which is only loaded need not be initialised
+	void rdwr_byte(uint8 &c) { rdwr_byte( reinterpret_cast<sint8 &>(c) ); }
+	void rdwr_short(sint16 &i) { if(  !rdwr_buffered(i)  ) { rdwr_short_slow(i); } }
+	void rdwr_short(uint16 &i) { rdwr_short( reinterpret_cast<sint16 &>(i) ); }
+	void rdwr_long(sint32 &i) { if(  !rdwr_buffered(i)  ) { rdwr_long_slow(i); } }
+	void rdwr_long(uint32 &i) { rdwr_long( reinterpret_cast<sint32 &>(i) ); }
+	void rdwr_longlong(sint64 &i) { if(  !rdwr_buffered(i)  ) { rdwr_longlong_slow(i); } }
 	void rdwr_bool(bool &i);
 	void rdwr_double(double &dbl);
 
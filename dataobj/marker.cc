@@ -26,6 +26,7 @@ void marker_t::init(int welt_groesse_x,int welt_groesse_y)
 	else {
 		bits = NULL;
 	}
+	all_touched = true;
 	unmarkiere_alle();
 }
 
@@ -37,8 +38,17 @@ marker_t::~marker_t()
 void marker_t::unmarkiere_alle()
 {
 	if(bits) {
-		MEMZERON(bits, bits_groesse);
+		if(all_touched) {
+			MEMZERON(bits, bits_groesse);
+		}
+		else {
+			FOR(vector_tpl<uint32>, const i, touched) {
+				bits[i] = 0;
+			}
+		}
 	}
+	touched.clear();
+	all_touched = false;
 	more.clear();
 }
 
@@ -48,10 +58,20 @@ void marker_t::markiere(const grund_t *gr)
 		if(gr->ist_karten_boden()) {
 			// ground level
 			const int bit = gr->get_pos().y*cached_groesse+gr->get_pos().x;
-			bits[bit/bit_unit] |= 1 << (bit & bit_mask);
+			unsigned char &b = bits[bit/bit_unit];
+			if(b==0  &&  !all_touched) {
+				// beyond 1/16 of the map clearing everything is cheaper
+				if((int)touched.get_count() < bits_groesse/16) {
+					touched.append(bit/bit_unit);
+				}
+				else {
+					all_touched = true;
+				}
+			}
+			b |= 1 << (bit & bit_mask);
 		}
 		else if(!more.is_contained(gr)) {
-			more.insert(gr);
+			more.append(gr);
 		}
 	}
 }
@@ -9,7 +9,7 @@
 #ifndef __MARKER_H
 #define __MARKER_H
 
-#include "../tpl/slist_tpl.h"
+#include "../tpl/vector_tpl.h"
 
 class grund_t;
 
@@ -24,8 +24,18 @@ class marker_t {
 
     int cached_groesse;
 
-    slist_tpl <const grund_t *> more;
+    // indices of the bytes in bits which were set since the last unmarkiere_alle(),
+    // so most searches need not clear the whole map; if too many bytes were
+    // touched, all_touched is set instead and everything is cleared
+    vector_tpl <uint32> touched;
+    bool all_touched;
+
+    // tiles which are not ground level (kept in a vector: it keeps its capacity
+    // between searches, while an slist would take each node from the freelist,
+    // whose mutex the route searches on worker threads would then contend for)
+    vector_tpl <const grund_t *> more;
 public:
+    marker_t() : bits(NULL), bits_groesse(0), cached_groesse(0), all_touched(false) {}
     marker_t(int welt_groesse_x,int welt_groesse_y) : bits(NULL) { init(welt_groesse_x, welt_groesse_y); }
     ~marker_t();
 
@@ -22,6 +22,7 @@
 
 #ifndef NETTOOL
 #include "../dataobj/umgebung.h"
+#include "../simsys.h"
 #endif
 
 #ifdef NETTOOL
@@ -37,11 +38,36 @@ uint16 network_server_port = 0;
 // list of received commands
 static slist_tpl<network_command_t *> received_command_queue;
 
+#ifdef NETWORK_IO_THREAD
+/* server only: a thread accepting clients, receiving commands and
+ * processing the send queues while the simulation runs.
+ * The received commands are passed on by incoming_command_queue.
+ */
+static pthread_t io_thread;
+static bool io_thread_running = false;
+// read by the network thread, only changed with socket_list_t::mutex held
+static volatile bool io_thread_stop = false;
+
+static simthread_mutex_t incoming_mutex;
+static slist_tpl<network_command_t *> incoming_command_queue;
+
+static void network_start_io_thread();
+static void network_stop_io_thread();
+#endif
+
 // blacklist
 address_list_t blacklist;
 
 void clear_command_queue()
 {
+#ifdef NETWORK_IO_THREAD
+	{
+		SIMTHREAD_LOCK( incoming_mutex );
+		while(!incoming_command_queue.empty()) {
+			delete incoming_command_queue.remove_first();
+		}
+	}
+#endif
 	while(!received_command_queue.empty()) {
 		network_command_t *nwc = received_command_queue.remove_first();
 		if (nwc) {
@@ -465,6 +491,9 @@ bool network_init_server( int port )
 #ifndef NETTOOL
 	nwc_ready_t::clear_map_counters();
 #endif // NETTOOL
+#ifdef NETWORK_IO_THREAD
+	network_start_io_thread();
+#endif
 
 	return true;
 }
@@ -484,6 +513,14 @@ void network_set_socket_nodelay( SOCKET sock )
 
 network_command_t* network_get_received_command()
 {
+#ifdef NETWORK_IO_THREAD
+	if (io_thread_running) {
+		SIMTHREAD_LOCK( incoming_mutex );
+		while(!incoming_command_queue.empty()) {
+			received_command_queue.append( incoming_command_queue.remove_first() );
+		}
+	}
+#endif
 	if (!received_command_queue.empty()) {
 		return received_command_queue.remove_first();
 	}
@@ -491,30 +528,10 @@ network_command_t* network_get_received_command()
 }
 
 
-/* do appropriate action for network games:
- * - server: accept connection to a new client
- * - all: receive commands and puts them to the received_command_queue
- */
-network_command_t* network_check_activity(karte_t *, int timeout)
+// accept new connections on all server sockets set in fds
+static void network_accept_clients(fd_set *fds)
 {
-	fd_set fds;
-	FD_ZERO(&fds);
-
-	socket_list_t::fill_set(&fds);
-
-	// time out: MAC complains about too long timeouts
-	struct timeval tv;
-	tv.tv_sec = timeout / 1000;
-	tv.tv_usec = (timeout % 1000) * 1000ul;
-
-	int action = select( FD_SETSIZE, &fds, NULL, NULL, &tv );
-	if(  action<=0  ) {
-		// timeout: return command from the queue
-		return network_get_received_command();
-	}
-
-	// accept new connection
-	socket_list_t::server_socket_iterator_t iter_s(&fds);
+	socket_list_t::server_socket_iterator_t iter_s(fds);
 	while(iter_s.next()) {
 		SOCKET accept_sock = iter_s.get_current();
 
@@ -544,9 +561,13 @@ network_command_t* network_check_activity(karte_t *, int timeout)
 			}
 		}
 	}
+}
 
-	// receive from clients
-	socket_list_t::client_socket_iterator_t iter_c(&fds);
+
+// receive from all client sockets set in fds, completed commands are appended to queue
+static void network_receive_commands(fd_set *fds, slist_tpl<network_command_t *> &queue)
+{
+	socket_list_t::client_socket_iterator_t iter_c(fds);
 	while(iter_c.next()) {
 		SOCKET sender = iter_c.get_current();
 
@@ -554,18 +575,174 @@ network_command_t* network_check_activity(karte_t *, int timeout)
 			uint32 client_id = socket_list_t::get_client_id(sender);
 			network_command_t *nwc = socket_list_t::get_client(client_id).receive_nwc();
 			if (nwc) {
-				received_command_queue.append(nwc);
+				queue.append(nwc);
 				dbg->warning( "network_check_activity()", "received cmd id=%d %s from socket[%d]", nwc->get_id(), nwc->get_name(), sender );
 			}
 			// errors are caught and treated in socket_info_t::receive_nwc
 		}
 	}
+}
+
+
+// send to all client sockets set in fds (at most action sockets are set)
+static void network_send_to_clients(fd_set *fds, int action)
+{
+	socket_list_t::client_socket_iterator_t iter_c(fds);
+	while(iter_c.next()  &&  action>0) {
+		SOCKET sock = iter_c.get_current();
+
+		if (sock != INVALID_SOCKET  &&  socket_list_t::has_client(sock)) {
+			uint32 client_id = socket_list_t::get_client_id(sock);
+			socket_list_t::get_client(client_id).process_send_queue();
+			// errors are caught and treated in socket_info_t::process_send_queue
+		}
+		action --;
+	}
+}
+
+
+#ifdef NETWORK_IO_THREAD
+static void *network_io_thread_main(void *)
+{
+	slist_tpl<network_command_t *> received;
+	while(  !io_thread_stop  ) {
+		fd_set rfds, wfds;
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		socket_list_t::fill_set(&rfds);
+		socket_list_t::fill_send_set(&wfds);
+
+		// short timeout, since new packets in the send queues do not wake us up
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 2000;
+		if(  select( FD_SETSIZE, &rfds, &wfds, NULL, &tv )<=0  ) {
+			continue;
+		}
+
+		{
+			SIMTHREAD_LOCK( socket_list_t::mutex );
+			if(  io_thread_stop  ) {
+				break;
+			}
+			// a socket may have been closed by the simulation since select():
+			// the iterators only return sockets still in the list
+			network_accept_clients(&rfds);
+			network_receive_commands(&rfds, received);
+			network_send_to_clients(&wfds, FD_SETSIZE);
+		}
+
+		if(  !received.empty()  ) {
+			SIMTHREAD_LOCK( incoming_mutex );
+			while(  !received.empty()  ) {
+				incoming_command_queue.append( received.remove_first() );
+			}
+		}
+	}
+	while(  !received.empty()  ) {
+		delete received.remove_first();
+	}
+	return NULL;
+}
+
+
+static void network_start_io_thread()
+{
+	if(  io_thread_running  ||  !umgebung_t::network_thread  ) {
+		return;
+	}
+	io_thread_stop = false;
+	socket_list_t::set_defer_removal( true );
+	if(  pthread_create( &io_thread, NULL, network_io_thread_main, NULL )  ) {
+		dbg->warning( "network_start_io_thread()", "could not start network thread" );
+		socket_list_t::set_defer_removal( false );
+		return;
+	}
+	io_thread_running = true;
+	DBG_MESSAGE( "network_start_io_thread()", "network thread started" );
+}
+
+
+static void network_stop_io_thread()
+{
+	if(  !io_thread_running  ) {
+		return;
+	}
+	socket_list_t::mutex.lock();
+	io_thread_stop = true;
+	socket_list_t::mutex.unlock();
+	pthread_join( io_thread, NULL );
+	io_thread_running = false;
+	socket_list_t::set_defer_removal( false );
+	socket_list_t::remove_failed_clients();
+}
+#endif
+
+
+/* do appropriate action for network games:
+ * - server: accept connection to a new client
+ * - all: receive commands and puts them to the received_command_queue
+ */
+network_command_t* network_check_activity(karte_t *, int timeout)
+{
+#ifdef NETWORK_IO_THREAD
+	if(  io_thread_running  ) {
+		// the network thread did all the work, we may only have to wait
+		socket_list_t::remove_failed_clients();
+		network_command_t *nwc = network_get_received_command();
+		const uint32 end = dr_time() + timeout;
+		while(  nwc==NULL  ) {
+			const sint32 left = (sint32)(end-dr_time());
+			if(  left<=0  ) {
+				break;
+			}
+			// wake up when data arrives, the network thread is reading it meanwhile
+			fd_set fds;
+			FD_ZERO(&fds);
+			socket_list_t::fill_set(&fds);
+			struct timeval tv;
+			tv.tv_sec = left / 1000;
+			tv.tv_usec = (left % 1000) * 1000ul;
+			select( FD_SETSIZE, &fds, NULL, NULL, &tv );
+			nwc = network_get_received_command();
+		}
+		return nwc;
+	}
+#endif
+	fd_set fds;
+	FD_ZERO(&fds);
+
+	socket_list_t::fill_set(&fds);
+
+	// time out: MAC complains about too long timeouts
+	struct timeval tv;
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000ul;
+
+	int action = select( FD_SETSIZE, &fds, NULL, NULL, &tv );
+	if(  action<=0  ) {
+		// timeout: return command from the queue
+		return network_get_received_command();
+	}
+
+	// accept new connection
+	network_accept_clients(&fds);
+
+	// receive from clients
+	network_receive_commands(&fds, received_command_queue);
+
 	return network_get_received_command();
 }
 
 
 void network_process_send_queues(int timeout)
 {
+#ifdef NETWORK_IO_THREAD
+	if(  io_thread_running  ) {
+		// done by the network thread
+		return;
+	}
+#endif
 	fd_set fds;
 	FD_ZERO(&fds);
 
@@ -584,17 +761,7 @@ void network_process_send_queues(int timeout)
 	}
 
 	// send to clients
-	socket_list_t::client_socket_iterator_t iter_c(&fds);
-	while(iter_c.next()  &&  action>0) {
-		SOCKET sock = iter_c.get_current();
-
-		if (sock != INVALID_SOCKET  &&  socket_list_t::has_client(sock)) {
-			uint32 client_id = socket_list_t::get_client_id(sock);
-			socket_list_t::get_client(client_id).process_send_queue();
-			// errors are caught and treated in socket_info_t::process_send_queue
-		}
-		action --;
-	}
+	network_send_to_clients(&fds, action);
 }
 
 
@@ -796,6 +963,9 @@ void network_reset_server()
  */
 void network_core_shutdown()
 {
+#ifdef NETWORK_IO_THREAD
+	network_stop_io_thread();
+#endif
 	clear_command_queue();
 
 	socket_list_t::reset();
@@ -84,7 +84,9 @@
 
 #include "../simtypes.h"
 // version of network protocol code
-#define NETWORK_VERSION (1)
+// 2: route search limits tell whether path exploration runs on worker threads
+// 3: games may be sent in chunks while saving (NETWORK_STREAMED_GAME)
+#define NETWORK_VERSION (3)
 
 class network_command_t;
 class gameinfo_t;
@@ -70,6 +70,10 @@ void network_command_t::prepare_to_send()
 
 bool network_command_t::send(SOCKET s)
 {
+#ifdef NETWORK_IO_THREAD
+	// the network thread must not send queued packets to s meanwhile
+	SIMTHREAD_LOCK( socket_list_t::mutex );
+#endif
 	prepare_to_send();
 	packet->send(s, true);
 	bool ok = packet->is_ready();
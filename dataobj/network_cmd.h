@@ -104,6 +104,8 @@ public:
 		SRVC_ADMIN_MSG       = 8,
 		SRVC_SHUTDOWN        = 9,
 		SRVC_FORCE_SYNC      = 10,
+		SRVC_PROFILE         = 11,	// number: 1 to switch profiling on, 0 to switch it off
+		SRVC_PROFILE_DUMP    = 12,	// writes the profiling data to profile.txt
 		SRVC_MAX
 	};
 
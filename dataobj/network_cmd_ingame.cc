@@ -16,6 +16,7 @@
 #include "../player/simplay.h"
 #include "../gui/player_frame_t.h"
 #include "../utils/cbuffer_t.h"
+#include "../utils/simprofile.h"
 
 
 network_command_t* network_command_t::read_from_packet(packet_t *p)
@@ -193,7 +194,7 @@ bool nwc_ready_t::execute(karte_t *welt)
 		if(  welt->is_checklist_available(sync_step)  &&  checklist!=welt->get_checklist_at(sync_step)  ) {
 			// client has gone out of sync
 			socket_list_t::remove_client( get_sender() );
-			char buf[256];
+			char buf[512];
 			welt->get_checklist_at(sync_step).print(buf, "server");
 			checklist.print(buf, "client");
 			dbg->warning("nwc_ready_t::execute", "disconnect client due to checklist mismatch : sync_step=%u %s", sync_step, buf);
@@ -447,15 +448,13 @@ void nwc_sync_t::do_command(karte_t *welt)
 			}
 		}
 
-		// save game
+		// save game, and send it while saving
+		// this sends nwc_game_t
+		const uint32 pause_start = dr_time();
 		sprintf( fn, "server%d-network.sve", umgebung_t::server );
 		bool old_restore_UI = umgebung_t::restore_UI;
 		umgebung_t::restore_UI = true;
-		welt->speichern(fn, SERVER_SAVEGAME_VER_NR, EXPERIMENTAL_VER_NR, false );
-
-		// ok, now sending game
-		// this sends nwc_game_t
-		const char *err = network_send_file( client_id, fn );
+		const char *err = network_send_game( client_id, welt, fn );
 		if (err) {
 			dbg->warning("nwc_sync_t::do_command","send game failed with: %s", err);
 		}
@@ -498,6 +497,7 @@ void nwc_sync_t::do_command(karte_t *welt)
 			}
 		}
 		nwc_join_t::pending_join_client = INVALID_SOCKET;
+		dbg->message( "nwc_sync_t::do_command", "join of client %u stopped the game for %u ms", client_id, dr_time()-pause_start );
 	}
 	// restore screen coordinates & offsets
 	welt->change_world_position(ij, xoff, yoff);
@@ -520,7 +520,7 @@ uint16 nwc_routesearch_t::accumulated_updates = 0;
 void nwc_routesearch_t::rdwr()
 {
 	network_world_command_t::rdwr();
-	limit_set.rdwr(packet);
+	limit_set.rdwr(packet, packet->get_version());
 	packet->rdwr_bool(apply_limits);
 	dbg->warning("nwc_routesearch_t::rdwr", "rdwr limits=(%u, %u, %u, %llu, %u) apply_limits=%u",
 		limit_set.rebuild_connexions, limit_set.filter_eligible, limit_set.fill_matrix, limit_set.explore_paths, limit_set.reroute_goods, apply_limits);
@@ -1152,6 +1152,22 @@ bool nwc_service_t::execute(karte_t *welt)
 			break;
 		}
 
+		case SRVC_PROFILE:
+			if(  number != 0  &&  !profile_t::enabled  ) {
+				profile_t::reset();
+			}
+			profile_t::enabled = number != 0;
+			break;
+
+		case SRVC_PROFILE_DUMP: {
+			char filename[1024];
+			sprintf( filename, "%sprofile.txt", umgebung_t::user_dir );
+			if(  !profile_t::dump( filename )  ) {
+				dbg->error( "nwc_service_t::execute", "cannot write %s", filename );
+			}
+			break;
+		}
+
 		default: ;
 	}
 	return true; // to delete
@@ -70,10 +70,10 @@ char const* network_receive_file(SOCKET const s, char const* const save_as, long
 
 #include "loadsave.h"
 #include "gameinfo.h"
+#include "../simsys.h"
 #include "../simworld.h"
 #include "../utils/simstring.h"
 
-
 // connect to address (cp), receive gameinfo, close
 const char *network_gameinfo(const char *cp, gameinfo_t *gi)
 {
@@ -131,9 +131,10 @@ end:
 }
 
 
-// connect to address (cp), receive game, save to client%i-network.sve
-const char *network_connect(const char *cp, karte_t *world)
+// connect to address (cp), receive game (or leave it on the socket, if it is streamed)
+const char *network_connect(const char *cp, karte_t *world, network_game_stream_t *&stream)
 {
+	stream = NULL;
 	// open from network
 	const char *err = NULL;
 	SOCKET const my_client_socket = network_open_address(cp, err);
@@ -190,24 +191,17 @@ const char *network_connect(const char *cp, karte_t *world)
 			err = "Protocol error (expected NWC_GAME)";
 			goto end;
 		}
-		int len = ((nwc_game_t*)nwc)->len;
-		// guaranteed individual file name ...
-		char filename[256];
-		sprintf( filename, "client%i-network.sve", network_get_client_id() );
-		if(  err = network_receive_file( my_client_socket, filename, len )  ) {
-			goto end;
+		const uint32 len = ((nwc_game_t*)nwc)->len;
+		if(  len==NETWORK_STREAMED_GAME  ) {
+			// loaded from the socket while it is received
+			stream = new network_game_stream_t( my_client_socket );
 		}
-		// Knightly : update iteration limits
-		// wait for routesearch command (tolerate some wrong commands)
-		for(  uint8 i=0;  i<5;  ++i  ) {
-			nwc = network_check_activity( NULL, 10000 );
-			if(  nwc  &&  nwc->get_id()==NWC_ROUTESEARCH  ) break;
+		else {
+			// guaranteed individual file name ...
+			char filename[256];
+			sprintf( filename, "client%i-network.sve", network_get_client_id() );
+			err = network_receive_file( my_client_socket, filename, len );
 		}
-		if(  nwc==NULL  ||  nwc->get_id()!=NWC_ROUTESEARCH  ) {
-			err = "Protocol error (expected NWC_ROUTESEARCH)";
-			goto end;
-		}
-		((nwc_routesearch_t*)nwc)->do_command(world);
 	}
 end:
 	if(err) {
@@ -216,14 +210,37 @@ end:
 			network_close_socket( my_client_socket );
 		}
 	}
-	else {
-		const uint32 id = socket_list_t::get_client_id(my_client_socket);
-		socket_list_t::change_state(id, socket_info_t::playing);
-	}
 	return err;
 }
 
 
+const char *network_finish_join(karte_t *world)
+{
+	SOCKET const my_client_socket = socket_list_t::get_socket( network_get_client_id() );
+	const char *err = NULL;
+	// Knightly : update iteration limits
+	// wait for routesearch command (tolerate some wrong commands)
+	network_command_t *nwc = NULL;
+	for(  uint8 i=0;  i<5;  ++i  ) {
+		nwc = network_check_activity( NULL, 10000 );
+		if(  nwc  &&  nwc->get_id()==NWC_ROUTESEARCH  ) break;
+	}
+	if(  nwc==NULL  ||  nwc->get_id()!=NWC_ROUTESEARCH  ) {
+		err = "Protocol error (expected NWC_ROUTESEARCH)";
+		dbg->warning("network_finish_join", err);
+		if (!socket_list_t::remove_client(my_client_socket)) {
+			network_close_socket( my_client_socket );
+		}
+		return err;
+	}
+	((nwc_routesearch_t*)nwc)->do_command(world);
+
+	const uint32 id = socket_list_t::get_client_id(my_client_socket);
+	socket_list_t::change_state(id, socket_info_t::playing);
+	return NULL;
+}
+
+
 const char *network_send_file( uint32 client_id, const char *filename )
 {
 	FILE *fp = fopen(filename,"rb");
@@ -272,6 +289,143 @@ error:
 	return "Client closed connection during transfer";
 }
 
+// sends one chunk of a game, buffer has four free bytes in front of the data
+static bool send_game_chunk( SOCKET s, char *buffer, uint32 len )
+{
+	buffer[0] = (char)len;
+	buffer[1] = (char)(len >> 8);
+	buffer[2] = (char)(len >> 16);
+	buffer[3] = (char)(len >> 24);
+	uint16 sent;
+	return network_send_data( s, buffer, (uint16)(len+4), sent, 1000 )  &&  sent==len+4;
+}
+
+
+// sends everything written to the file of the game in chunks
+class game_sender_t : public loadsave_stream_t
+{
+private:
+	SOCKET s;
+	char buffer[4+GAME_CHUNK_SIZE];
+
+public:
+	bool failed;
+	uint32 bytes_sent;
+
+	game_sender_t(SOCKET s) : s(s), failed(false), bytes_sent(0) {}
+
+	virtual bool write(const void *buf, size_t len)
+	{
+		const char *p = (const char *)buf;
+		while(  len>0  &&  !failed  ) {
+			const size_t n = len < GAME_CHUNK_SIZE ? len : GAME_CHUNK_SIZE;
+			memcpy( buffer+4, p, n );
+			failed = !send_game_chunk( s, buffer, n );
+			bytes_sent += n;
+			p += n;
+			len -= n;
+		}
+		return !failed;
+	}
+
+	virtual bool read(void *, size_t) { return false; }
+
+	// the empty chunk at the end
+	bool finish()
+	{
+		failed = failed  ||  !send_game_chunk( s, buffer, 0 );
+		return !failed;
+	}
+};
+
+
+const char *network_send_game( uint32 client_id, karte_t *welt, const char *filename )
+{
+	SOCKET s = socket_list_t::get_socket(client_id);
+	nwc_game_t nwc(NETWORK_STREAMED_GAME);
+	if(  s==INVALID_SOCKET  ||  !nwc.send(s)  ) {
+		return "Client closed connection during transfer";
+	}
+
+	game_sender_t sender(s);
+	const uint32 start = dr_time();
+	// the file is still written: the server loads it too afterwards
+	welt->speichern( filename, SERVER_SAVEGAME_VER_NR, EXPERIMENTAL_VER_NR, false, &sender );
+	sender.finish();
+
+	const uint32 ms = max( dr_time()-start, 1 );
+	dbg->message( "network_send_game", "saved and sent %u bytes in %u ms (%u KB/s)", sender.bytes_sent, ms, (uint32)(sender.bytes_sent/ms) );
+	if(  sender.failed  ) {
+		socket_list_t::remove_client(s);
+		return "Client closed connection during transfer";
+	}
+	return NULL;
+}
+
+
+network_game_stream_t::network_game_stream_t(SOCKET s) :
+	s(s), pos(0), len(0), end(false), failed(false), bytes_received(0)
+{
+	start_time = dr_time();
+}
+
+
+bool network_game_stream_t::receive_chunk()
+{
+	if(  end  ||  failed  ) {
+		return false;
+	}
+	uint8 header[4];
+	uint16 received;
+	if(  !network_receive_data( s, header, 4, received, 60000 )  ||  received!=4  ) {
+		failed = true;
+		return false;
+	}
+	const uint32 n = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32)header[3] << 24);
+	if(  n==0  ) {
+		// end of game
+		end = true;
+		return false;
+	}
+	if(  n>GAME_CHUNK_SIZE  ||  !network_receive_data( s, buffer, (uint16)n, received, 60000 )  ||  received!=n  ) {
+		failed = true;
+		return false;
+	}
+	pos = 0;
+	len = n;
+	bytes_received += n;
+	return true;
+}
+
+
+bool network_game_stream_t::read(void *buf, size_t count)
+{
+	char *p = (char *)buf;
+	while(  count>0  ) {
+		if(  pos==len  &&  !receive_chunk()  ) {
+			return false;
+		}
+		const size_t n = count < len-pos ? count : len-pos;
+		memcpy( p, buffer+pos, n );
+		pos += n;
+		p += n;
+		count -= n;
+	}
+	return true;
+}
+
+
+const char *network_game_stream_t::finish()
+{
+	// the loader stops at the end of the data, the server may have sent more
+	while(  receive_chunk()  ) {
+	}
+	const uint32 ms = max( dr_time()-start_time, 1 );
+	dbg->message( "network_game_stream_t::finish", "received and loaded %u bytes in %u ms (%u KB/s)", bytes_received, ms, (uint32)(bytes_received/ms) );
+	return failed ? "Not enough bytes transferred" : NULL;
+}
+
+
 /*
   POST a message (poststr) to an HTTP server at the specified address and relative path (name)
   Optionally: Receive response to file localname
@@ -7,19 +7,67 @@
  */
 
 #include "network.h"
+#include "loadsave.h"
 
 class karte_t;
 class gameinfo_t;
 
+// nwc_game_t::len of a game sent by network_send_game()
+#define NETWORK_STREAMED_GAME (0xFFFFFFFFu)
+
+// payload of one chunk of network_send_game(); must fit into an uint16 with its header
+#define GAME_CHUNK_SIZE (32768)
+
+/**
+ * The game sent by network_send_game(), which the client loads while it is
+ * still received: chunks with their length in front, ended by an empty chunk.
+ */
+class network_game_stream_t : public loadsave_stream_t
+{
+private:
+	SOCKET s;
+	char buffer[GAME_CHUNK_SIZE];
+	uint32 pos, len;	// of the data left in buffer
+	bool end;	// the empty chunk has been received
+	bool failed;
+	uint32 bytes_received;
+	uint32 start_time;
+
+	bool receive_chunk();
+
+public:
+	network_game_stream_t(SOCKET s);
+
+	virtual bool write(const void *, size_t) { return false; }
+	virtual bool read(void *buf, size_t len);
+
+	// receives the rest of the game after loading; NULL or an error
+	const char *finish();
+};
+
 // connect to address (cp), receive gameinfo, close
 const char *network_gameinfo(const char *cp, gameinfo_t *gi);
 
-// connects to server at (cp), receives game, save to client%i-network.sve
-const char* network_connect(const char *cp, karte_t *world);
+/**
+ * Connects to the server at (cp) and joins. A streamed game is left on the
+ * socket for karte_t::laden(), which gets stream (to be deleted) to load it
+ * from. Other games are saved to client%i-network.sve and stream is NULL.
+ * After loading, network_finish_join() must be called.
+ */
+const char* network_connect(const char *cp, karte_t *world, network_game_stream_t *&stream);
+
+// receives the route search limits sent after the game, and starts to play
+const char *network_finish_join(karte_t *world);
 
 // sending file over network
 const char *network_send_file( uint32 client_id, const char *filename );
 
+/**
+ * Saves the game to filename (in the zipped_blocks format), and sends the
+ * same data to the client while it is saved, see network_game_stream_t.
+ */
+const char *network_send_game( uint32 client_id, karte_t *welt, const char *filename );
+
 // receive file
 char const* network_receive_file(SOCKET const s, char const* const save_as, long const length);
 
@@ -68,6 +68,8 @@ public:
 	// can we understand the received packet?
 	bool check_version() const { return is_saving() || (version <= NETWORK_VERSION); }
 
+	uint16 get_version() const { return version; }
+
 	uint16 get_id() const { return id; }
 	void set_id(uint16 id_) { id = id_; }
 
@@ -4,9 +4,17 @@
 #include "network_packet.h"
 #include "umgebung.h"
 
+#ifdef NETWORK_IO_THREAD
+simthread_mutex_t socket_list_t::mutex(true);
+#define SOCKET_LIST_LOCK SIMTHREAD_LOCK(socket_list_t::mutex)
+#else
+#define SOCKET_LIST_LOCK
+#endif
+
 
 void socket_info_t::reset()
 {
+	SOCKET_LIST_LOCK;
 	if (packet) {
 		delete packet;
 		packet = NULL;
@@ -22,13 +30,15 @@ void socket_info_t::reset()
 	}
 	state = inactive;
 	socket = INVALID_SOCKET;
+	failed = false;
 	player_unlocked = 0;
 }
 
 
 network_command_t* socket_info_t::receive_nwc()
 {
-	if (!is_active()) {
+	SOCKET_LIST_LOCK;
+	if (!is_active()  ||  failed) {
 		return NULL;
 	}
 	if (packet == NULL) {
@@ -39,7 +49,7 @@ network_command_t* socket_info_t::receive_nwc()
 
 	if (packet->has_failed()) {
 		// close this client (will delete packet)
-		socket_list_t::remove_client(socket);
+		socket_list_t::client_failed(socket);
 	}
 	else if (packet->is_ready()) {
 		// create command
@@ -54,12 +64,13 @@ network_command_t* socket_info_t::receive_nwc()
 
 void socket_info_t::process_send_queue()
 {
-	while(!send_queue.empty()) {
+	SOCKET_LIST_LOCK;
+	while(!send_queue.empty()  &&  !failed) {
 		packet_t *p = send_queue.front();
 		p->send(socket, false);
 		if (p->has_failed()) {
 			// close this client, clear the send_queue
-			socket_list_t::remove_client(socket);
+			socket_list_t::client_failed(socket);
 			break;
 		}
 		else if (p->is_ready()) {
@@ -77,6 +88,7 @@ void socket_info_t::process_send_queue()
 
 void socket_info_t::send_queue_append(packet_t *p)
 {
+	SOCKET_LIST_LOCK;
 	if (p) {
 		if (!p->has_failed()) {
 			send_queue.append(p);
@@ -106,6 +118,7 @@ uint32 socket_list_t::playing_clients;
  * client: number of server connections
  */
 uint32 socket_list_t::server_sockets;
+bool socket_list_t::defer_removal = false;
 
 /**
  * book-keeping for the number of connected / playing clients
@@ -131,6 +144,7 @@ void socket_list_t::book_state_change(uint8 state, sint8 incr)
 
 void socket_list_t::change_state(uint32 id, uint8 new_state)
 {
+	SOCKET_LIST_LOCK;
 	book_state_change(list[id]->state, -1);
 	list[id]->state = new_state;
 	list[id]->player_unlocked = 0;
@@ -140,6 +154,7 @@ void socket_list_t::change_state(uint32 id, uint8 new_state)
 
 void socket_list_t::reset()
 {
+	SOCKET_LIST_LOCK;
 	FOR(vector_tpl<socket_info_t*>, const i, list) {
 		i->reset();
 	}
@@ -155,6 +170,7 @@ void socket_list_t::reset()
 
 void socket_list_t::reset_clients()
 {
+	SOCKET_LIST_LOCK;
 	for(uint32 j=server_sockets; j<list.get_count(); j++) {
 		list[j]->reset();
 	}
@@ -169,6 +185,7 @@ void socket_list_t::reset_clients()
 
 void socket_list_t::add_client( SOCKET sock, uint32 ip )
 {
+	SOCKET_LIST_LOCK;
 	dbg->message("socket_list_t::add_client", "add client socket[%d] at address %xd", sock, ip);
 	uint32 i = list.get_count();
 	// check whether socket already added
@@ -193,6 +210,7 @@ void socket_list_t::add_client( SOCKET sock, uint32 ip )
 
 void socket_list_t::add_server( SOCKET sock )
 {
+	SOCKET_LIST_LOCK;
 	dbg->message("socket_list_t::add_server", "add server socket[%d]", sock);
 	assert(connected_clients==0  &&  playing_clients==0);
 	uint32 i = server_sockets;
@@ -218,6 +236,7 @@ void socket_list_t::add_server( SOCKET sock )
 
 bool socket_list_t::remove_client( SOCKET sock )
 {
+	SOCKET_LIST_LOCK;
 	dbg->message("socket_list_t::remove_client", "remove client socket[%d]", sock);
 	for(uint32 j=0; j<list.get_count(); j++) {
 		if (list[j]->socket == sock) {
@@ -235,6 +254,48 @@ bool socket_list_t::remove_client( SOCKET sock )
 }
 
 
+void socket_list_t::client_failed( SOCKET sock )
+{
+	SOCKET_LIST_LOCK;
+	if (!defer_removal) {
+		remove_client(sock);
+		return;
+	}
+	for(uint32 j=0; j<list.get_count(); j++) {
+		if (list[j]->is_active()  &&  list[j]->socket == sock) {
+			list[j]->failed = true;
+		}
+	}
+}
+
+
+void socket_list_t::remove_failed_clients()
+{
+	SOCKET_LIST_LOCK;
+	for(uint32 j=0; j<list.get_count(); j++) {
+		if (list[j]->failed) {
+			remove_client(list[j]->socket);
+		}
+	}
+}
+
+
+SOCKET socket_list_t::get_socket( uint32 client_id )
+{
+	SOCKET_LIST_LOCK;
+	return client_id < list.get_count()  &&  list[client_id]->state != socket_info_t::inactive
+		? list[client_id]->socket : INVALID_SOCKET;
+}
+
+
+socket_info_t& socket_list_t::get_client(uint32 client_id )
+{
+	SOCKET_LIST_LOCK;
+	assert (client_id < list.get_count());
+	return *list[client_id];
+}
+
+
 bool socket_list_t::has_client( SOCKET sock )
 {
 	return get_client_id(sock) < list.get_count();
@@ -242,6 +303,7 @@ bool socket_list_t::has_client( SOCKET sock )
 
 
 uint32 socket_list_t::get_client_id( SOCKET sock ){
+	SOCKET_LIST_LOCK;
 	for(uint32 j=0; j<list.get_count(); j++) {
 		if (list[j]->state != socket_info_t::inactive  &&  list[j]->socket == sock) {
 			return j;
@@ -253,6 +315,7 @@ uint32 socket_list_t::get_client_id( SOCKET sock ){
 
 void socket_list_t::unlock_player_all(uint8 player_nr, bool unlock, uint32 except_client)
 {
+	SOCKET_LIST_LOCK;
 // nettool does not know about nwc_auth_player_t
 #ifndef NETTOOL
 	for(uint32 i=0; i<list.get_count(); i++) {
@@ -289,6 +352,7 @@ void socket_list_t::unlock_player_all(uint8 player_nr, bool unlock, uint32 excep
 
 void socket_list_t::send_all(network_command_t* nwc, bool only_playing_clients)
 {
+	SOCKET_LIST_LOCK;
 	if (nwc == NULL) {
 		return;
 	}
@@ -305,9 +369,26 @@ void socket_list_t::send_all(network_command_t* nwc, bool only_playing_clients)
 
 SOCKET socket_list_t::fill_set(fd_set *fds)
 {
+	SOCKET_LIST_LOCK;
 	SOCKET s_max = 0;
 	FOR(vector_tpl<socket_info_t*>, const i, list) {
-		if (i->state != socket_info_t::inactive && i->socket != INVALID_SOCKET) {
+		if (i->state != socket_info_t::inactive && i->socket != INVALID_SOCKET  &&  !i->failed) {
+			SOCKET const s = i->socket;
+			s_max = max( s, s_max );
+			FD_SET( s, fds );
+		}
+	}
+	return s_max+1;
+}
+
+
+SOCKET socket_list_t::fill_send_set(fd_set *fds)
+{
+	SOCKET_LIST_LOCK;
+	SOCKET s_max = 0;
+	for(uint32 j=server_sockets; j<list.get_count(); j++) {
+		socket_info_t const* const i = list[j];
+		if (i->is_active()  &&  i->socket != INVALID_SOCKET  &&  !i->failed  &&  i->has_pending_send()) {
 			SOCKET const s = i->socket;
 			s_max = max( s, s_max );
 			FD_SET( s, fds );
@@ -319,6 +400,7 @@ SOCKET socket_list_t::fill_set(fd_set *fds)
 
 SOCKET socket_list_t::fd_isset(fd_set *fds, bool use_server_sockets, uint32 *offset)
 {
+	SOCKET_LIST_LOCK;
 	const uint32 begin = offset ? *offset : (use_server_sockets ? 0 : server_sockets);
 	const uint32 end   = use_server_sockets ? server_sockets : list.get_count();
 
@@ -364,6 +446,7 @@ bool socket_list_t::client_socket_iterator_t::next()
 
 void socket_list_t::rdwr(packet_t *p, vector_tpl<socket_info_t*> *list)
 {
+	SOCKET_LIST_LOCK;
 	assert(p->is_saving()  ||  list!=&socket_list_t::list);
 	uint32 count = list->get_count();
 	p->rdwr_long(count);
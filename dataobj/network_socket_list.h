@@ -7,6 +7,12 @@
 #include "../tpl/vector_tpl.h"
 #include <string>
 
+#if defined(MULTI_THREAD)  &&  !defined(NETTOOL)
+// the server may receive and send in its own thread (see network.cc)
+#define NETWORK_IO_THREAD
+#include "../utils/simthread.h"
+#endif
+
 class network_command_t;
 class packet_t;
 
@@ -30,7 +36,13 @@ public:
 
 	net_address_t address;
 
-	socket_info_t() : packet(0), send_queue(), state(inactive), socket(INVALID_SOCKET), address(), player_unlocked(0) {}
+	/**
+	 * set if receiving or sending failed while socket_list_t::defer_removal was set,
+	 * the client is removed by socket_list_t::remove_failed_clients()
+	 */
+	bool failed;
+
+	socket_info_t() : packet(0), send_queue(), state(inactive), socket(INVALID_SOCKET), address(), failed(false), player_unlocked(0) {}
 
 	~socket_info_t();
 
@@ -56,6 +68,8 @@ public:
 
 	void send_queue_append(packet_t *p);
 
+	bool has_pending_send() const { return !send_queue.empty(); }
+
 	/**
 	 * rdwr client information to packet
 	 */
@@ -86,7 +100,18 @@ private:
 	static uint32 playing_clients;
 	static uint32 server_sockets;
 
+	// when set, failing clients are only marked (network thread must not remove them)
+	static bool defer_removal;
+
 public:
+#ifdef NETWORK_IO_THREAD
+	/**
+	 * guards the list, all packets and send queues, as the network thread
+	 * works on them too; it is recursive, so the functions of this class may
+	 * be called while holding it
+	 */
+	static simthread_mutex_t mutex;
+#endif
 
 	static uint32 get_server_sockets() { return server_sockets; }
 	static uint32 get_connected_clients() { return connected_clients; }
@@ -125,19 +150,26 @@ public:
 
 	static uint32 get_client_id( SOCKET sock );
 
+	/**
+	 * receiving or sending to this client failed:
+	 * removes it, or only marks it if removal is deferred
+	 */
+	static void client_failed( SOCKET sock );
+
+	static void set_defer_removal( bool defer ) { defer_removal = defer; }
+
+	/**
+	 * removes all clients marked by client_failed()
+	 */
+	static void remove_failed_clients();
+
 	static bool is_valid_client_id( uint32 client_id ) {
 		return client_id < list.get_count();
 	}
 
-	static SOCKET get_socket( uint32 client_id ) {
-		return client_id < list.get_count()  &&  list[client_id]->state != socket_info_t::inactive
-			? list[client_id]->socket : INVALID_SOCKET;
-	}
+	static SOCKET get_socket( uint32 client_id );
 
-	static socket_info_t& get_client(uint32 client_id ) {
-		assert (client_id < list.get_count());
-		return *list[client_id];
-	}
+	static socket_info_t& get_client(uint32 client_id );
 
 	/**
 	 * @return for client returns socket of connection to server
@@ -176,6 +208,11 @@ public: // from now stuff to deal with fd_set's
 	 */
 	static SOCKET fill_set(fd_set *fds);
 
+	/**
+	 * fill set with all client sockets with something to send
+	 */
+	static SOCKET fill_send_set(fd_set *fds);
+
 	/**
 	 * iterators to iterate through all sockets whose bits are set in fd_set
 	 */
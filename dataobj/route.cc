@@ -22,6 +22,8 @@
 #include "loadsave.h"
 #include "route.h"
 #include "umgebung.h"
+#include "../utils/worker_pool.h"
+#include "../utils/simprofile.h"
 
 
 // if defined, print some profiling informations into the file
@@ -38,7 +40,7 @@
 // sorted heap, since we only need insert and pop
 //#include "../tpl/sorted_heap_tpl.h" // ~10% slower
 
-// binary heap, the fastest
+// binary heap, the fastest (the open lists of search_context_t)
 #include "../tpl/binary_heap_tpl.h" // fastest
 
 
@@ -146,57 +148,140 @@ static bool is_in_list(vector_tpl<route_t::ANode*> const& list, grund_t const* c
 // node arrays
 uint32 route_t::MAX_STEP=0;
 uint32 route_t::max_used_steps=0;
-route_t::ANode *route_t::_nodes[MAX_NODES_ARRAY];
-bool route_t::_nodes_in_use[MAX_NODES_ARRAY]; // semaphores, since we only have few nodes arrays in memory
+route_t::search_context_t *route_t::main_context = NULL;
 
-void route_t::INIT_NODES(uint32 max_route_steps, uint32 world_width, uint32 world_height)
+// contexts for route_batch_t, one per thread
+static vector_tpl<route_t::search_context_t *> batch_contexts;
+
+
+route_t::search_context_t::search_context_t(bool main) :
+	nodes_size(0),
+	marker_size(0,0),
+	closed_nodes(NULL),
+	closed_nodes_bits(0),
+	main_thread(main)
 {
 	for (int i = 0; i < MAX_NODES_ARRAY; ++i)
 	{
-		_nodes[i] = NULL;
-		_nodes_in_use[i] = false;
+		nodes[i] = NULL;
+		nodes_in_use[i] = false;
 	}
+}
 
-	// may need very much memory => configurable
-	MAX_STEP = min(max_route_steps, world_width * world_height); 
+route_t::search_context_t::~search_context_t()
+{
 	for (int i = 0; i < MAX_NODES_ARRAY; ++i)
 	{
-		_nodes[i] = new ANode[MAX_STEP + 4 + 2];
+		delete [] nodes[i];
 	}
+	delete [] closed_nodes;
 }
 
-void route_t::TERM_NODES()
+void route_t::search_context_t::prepare(const karte_t *welt)
 {
-	if (MAX_STEP)
-	{
-		MAX_STEP = 0;
-		for (int i = 0; i < MAX_NODES_ARRAY; ++i)
-		{
-			delete [] _nodes[i];
-			_nodes[i] = NULL;
-			_nodes_in_use[i] = false;
+	const koord size( welt->get_groesse_x(), welt->get_groesse_y() );
+	for(  int i=0;  i<2;  i++  ) {
+		if(  size != marker_size  ) {
+			closed[i].init( size.x, size.y );
 		}
+		else {
+			closed[i].unmarkiere_alle();
+		}
+		queue[i].clear();
 	}
+	marker_size = size;
 }
 
-uint8 route_t::GET_NODES(ANode **nodes) 
+void route_t::search_context_t::prepare_closed_nodes()
 {
+	// at most half full
+	uint8 bits = 4;
+	while(  ((uint32)1 << bits) < 2*MAX_STEP  ) {
+		bits ++;
+	}
+	if(  bits != closed_nodes_bits  ) {
+		delete [] closed_nodes;
+		closed_nodes = new uint32[(uint32)1 << bits];
+		closed_nodes_bits = bits;
+	}
+	memset( closed_nodes, 0, sizeof(uint32) << bits );
+}
+
+uint8 route_t::search_context_t::get_nodes(ANode **n)
+{
+	if (nodes_size != MAX_STEP)
+	{
+		// MAX_STEP changed since the arrays were allocated
+		for (int i = 0; i < MAX_NODES_ARRAY; ++i)
+		{
+			if (nodes_in_use[i])
+				dbg->fatal("GET_NODE","route steps changed while list in use");
+			delete [] nodes[i];
+			nodes[i] = NULL;
+		}
+		nodes_size = MAX_STEP;
+	}
 	for (int i = 0; i < MAX_NODES_ARRAY; ++i)
-		if (!_nodes_in_use[i])
+		if (!nodes_in_use[i])
 		{
-			_nodes_in_use[i] = true;
-			*nodes = _nodes[i];
+			if (nodes[i] == NULL)
+			{
+				// may need very much memory => only allocated when used
+				nodes[i] = new ANode[MAX_STEP + 4 + 2];
+			}
+			nodes_in_use[i] = true;
+			*n = nodes[i];
 			return i;
 		}
 	dbg->fatal("GET_NODE","called while list in use");
 	return 0;
 }
 
-void route_t::RELEASE_NODES(uint8 nodes_index) 
+void route_t::search_context_t::release_nodes(uint8 nodes_index)
 {
-	if (!_nodes_in_use[nodes_index])
+	if (!nodes_in_use[nodes_index])
 		dbg->fatal("RELEASE_NODE","called while list free"); 
-	_nodes_in_use[nodes_index] = false; 
+	nodes_in_use[nodes_index] = false; 
+}
+
+
+void route_t::INIT_NODES(uint32 max_route_steps, uint32 world_width, uint32 world_height)
+{
+	// may need very much memory => configurable
+	MAX_STEP = min(max_route_steps, world_width * world_height); 
+}
+
+void route_t::TERM_NODES()
+{
+	if (MAX_STEP)
+	{
+		MAX_STEP = 0;
+		delete main_context;
+		main_context = NULL;
+		FOR(vector_tpl<search_context_t *>, const c, batch_contexts) {
+			delete c;
+		}
+		batch_contexts.clear();
+	}
+}
+
+route_t::search_context_t &route_t::get_main_context()
+{
+	if (main_context == NULL)
+	{
+		main_context = new search_context_t(true);
+	}
+	return *main_context;
+}
+
+uint8 route_t::GET_NODES(ANode **nodes) 
+{
+	return get_main_context().get_nodes(nodes);
+}
+
+void route_t::RELEASE_NODES(uint8 nodes_index) 
+{
+	get_main_context().release_nodes(nodes_index);
 }
 
 
@@ -205,6 +290,7 @@ void route_t::RELEASE_NODES(uint8 nodes_index)
  */
 bool route_t::find_route(karte_t *welt, const koord3d start, fahrer_t *fahr, const uint32 /*max_khm*/, uint8 start_dir, uint32 weight, uint32 max_depth )
 {
+	profile_scope_t profile( profile_t::route_search );
 	bool ok = false;
 
 	// check for existing koordinates
@@ -326,6 +412,7 @@ bool route_t::find_route(karte_t *welt, const koord3d start, fahrer_t *fahr, con
 		start_dir = ribi_t::alle;
 
 	} while(  !open.empty()  &&  step < MAX_STEP  &&  open.get_count() < max_depth  );
+	profile_t::count( profile_t::route_nodes, step );
 
 	INT_CHECK("route 194");
 
@@ -354,9 +441,9 @@ bool route_t::find_route(karte_t *welt, const koord3d start, fahrer_t *fahr, con
 
 
 
-ribi_t::ribi *get_next_dirs(const koord gr_pos, const koord ziel)
+// fills next_ribi with the four directions, the ones towards ziel first
+static void get_next_dirs(const koord gr_pos, const koord ziel, ribi_t::ribi *next_ribi)
 {
-	static ribi_t::ribi next_ribi[4];
 	if( abs(gr_pos.x-ziel.x)>abs(gr_pos.y-ziel.y) ) {
 		next_ribi[0] = (ziel.x>gr_pos.x) ? ribi_t::ost : ribi_t::west;
 		next_ribi[1] = (ziel.y>gr_pos.y) ? ribi_t::sued : ribi_t::nord;
@@ -367,19 +454,18 @@ ribi_t::ribi *get_next_dirs(const koord gr_pos, const koord ziel)
 	}
 	next_ribi[2] = ribi_t::rueckwaerts( next_ribi[1] );
 	next_ribi[3] = ribi_t::rueckwaerts( next_ribi[0] );
-	return next_ribi;
 }
 
 
 
-bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d start, fahrer_t *fahr, const sint32 max_speed, const uint32 max_cost, const uint32 weight)
+route_t::search_result_t route_t::intern_calc_route(search_context_t &context, karte_t *welt, const koord3d ziel, const koord3d start, fahrer_t *fahr, const sint32 max_speed, const uint32 max_cost, const uint32 weight)
 {
-	bool ok = false;
+	search_result_t result = search_failed;
 
 	// check for existing koordinates
 	const grund_t *gr=welt->lookup(start);
 	if(gr==NULL  ||  welt->lookup(ziel)==NULL) {
-		return false;
+		return search_failed;
 	}
 
 	// we clear it here probably twice: does not hurt ...
@@ -388,7 +474,7 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 
 	// first tile is not valid?!?
 	if(!fahr->ist_befahrbar(gr)) {
-		return false;
+		return search_failed;
 	}
 
 	// some thing for the search
@@ -401,35 +487,25 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 	// memory in static list ...
 	if(!MAX_STEP)
 	{
+		assert(context.main_thread);
 		INIT_NODES(welt->get_settings().get_max_route_steps(), welt->get_groesse_x(), welt->get_groesse_y());
 	}
 
-	INT_CHECK("route 347");
+	if(context.main_thread) {
+		INT_CHECK("route 347");
+	}
 
-	// there are several variant for maintaining the open list
-	// however, only binary heap and HOT queue with binary heap are worth considering
-#if defined(tpl_HOT_queue_tpl_h)
-    ///static 
-	HOT_queue_tpl <ANode *> queue;
-#elif defined(tpl_binary_heap_tpl_h)
-    //static 
-	binary_heap_tpl <ANode *> queue;
-#elif defined(tpl_sorted_heap_tpl_h)
-    //static 
-	sorted_heap_tpl <ANode *> queue;
-#else
-    //static 
-	prioqueue_tpl <ANode *> queue;
-#endif
+	// open and closed list of this context
+	binary_heap_tpl <ANode *> &queue = context.queue[0];
+	marker_t &closed = context.closed[0];
+	context.prepare(welt);
 
 	ANode *nodes;
-	uint8 ni = GET_NODES(&nodes);
+	uint8 ni = context.get_nodes(&nodes);
 
 	uint32 step = 0;
 	ANode* tmp = &nodes[step];
 	step ++;
-	if (route_t::max_used_steps < step)
-		route_t::max_used_steps = step;
 
 	tmp->parent = NULL;
 	tmp->gr = welt->lookup(start);
@@ -438,11 +514,6 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 	tmp->dir = 0;
 	tmp->count = 0;
 
-	// nothing in lists
-	welt->unmarkiere_alle();
-
-	// clear the queue (should be empty anyhow)
-	queue.clear();
 	queue.insert(tmp);
 
 //DBG_MESSAGE("route_t::itern_calc_route()","calc route from %d,%d,%d to %d,%d,%d",ziel.x, ziel.y, ziel.z, start.x, start.y, start.z);
@@ -450,14 +521,14 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 	uint32 beat=1;
 	do {
 		// Hajo: this is too expensive to be called each step
-		if((beat++ & 255) == 0) 
+		if((beat++ & 255) == 0  &&  context.main_thread) 
 		{
 			INT_CHECK("route 161");
 		}
 
 		ANode *test_tmp = queue.pop();
 
-		if(welt->ist_markiert(test_tmp->gr))
+		if(closed.ist_markiert(test_tmp->gr))
 		{
 			// we were already here on a faster route, thus ignore this branch
 			// (trading speed against memory consumption)
@@ -466,7 +537,7 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 
 		tmp = test_tmp;
 		gr = tmp->gr;
-		welt->markiere(gr);
+		closed.markiere(gr);
 
 //DBG_DEBUG("add to close","(%i,%i,%i) f=%i",gr->get_pos().x,gr->get_pos().y,gr->get_pos().z,tmp->f);
 
@@ -479,7 +550,8 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 
 		// testing all four possible directions
 		const ribi_t::ribi ribi =  fahr->get_ribi(gr);
-		const ribi_t::ribi *next_ribi = get_next_dirs(gr->get_pos().get_2d(),ziel.get_2d());
+		ribi_t::ribi next_ribi[4];
+		get_next_dirs(gr->get_pos().get_2d(), ziel.get_2d(), next_ribi);
 		for(int r=0; r<4; r++) {
 
 			// a way in our direction?
@@ -499,7 +571,7 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 			}
 
 			// a way goes here, and it is not marked (i.e. in the closed list)
-			if((to  ||  gr->get_neighbour(to, wegtyp, next_ribi[r]))  &&  fahr->ist_befahrbar(to)  &&  !welt->ist_markiert(to)) 
+			if((to  ||  gr->get_neighbour(to, wegtyp, next_ribi[r]))  &&  fahr->ist_befahrbar(to)  &&  !closed.ist_markiert(to)) 
 			{
 				// Do not go on a tile, where a oneway sign forbids going.
 				// This saves time and fixed the bug, that a oneway sign on the final tile was ignored.
@@ -558,8 +630,6 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 				// add new
 				ANode* k = &nodes[step];
 				step ++;
-				if (route_t::max_used_steps < step)
-					route_t::max_used_steps = step;
 
 				k->parent = tmp;
 				k->gr = to;
@@ -573,6 +643,7 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 		}
 
 	} while (!queue.empty() && !ziel_erreicht && step < MAX_STEP && tmp->g < max_cost);
+	profile_t::count( profile_t::route_nodes, step );
 
 #ifdef DEBUG_ROUTES
 	// display marked route
@@ -580,11 +651,17 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 	DBG_DEBUG("route_t::intern_calc_route()","steps=%i  (max %i) in route, open %i, cost %u (max %u)",step,MAX_STEP,queue.get_count(),tmp->g,max_cost);
 #endif
 
-	INT_CHECK("route 194");
+	if(context.main_thread) {
+		INT_CHECK("route 194");
+		if (route_t::max_used_steps < step)
+			route_t::max_used_steps = step;
+	}
+
 	// target reached?
 	if(!ziel_erreicht  || step >= MAX_STEP  ||  tmp->parent==NULL) {
 		if(  step >= MAX_STEP  ) {
 			dbg->warning("route_t::intern_calc_route()","Too many steps (%i>=max %i) in route (too long/complex)",step,MAX_STEP);
+			result = search_out_of_steps;
 		}
 	}
 	else {
@@ -596,11 +673,247 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
 //DBG_DEBUG("add","%i,%i at pos %i",tmp->gr->get_pos().x,tmp->gr->get_pos().y,tmp->count);
 			tmp = tmp->parent;
 		}
-		ok = true;
+		result = search_succeeded;
 	}
 
-	RELEASE_NODES(ni);
-	return ok;
+	context.release_nodes(ni);
+	return result;
+}
+
+
+
+// start slot of a tile closed by one half of the bidirectional search in search_context_t::closed_nodes
+static inline uint32 closed_node_hash(const grund_t *gr, const int side, const uint8 bits)
+{
+	return ( ((uint32)((size_t)gr >> 3) * 2u + (uint32)side) * 2654435761u ) >> (32 - bits);
+}
+
+
+route_t::search_result_t route_t::intern_calc_route_bidirectional(search_context_t &context, karte_t *welt, const koord3d ziel, const koord3d start, fahrer_t *fahr, const sint32 max_speed, const uint32 max_cost, const uint32 weight)
+{
+	// index 0 is the forward half (from start), index 1 the backward half (from ziel)
+	const grund_t *end_gr[2] = { welt->lookup(start), welt->lookup(ziel) };
+	if(  end_gr[0]==NULL  ||  end_gr[1]==NULL  ||  !fahr->ist_befahrbar(end_gr[0])  ||  !fahr->ist_befahrbar(end_gr[1])  ) {
+		return search_failed;
+	}
+	const koord3d heuristic_target[2] = { ziel, start };
+
+	route.clear();
+	max_weight = MAXUINT32;
+
+	if(!MAX_STEP)
+	{
+		assert(context.main_thread);
+		INIT_NODES(welt->get_settings().get_max_route_steps(), welt->get_groesse_x(), welt->get_groesse_y());
+	}
+
+	if(context.main_thread) {
+		INT_CHECK("route 640");
+	}
+
+	const waytype_t wegtyp = fahr->get_waytype();
+	const bool is_airplane = wegtyp==air_wt;
+	const uint8 enforce_weight_limits = welt->get_settings().get_enforce_weight_limits();
+
+	binary_heap_tpl <ANode *> *queue = context.queue;
+	marker_t *closed = context.closed;
+	context.prepare(welt);
+
+	// both halves share one node array : forward nodes are taken from the front, backward nodes from the back
+	ANode *nodes;
+	uint8 ni = context.get_nodes(&nodes);
+	uint32 used[2] = { 0, 0 };
+
+	for(  int side=0;  side<2;  side++  ) {
+		ANode *root = side==0 ? &nodes[used[0]] : &nodes[MAX_STEP-1-used[1]];
+		used[side] ++;
+		root->parent = NULL;
+		root->gr = end_gr[side];
+		root->f = calc_distance( end_gr[side]->get_pos(), heuristic_target[side] );
+		root->g = 0;
+		root->dir = 0;
+		root->count = 0;
+		queue[side].insert(root);
+	}
+
+	context.prepare_closed_nodes();
+	uint32 *const closed_nodes = context.closed_nodes;
+	const uint32 closed_nodes_mask = ((uint32)1 << context.closed_nodes_bits) - 1;
+
+	// cheapest route found so far, through the tile where the halves meet
+	ANode *meeting[2] = { NULL, NULL };
+	uint32 best_cost = MAXUINT32;
+	uint32 last_g[2] = { 0, 0 };
+	uint32 beat=1;
+	while(  (!queue[0].empty()  ||  !queue[1].empty())  &&  used[0]+used[1] < MAX_STEP  &&  last_g[0]+last_g[1] < max_cost  ) {
+		// Hajo: this is too expensive to be called each step
+		if((beat++ & 255) == 0  &&  context.main_thread)
+		{
+			INT_CHECK("route 161");
+		}
+
+		if(  meeting[0]  ) {
+			// f of the first open node of a half is a lower bound of every route not found yet
+			// -> the best route is proven to be the cheapest once one of these bounds reaches its cost
+			if(  (!queue[0].empty()  &&  queue[0].front()->f >= best_cost)  ||  (!queue[1].empty()  &&  queue[1].front()->f >= best_cost)  ) {
+				break;
+			}
+		}
+
+		// always continue the half with the smaller open list
+		const int side = queue[0].empty()  ||  (!queue[1].empty()  &&  queue[1].get_count() < queue[0].get_count()) ? 1 : 0;
+		const int other = 1-side;
+
+		ANode *tmp = queue[side].pop();
+		const grund_t *gr = tmp->gr;
+		if(  closed[side].ist_markiert(gr)  ) {
+			// we were already here on a faster route
+			continue;
+		}
+		closed[side].markiere(gr);
+		uint32 slot = closed_node_hash( gr, side, context.closed_nodes_bits );
+		while(  closed_nodes[slot]  ) {
+			slot = (slot + 1) & closed_nodes_mask;
+		}
+		closed_nodes[slot] = (uint32)(tmp - nodes) + 1;
+		last_g[side] = tmp->g;
+
+		if(  closed[other].ist_markiert(gr)  ) {
+			// the halves meet here : routes going on from this tile are covered by the other half
+			ANode *other_node = NULL;
+			for(  slot = closed_node_hash( gr, other, context.closed_nodes_bits );  other_node == NULL;  slot = (slot + 1) & closed_nodes_mask  ) {
+				ANode *const n = &nodes[ closed_nodes[slot] - 1 ];
+				// forward nodes are taken from the front of the array
+				if(  n->gr == gr  &&  (n < nodes + used[0]) == (other == 0)  ) {
+					other_node = n;
+				}
+			}
+			if(  tmp->g + other_node->g < best_cost  ) {
+				best_cost = tmp->g + other_node->g;
+				meeting[side] = tmp;
+				meeting[other] = other_node;
+			}
+			continue;
+		}
+
+		ribi_t::ribi next_ribi[4];
+		get_next_dirs(gr->get_pos().get_2d(), heuristic_target[side].get_2d(), next_ribi);
+		for(  int r=0;  r<4;  r++  ) {
+
+			grund_t *to = NULL;
+			if(is_airplane)
+			{
+				const planquadrat_t *pl=welt->lookup(gr->get_pos().get_2d()+koord(next_ribi[r]));
+				if(pl)
+				{
+					to = pl->get_kartenboden();
+				}
+			}
+
+			if(  !(to  ||  gr->get_neighbour(to, wegtyp, next_ribi[r]))  ||  !fahr->ist_befahrbar(to)  ||  closed[side].ist_markiert(to)  ) {
+				continue;
+			}
+
+			// the backward half walks against the direction of travel:
+			// directions, one-way signs, weight limits and costs always refer to the step in direction of travel
+			const grund_t *from_gr = side==0 ? gr : to;
+			const grund_t *to_gr = side==0 ? to : gr;
+			const ribi_t::ribi travel_dir = side==0 ? next_ribi[r] : ribi_t::rueckwaerts(next_ribi[r]);
+			if(  (fahr->get_ribi(from_gr) & travel_dir)==0  ) {
+				continue;
+			}
+
+			weg_t *w = to_gr->get_weg(wegtyp);
+			if(  w  &&  (travel_dir & w->get_ribi_maske())!=0  ) {
+				// Do not go on a tile, where a oneway sign forbids going.
+				continue;
+			}
+
+			if (enforce_weight_limits && w != NULL)
+			{
+				const uint32 way_max_weight = w->get_max_weight();
+				max_weight = min(max_weight, way_max_weight);
+
+				if(enforce_weight_limits == 2 && weight > way_max_weight)
+				{
+					// Avoid routing over ways for which the convoy is overweight.
+					continue;
+				}
+			}
+
+			uint32 new_g = tmp->g + (w ? fahr->get_kosten(to_gr, max_speed, from_gr->get_pos().get_2d()) : 1);
+
+			// same curve penalties as in intern_calc_route()
+			uint8 current_dir;
+			if(tmp->parent!=NULL)
+			{
+				current_dir = ribi_typ( tmp->parent->gr->get_pos().get_2d(), to->get_pos().get_2d() );
+				if(tmp->dir!=current_dir)
+				{
+					new_g += 3;
+					if(tmp->parent->dir!=tmp->dir  &&  tmp->parent->parent!=NULL) {
+						new_g += 10;
+					}
+					else if(ribi_t::ist_exakt_orthogonal(tmp->dir,current_dir))
+					{
+						new_g += 25;
+					}
+				}
+			}
+			else
+			{
+				current_dir = ribi_typ( gr->get_pos().get_2d(), to->get_pos().get_2d() );
+			}
+
+			if(  used[0]+used[1] >= MAX_STEP  ) {
+				// the halves would overlap in the node array
+				break;
+			}
+			ANode *k = side==0 ? &nodes[used[0]] : &nodes[MAX_STEP-1-used[1]];
+			used[side] ++;
+
+			k->parent = tmp;
+			k->gr = to;
+			k->g = new_g;
+			k->f = new_g + calc_distance( to->get_pos(), heuristic_target[side] );
+			k->dir = current_dir;
+			k->count = tmp->count+1;
+
+			queue[side].insert( k );
+		}
+	}
+
+	profile_t::count( profile_t::route_nodes, used[0]+used[1] );
+	if(context.main_thread) {
+		INT_CHECK("route 194");
+		if (route_t::max_used_steps < used[0]+used[1])
+			route_t::max_used_steps = used[0]+used[1];
+	}
+
+	// out of steps after the halves have met still gives a valid, if possibly not the cheapest, route
+	search_result_t result = search_failed;
+	if(  meeting[0]==NULL  ) {
+		if(  used[0]+used[1] >= MAX_STEP  ) {
+			dbg->warning("route_t::intern_calc_route_bidirectional()","Too many steps (%i>=max %i) in route (too long/complex)",used[0]+used[1],MAX_STEP);
+			result = search_out_of_steps;
+		}
+	}
+	else {
+		// forward half : start .. meeting tile, backward half : behind the meeting tile .. ziel
+		const uint32 length = meeting[0]->count + meeting[1]->count;
+		route.clear();
+		route.resize(length+16);
+		for(  ANode *n=meeting[0];  n!=NULL;  n=n->parent  ) {
+			route.store_at( n->count, n->gr->get_pos() );
+		}
+		for(  ANode *n=meeting[1]->parent;  n!=NULL;  n=n->parent  ) {
+			route.store_at( length - n->count, n->gr->get_pos() );
+		}
+		result = search_succeeded;
+	}
+
+	context.release_nodes(ni);
+	return result;
 }
 
 
@@ -610,25 +923,42 @@ bool route_t::intern_calc_route(karte_t *welt, const koord3d ziel, const koord3d
  * corrected 12/2005 for station search
  * @author Hansjrg Malthaner, prissi
  */
-bool route_t::calc_route(karte_t *welt, const koord3d ziel, const koord3d start, fahrer_t *fahr, const sint32 max_khm, const uint32 weight, sint32 max_len, const uint32 max_cost)
+bool route_t::calc_route(karte_t *welt, const koord3d ziel, const koord3d start, fahrer_t *fahr, const sint32 max_khm, const uint32 weight, sint32 max_len, const uint32 max_cost, const bool allow_bidirectional)
 {
+	return calc_route(get_main_context(), welt, ziel, start, fahr, max_khm, weight, max_len, max_cost, allow_bidirectional);
+}
+
+
+bool route_t::calc_route(search_context_t &context, karte_t *welt, const koord3d ziel, const koord3d start, fahrer_t *fahr, const sint32 max_khm, const uint32 weight, sint32 max_len, const uint32 max_cost, const bool allow_bidirectional)
+{
+	profile_scope_t profile( profile_t::route_search );
 	route.clear();
 
-	INT_CHECK("route 336");
+	if(context.main_thread) {
+		INT_CHECK("route 336");
+	}
 
 #ifdef DEBUG_ROUTES
 	// profiling for routes ...
 	long ms=dr_time();
 #endif
-	bool ok = intern_calc_route(welt, start, ziel, fahr, max_khm, max_cost, weight);
+	search_result_t result = intern_calc_route(context, welt, start, ziel, fahr, max_khm, max_cost, weight);
+	if(  result == search_out_of_steps  &&  allow_bidirectional  ) {
+		// long routes on large maps : searching from both ends covers only about half the area
+		result = intern_calc_route_bidirectional(context, welt, start, ziel, fahr, max_khm, max_cost, weight);
+	}
+	const bool ok = result == search_succeeded;
 #ifdef DEBUG_ROUTES
 	if(fahr->get_waytype()==water_wt) {DBG_DEBUG("route_t::calc_route()","route from %d,%d to %d,%d with %i steps in %u ms found.",start.x, start.y, ziel.x, ziel.y, route.get_count()-1, dr_time()-ms );}
 #endif
 
-	INT_CHECK("route 343");
+	if(context.main_thread) {
+		INT_CHECK("route 343");
+	}
 
 	if( !ok ) {
 DBG_MESSAGE("route_t::calc_route()","No route from %d,%d to %d,%d found",start.x, start.y, ziel.x, ziel.y);
+		profile_t::count( profile_t::routes_failed );
 		// no route found
 		route.resize(1);
 		route.append(start); // just to be safe
@@ -675,6 +1005,80 @@ DBG_MESSAGE("route_t::calc_route()","No route from %d,%d to %d,%d found",start.x
 
 
 
+// resolves every stride-th request of a batch, starting with the first
+class route_search_job_t : public worker_job_t
+{
+public:
+	route_t::search_context_t *context;
+	karte_t *welt;
+	route_batch_t::request_t *requests;
+	uint32 count;
+	uint32 stride;
+
+	virtual void run()
+	{
+		for(  uint32 i=0;  i<count;  i+=stride  ) {
+			route_batch_t::request_t &r = requests[i];
+			r.found = r.route->calc_route( *context, welt, r.start, r.ziel, r.fahr, r.max_speed_kmh, r.weight, r.max_tile_len, r.max_cost, r.allow_bidirectional );
+		}
+	}
+};
+
+
+void route_batch_t::add(route_t *route, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_speed_kmh, const uint32 weight, sint32 max_tile_len, const uint32 max_cost, const bool allow_bidirectional)
+{
+	request_t r;
+	r.route = route;
+	r.start = start;
+	r.ziel = ziel;
+	r.fahr = fahr;
+	r.max_speed_kmh = max_speed_kmh;
+	r.weight = weight;
+	r.max_tile_len = max_tile_len;
+	r.max_cost = max_cost;
+	r.allow_bidirectional = allow_bidirectional;
+	r.found = false;
+	requests.append( r );
+}
+
+
+void route_batch_t::run(karte_t *welt)
+{
+	if(  requests.empty()  ) {
+		return;
+	}
+
+	// the node arrays must be sized before anything runs in parallel
+	if(  !route_t::MAX_STEP  ) {
+		route_t::INIT_NODES( welt->get_settings().get_max_route_steps(), welt->get_groesse_x(), welt->get_groesse_y() );
+	}
+
+	const uint32 jobs = min( (uint32)worker_pool_t::get_thread_count()+1, requests.get_count() );
+	while(  batch_contexts.get_count() < jobs  ) {
+		// no interrupts, not even for the part done by the main thread, since the others read the world meanwhile
+		batch_contexts.append( new route_t::search_context_t(false) );
+	}
+
+	route_search_job_t *job = new route_search_job_t[jobs];
+	for(  uint32 j=0;  j<jobs;  j++  ) {
+		job[j].context = batch_contexts[j];
+		job[j].welt = welt;
+		job[j].requests = &requests[j];
+		job[j].count = requests.get_count()-j;
+		job[j].stride = jobs;
+	}
+	for(  uint32 j=1;  j<jobs;  j++  ) {
+		worker_pool_t::submit( job+j );
+	}
+	job[0].run();
+	for(  uint32 j=1;  j<jobs;  j++  ) {
+		worker_pool_t::wait( job+j );
+	}
+	delete [] job;
+}
+
+
+
 void route_t::rdwr(loadsave_t *file)
 {
 	xml_tag_t r( file, "route_t" );
@@ -11,8 +11,10 @@
 #include "../simdebug.h"
 
 #include "../dataobj/koord3d.h"
+#include "../dataobj/marker.h"
 
 #include "../tpl/vector_tpl.h"
+#include "../tpl/binary_heap_tpl.h"
 
 class karte_t;
 class fahrer_t;
@@ -26,17 +28,6 @@ class grund_t;
  */
 class route_t
 {
-private:
-	/**
-	 * Die eigentliche Routensuche
-	 * @author Hj. Malthaner
-	 */
-	bool intern_calc_route(karte_t *w, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_kmh, const uint32 max_cost, const uint32 max_weight);
-
-	koord3d_vector_t route;           // Die Koordinaten fuer die Fahrtroute
-
-	// Bernd Gabriel, Mar 10, 2010: weight limit info
-	uint32 max_weight;
 public:
 	// this class save the nodes during route search
 	class ANode {
@@ -55,10 +46,75 @@ public:
 		//inline uint32 get_distance() const { return f; }
 	};
 
+	/**
+	 * Everything a route search needs apart from the world: node arrays,
+	 * open lists and closed lists. Searches using different contexts may run
+	 * at the same time on different threads, as long as the world is not
+	 * changed meanwhile (see route_batch_t).
+	 */
+	class search_context_t
+	{
+	public:
+		static const uint8 MAX_NODES_ARRAY = 2;
+
+	private:
+		ANode *nodes[MAX_NODES_ARRAY];
+		bool nodes_in_use[MAX_NODES_ARRAY]; // semaphores, since we only have few nodes arrays in memory
+		uint32 nodes_size;
+		koord marker_size;
+
+	public:
+		// open and closed lists; the bidirectional search needs one of each per direction
+		binary_heap_tpl <ANode *> queue[2];
+		marker_t closed[2];
+
+		// the node by which each half of the bidirectional search has closed a tile:
+		// open addressing by tile and half, node index+1 (0 = empty); only allocated when needed
+		uint32 *closed_nodes;
+		uint8 closed_nodes_bits;
+
+		// only the main thread may process interrupts (and thus change the world) during a search
+		const bool main_thread;
+
+		search_context_t(bool main_thread);
+		~search_context_t();
+
+		// adjusts the closed lists to the world size and clears them
+		void prepare(const karte_t *welt);
+
+		// sizes closed_nodes for route_t::MAX_STEP nodes and clears it
+		void prepare_closed_nodes();
+
+		// node arrays have route_t::MAX_STEP+6 entries
+		uint8 get_nodes(ANode **nodes);
+		void release_nodes(uint8 nodes_index);
+	};
+
 private:
-	static const uint8 MAX_NODES_ARRAY = 2;
-	static ANode *_nodes[MAX_NODES_ARRAY];
-	static bool _nodes_in_use[MAX_NODES_ARRAY]; // semaphores, since we only have few nodes arrays in memory
+	enum search_result_t { search_failed, search_out_of_steps, search_succeeded };
+
+	/**
+	 * Die eigentliche Routensuche
+	 * @author Hj. Malthaner
+	 */
+	search_result_t intern_calc_route(search_context_t &context, karte_t *w, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_kmh, const uint32 max_cost, const uint32 max_weight);
+
+	/**
+	 * Searches from both ends at once; each half needs to explore only about half
+	 * the area, so this finds long routes for which intern_calc_route() runs out of steps.
+	 * The search goes on after the halves have met until the route is proven to be
+	 * the cheapest, unless it runs out of steps before.
+	 */
+	search_result_t intern_calc_route_bidirectional(search_context_t &context, karte_t *w, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_kmh, const uint32 max_cost, const uint32 max_weight);
+
+	koord3d_vector_t route;           // Die Koordinaten fuer die Fahrtroute
+
+	// Bernd Gabriel, Mar 10, 2010: weight limit info
+	uint32 max_weight;
+
+	// used by all searches on the main thread (created on demand)
+	static search_context_t *main_context;
+
 public:
 	static uint32 MAX_STEP;
 	static uint32 max_used_steps;
@@ -67,6 +123,8 @@ public:
 	static void RELEASE_NODES(uint8 nodes_index);
 	static void TERM_NODES();
 
+	static search_context_t &get_main_context();
+
 	static inline uint32 calc_distance( const koord3d p1, const koord3d p2 )
 	{
 		return (abs(p1.x-p2.x)+abs(p1.y-p2.y)+abs(p1.z-p2.z)/16);
@@ -159,9 +217,18 @@ public:
 
 	/**
 	 * berechnet eine route von start nach ziel.
+	 * With allow_bidirectional, a search running out of steps is repeated from
+	 * both ends (for long convoy routes and road connexions of towns).
 	 * @author Hj. Malthaner
 	 */
-	bool calc_route(karte_t *welt, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_speed_kmh, const uint32 weight, sint32 max_tile_len, const uint32 max_cost=0xFFFFFFFF);
+	bool calc_route(karte_t *welt, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_speed_kmh, const uint32 weight, sint32 max_tile_len, const uint32 max_cost=0xFFFFFFFF, const bool allow_bidirectional=false);
+
+	/**
+	 * Same as above, but searching with the given context. With a context
+	 * which is not the main context, nothing but the route is changed.
+	 */
+	bool calc_route(search_context_t &context, karte_t *welt, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_speed_kmh, const uint32 weight, sint32 max_tile_len, const uint32 max_cost=0xFFFFFFFF, const bool allow_bidirectional=false);
+
 	/**
 	 * Ldt/speichert eine Route
 	 * @author V. Meyer
@@ -169,4 +236,47 @@ public:
 	void rdwr(loadsave_t *file);
 };
 
+
+/**
+ * Collects independent route searches and resolves them together, spread
+ * over the worker threads. The world must not be changed between the first
+ * add() and the end of run(). Each result depends only on its own request,
+ * so the outcome is the same for any number of threads.
+ */
+class route_batch_t
+{
+public:
+	struct request_t {
+		route_t *route;
+		koord3d start, ziel;
+		fahrer_t *fahr;
+		sint32 max_speed_kmh;
+		uint32 weight;
+		sint32 max_tile_len;
+		uint32 max_cost;
+		bool allow_bidirectional;
+		bool found;
+	};
+
+private:
+	vector_tpl<request_t> requests;
+
+public:
+	// the result is written into route; fahr is only read during run()
+	void add(route_t *route, koord3d start, koord3d ziel, fahrer_t *fahr, const sint32 max_speed_kmh, const uint32 weight, sint32 max_tile_len, const uint32 max_cost=0xFFFFFFFF, const bool allow_bidirectional=false);
+
+	/**
+	 * Searches all routes and returns when all are done.
+	 * No interrupts are processed meanwhile.
+	 */
+	void run(karte_t *welt);
+
+	uint32 get_count() const { return requests.get_count(); }
+
+	// result of calc_route() for the i-th request, valid after run()
+	bool is_found(uint32 i) const { return requests[i].found; }
+
+	void clear() { requests.clear(); }
+};
+
 #endif
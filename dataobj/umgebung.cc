@@ -36,7 +36,9 @@ long umgebung_t::server_frames_ahead = 4;
 long umgebung_t::additional_client_frames_behind = 0;
 long umgebung_t::network_frames_per_step = 4;
 uint32 umgebung_t::server_sync_steps_between_checks = 256;
+bool umgebung_t::dump_state_digest = false;
 bool umgebung_t::pause_server_no_clients = false;
+bool umgebung_t::network_thread = true;
 
 // this is explicitely and interactively set by user => we do not touch it in init
 const char *umgebung_t::language_iso = "en";
@@ -47,6 +49,9 @@ bool umgebung_t::mute_sound = false;
 bool umgebung_t::mute_midi = true;
 bool umgebung_t::shuffle_midi = true;
 sint16 umgebung_t::window_snap_distance = 8;
+uint8 umgebung_t::num_threads = 1;
+bool umgebung_t::sparse_path_matrix = false;
+bool umgebung_t::background_save = true;
 
 // only used internally => do not touch further
 bool umgebung_t::quit_simutrans = false;
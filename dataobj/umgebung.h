@@ -53,6 +53,8 @@ public:
 	static long network_frames_per_step;
 	// how often to synchronize
 	static uint32 server_sync_steps_between_checks;
+	// write the hashes of all objects after every step, to find the cause of desyncs
+	static bool dump_state_digest;
 	static bool restore_UI;	// when true, restore the windows from a savegame
 
 	// if we are the server, we are at this port ...
@@ -84,6 +86,9 @@ public:
 	// pause server if no client connected
 	static bool pause_server_no_clients;
 
+	// server: receive and send in a separate thread (needs MULTI_THREAD)
+	static bool network_thread;
+
 	// scrollrichtung
 	static sint16 scroll_multi;
 
@@ -254,6 +259,9 @@ public:
 	/* prissi: do autosave every month? */
 	static sint32 autosave;
 
+	// write autosaves in another thread while the game continues
+	static bool background_save;
+
 	/* prissi: drive on the left side of the road */
 	static bool drive_on_left;
 
@@ -263,6 +271,12 @@ public:
 	// maximum acceleration with fast forward
 	static sint16 max_acceleration;
 
+	// number of threads used for background computations (1 = no worker threads)
+	static uint8 num_threads;
+
+	// store only the reachable halt pairs of the finished path matrices (saves memory on large maps)
+	static bool sparse_path_matrix;
+
 	// false to quit the programs
 	static bool quit_simutrans;
 
@@ -24,6 +24,7 @@
 #include "../dings/groundobj.h"
 
 #include "../utils/cbuffer_t.h"
+#include "../utils/worker_pool.h"
 
 #include "../dataobj/loadsave.h"
 #include "../dataobj/translator.h"
@@ -45,7 +46,122 @@ PLAYER_COLOR_VAL baum_t::outline_color = 0;
 static image_id baumtype_to_bild[256][5*5];
 
 
+// rows of the map per block of fill_trees()
+#define FILL_TREES_BLOCK_ROWS (64)
+
+
+// random state of a block of the map generation, derived from the map number
+static uint32 map_block_seed(karte_t *welt, const uint32 salt, const uint32 block)
+{
+	uint32 seed = (uint32)welt->get_settings().get_karte_nummer()*2654435761u + salt;
+	seed ^= (block+1)*40503u;
+	simrand_local( seed, 0 );
+	return seed;
+}
+
+
+/**
+ * Number of trees on each tile of a forest of the given size. It needs neither
+ * the world nor simrand(), so the forests of a new map are done by the workers.
+ */
+class forest_job_t : public worker_job_t
+{
+public:
+	koord size;
+	uint8 max_trees;
+	uint32 seed;
+	// by columns, in the order create_forest() plants them
+	vector_tpl<uint8> count;
+
+	virtual void run()
+	{
+		count.clear();
+		count.resize( size.x*size.y );
+		for( sint16 j = 0; j < size.x; j++) {
+			for( sint16 i = 0; i < size.y; i++) {
+
+				const sint32 x_tree_pos = (j-(size.x>>1));
+				const sint32 y_tree_pos = (i-(size.y>>1));
+
+				const uint64 distance = 1 + ((uint64) sqrt( ((double)x_tree_pos*x_tree_pos*(size.y*size.y) + (double)y_tree_pos*y_tree_pos*(size.x*size.x))));
+				const uint32 tree_probability = (uint32)( ( 8 * (uint32)((size.x*size.x)+(size.y*size.y)) ) / distance );
+
+				uint8 number_to_plant = 0;
+				if (tree_probability >= 38) {
+					uint8 const max_trees_here = min(max_trees, (tree_probability - 38 + 1) / 2);
+					for (uint8 c2 = 0 ; c2<max_trees_here; c2++) {
+						const uint32 rating = simrand_local(seed, 10) + 38 + c2*2;
+						if (rating < tree_probability ) {
+							number_to_plant++;
+						}
+					}
+				}
+				count.append( number_to_plant );
+			}
+		}
+	}
+};
+
+
+/**
+ * Tiles of the rows [y_start,y_end) which get a single tree in fill_trees().
+ * Only reads the map, which is not changed until all jobs are done.
+ */
+class fill_trees_job_t : public worker_job_t
+{
+public:
+	karte_t *welt;
+	sint16 y_start;
+	sint16 y_end;
+	uint32 spare_density;
+	uint32 seed;
+	vector_tpl<koord> tiles;
+
+	virtual void run()
+	{
+		settings_t const& s = welt->get_settings();
+		tiles.clear();
+		koord pos;
+		for(  pos.y=y_start;  pos.y<y_end;  pos.y++  ) {
+			for(  pos.x=0;  pos.x<welt->get_groesse_x();  pos.x++  ) {
+				grund_t *gr = welt->lookup_kartenboden(pos);
+				if(gr->get_top() == 0  &&  gr->get_typ() == grund_t::boden)  {
+					// plant spare trees, (those with low preffered density) or in an entirely tree climate
+					uint16 cl = 1<<welt->get_climate(gr->get_hoehe());
+					if ((cl & s.get_no_tree_climates()) == 0 && ((cl & s.get_tree_climates()) != 0 || simrand_local(seed, spare_density) < 100)) {
+						tiles.append( pos );
+					}
+				}
+			}
+		}
+	}
+};
+
+
+// plants the trees counted by a forest_job_t around new_center
+uint32 baum_t::plant_forest(karte_t *welt, koord new_center, const forest_job_t &job)
+{
+	uint32 number_of_new_trees = 0;
+	uint32 k = 0;
+	for( sint16 j = 0; j < job.size.x; j++) {
+		for( sint16 i = 0; i < job.size.y; i++) {
+			if(  job.count[k]>0  ) {
+				const koord pos( (sint16)(new_center.x + j-(job.size.x>>1)), (sint16)(new_center.y + i-(job.size.y>>1)) );
+				number_of_new_trees += plant_tree_on_coordinate(welt, pos, job.max_trees, job.count[k]);
+			}
+			k++;
+		}
+	}
+	return number_of_new_trees;
+}
+
+
 // distributes trees on a map
+// The number of trees of each tile is drawn by the workers from a seed per
+// forest or block of rows, then the trees are planted in the serial order.
+// So the trees are the same for any number of threads, but not the same as
+// those older versions grew for a map number; trees are in the savegame,
+// so only newly created maps differ.
 void baum_t::distribute_trees(karte_t *welt, int dichte)
 {
 	// now we can proceed to tree planting routine itself
@@ -57,13 +173,28 @@ void baum_t::distribute_trees(karte_t *welt, int dichte)
 	unsigned   const t_forest_size  = (unsigned)pow(((double)x * (double)y), 0.25) * s.get_forest_base_size() / 11 + (x + y) / (2 * s.get_forest_map_size_divisor());
 	uint8      const c_forest_count = (unsigned)pow(((double)x * (double)y), 0.5)  / s.get_forest_count_divisor();
 
+	// none there
+	if(  besch_names.empty()  ) {
+		return;
+	}
+
 DBG_MESSAGE("verteile_baeume()","creating %i forest",c_forest_count);
+	forest_job_t *forest = new forest_job_t[c_forest_count];
+	koord *start = new koord[c_forest_count];
 	for (uint8 c1 = 0 ; c1 < c_forest_count ; c1++) {
 		// to have same execution order for simrand
-		koord const start = koord::koord_random(x, y);
-		koord const size  = koord(t_forest_size,t_forest_size) + koord::koord_random(t_forest_size, t_forest_size);
-		create_forest( welt, start, size );
+		start[c1] = koord::koord_random(x, y);
+		forest[c1].size = koord(t_forest_size,t_forest_size) + koord::koord_random(t_forest_size, t_forest_size);
+		forest[c1].max_trees = s.get_max_no_of_trees_on_square();
+		forest[c1].seed = map_block_seed( welt, 0x466F7265u, c1 );
+		worker_pool_t::submit( forest+c1 );
 	}
+	for (uint8 c1 = 0 ; c1 < c_forest_count ; c1++) {
+		worker_pool_t::wait( forest+c1 );
+		plant_forest( welt, start[c1], forest[c1] );
+	}
+	delete [] start;
+	delete [] forest;
 
 	fill_trees(welt, dichte);
 }
@@ -188,35 +319,12 @@ uint32 baum_t::create_forest(karte_t *welt, koord new_center, koord wh )
 	if(  besch_names.empty()  ) {
 		return 0;
 	}
-	const sint16 xpos_f = new_center.x;
-	const sint16 ypos_f = new_center.y;
-	uint32 number_of_new_trees = 0;
-	for( sint16 j = 0; j < wh.x; j++) {
-		for( sint16 i = 0; i < wh.y; i++) {
-
-			const sint32 x_tree_pos = (j-(wh.x>>1));
-			const sint32 y_tree_pos = (i-(wh.y>>1));
-
-			const uint64 distance = 1 + ((uint64) sqrt( ((double)x_tree_pos*x_tree_pos*(wh.y*wh.y) + (double)y_tree_pos*y_tree_pos*(wh.x*wh.x))));
-			const uint32 tree_probability = (uint32)( ( 8 * (uint32)((wh.x*wh.x)+(wh.y*wh.y)) ) / distance );
-
-			if (tree_probability < 38) {
-				continue;
-			}
-
-			uint8 number_to_plant = 0;
-			uint8 const max_trees_here = min(welt->get_settings().get_max_no_of_trees_on_square(), (tree_probability - 38 + 1) / 2);
-			for (uint8 c2 = 0 ; c2<max_trees_here; c2++) {
-				const uint32 rating = simrand(10, "uint32 baum_t::create_forest") + 38 + c2*2;
-				if (rating < tree_probability ) {
-					number_to_plant++;
-				}
-			}
-
-			number_of_new_trees += baum_t::plant_tree_on_coordinate(welt, koord((sint16)(xpos_f + x_tree_pos), (sint16)(ypos_f + y_tree_pos)), welt->get_settings().get_max_no_of_trees_on_square(), number_to_plant);
-		}
-	}
-	return number_of_new_trees;
+	forest_job_t forest;
+	forest.size = wh;
+	forest.max_trees = welt->get_settings().get_max_no_of_trees_on_square();
+	forest.seed = simrand( 0xFFFFFFFFu, "uint32 baum_t::create_forest" );
+	forest.run();
+	return plant_forest( welt, new_center, forest );
 }
 
 
@@ -227,20 +335,36 @@ void baum_t::fill_trees(karte_t *welt, int dichte)
 		return;
 	}
 DBG_MESSAGE("verteile_baeume()","distributing single trees");
-	koord pos;
-	for(  pos.y=0;  pos.y<welt->get_groesse_y();  pos.y++  ) {
-		for(  pos.x=0;  pos.x<welt->get_groesse_x();  pos.x++  ) {
-			grund_t *gr = welt->lookup_kartenboden(pos);
-			if(gr->get_top() == 0  &&  gr->get_typ() == grund_t::boden)  {
-				// plant spare trees, (those with low preffered density) or in an entirely tree climate
-				uint16 cl = 1<<welt->get_climate(gr->get_hoehe());
-				settings_t const& s = welt->get_settings();
-				if ((cl & s.get_no_tree_climates()) == 0 && ((cl & s.get_tree_climates()) != 0 || simrand(s.get_forest_inverse_spare_tree_density() * dichte, "baum_t::fill_trees()") < 100)) {
-					plant_tree_on_coordinate(welt, pos, 1, 1);
-				}
+	settings_t const& s = welt->get_settings();
+	const uint32 blocks = (welt->get_groesse_y()+FILL_TREES_BLOCK_ROWS-1) / FILL_TREES_BLOCK_ROWS;
+	// as many blocks at once as there are threads, so the tile lists stay small
+	const uint32 jobs = min( (uint32)worker_pool_t::get_thread_count()+1, blocks );
+	fill_trees_job_t *job = new fill_trees_job_t[jobs];
+	for(  uint32 first=0;  first<blocks;  first+=jobs  ) {
+		const uint32 last = min( first+jobs, blocks );
+		for(  uint32 b=first;  b<last;  b++  ) {
+			fill_trees_job_t &j = job[b-first];
+			j.welt = welt;
+			j.y_start = b*FILL_TREES_BLOCK_ROWS;
+			j.y_end = min( (sint32)((b+1)*FILL_TREES_BLOCK_ROWS), (sint32)welt->get_groesse_y() );
+			j.spare_density = s.get_forest_inverse_spare_tree_density() * dichte;
+			j.seed = map_block_seed( welt, 0x46696C6Cu, b );
+			if(  b>first  ) {
+				worker_pool_t::submit( &j );
+			}
+		}
+		job[0].run();
+		for(  uint32 b=first+1;  b<last;  b++  ) {
+			worker_pool_t::wait( job+(b-first) );
+		}
+		// only now the map is changed
+		for(  uint32 b=first;  b<last;  b++  ) {
+			FOR( vector_tpl<koord>, const& pos, job[b-first].tiles ) {
+				plant_tree_on_coordinate(welt, pos, 1, 1);
 			}
 		}
 	}
+	delete [] job;
 }
 
 
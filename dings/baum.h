@@ -16,6 +16,8 @@
 #include "../simcolor.h"
 #include "../dataobj/umgebung.h"
 
+class forest_job_t;
+
 /**
  * Bume in Simutrans.
  * @author Hj. Malthaner
@@ -53,6 +55,8 @@ private:
 
 	static uint8 plant_tree_on_coordinate(karte_t *welt, koord pos, const uint8 maximum_count, const uint8 count);
 
+	static uint32 plant_forest(karte_t *welt, koord center, const forest_job_t &forest);
+
 public:
 	// only the load save constructor should be called outside
 	// otherwise I suggest use the plant tree function (see below)
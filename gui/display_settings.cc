@@ -75,9 +75,10 @@
 #define PHASE_EXPLORE_PATHS				(PHASE_FILL_MATRIX+13)
 #define PHASE_REROUTE_GOODS				(PHASE_EXPLORE_PATHS+13)
 #define PATH_EXPLORE_STATUS				(PHASE_REROUTE_GOODS+13)
+#define PATH_EXPLORE_MEMORY				(PATH_EXPLORE_STATUS+13)
 
 
-#define BOTTOM							(PATH_EXPLORE_STATUS+30)
+#define BOTTOM							(PATH_EXPLORE_MEMORY+30)
 
 // x coordinates
 #define RIGHT_WIDTH (220)
@@ -537,4 +538,7 @@ void color_gui_t::zeichnen(koord pos, koord gr)
 	len = 15+display_proportional_clip(x+10, y+PATH_EXPLORE_STATUS, translator::translate("Status:"), ALIGN_LEFT, text_colour, true);
 	display_proportional_clip(x+len, y+PATH_EXPLORE_STATUS, status_string, ALIGN_LEFT, figure_colour, true);
 
+	len = 15+display_proportional_clip(x+10, y+PATH_EXPLORE_MEMORY, translator::translate("Path memory:"), ALIGN_LEFT, text_colour, true);
+	display_proportional_clip(x+len, y+PATH_EXPLORE_MEMORY, ntos((long)(path_explorer_t::get_total_memory_usage() >> 10), "%lu KiB"), ALIGN_LEFT, figure_colour, true);
+
 }
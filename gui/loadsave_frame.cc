@@ -16,6 +16,7 @@
 
 #include "loadsave_frame.h"
 
+#include "../simgraph.h"
 #include "../simworld.h"
 #include "../simversion.h"
 #include "../dataobj/loadsave.h"
@@ -37,6 +38,10 @@ public:
 
 stringhashtable_tpl<sve_info_t *> loadsave_frame_t::cached_info;
 
+// the largest thumbnail stored by karte_t::add_savegame_info()
+#define THUMBNAIL_SIZE (128)
+#define PREVIEW_HEIGHT (THUMBNAIL_SIZE+2+4+3*LINESPACE)
+
 
 sve_info_t::sve_info_t(const char *pak_, time_t mod_, long fs)
 : pak(""), mod_time(mod_), file_size(fs)
@@ -91,10 +96,12 @@ bool loadsave_frame_t::del_action(const char *filename)
 }
 
 
-loadsave_frame_t::loadsave_frame_t(karte_t *welt, bool do_load) : savegame_frame_t(".sve", NULL, false, true)
+loadsave_frame_t::loadsave_frame_t(karte_t *welt, bool do_load) : savegame_frame_t(".sve", NULL, false, true), preview_map(0,0)
 {
 	this->welt = welt;
 	this->do_load = do_load;
+	preview_has_settings = false;
+	preview_width = THUMBNAIL_SIZE+2+10;
 	init(".sve", NULL);
 	if(do_load) {
 		set_name(translator::translate("Laden"));
@@ -157,7 +164,8 @@ void loadsave_frame_t::init(const char * /*suffix*/, const char * /*path*/ )
 	file_table.add_column(&pak_column);
 	file_table.add_column(&std_column);
 	file_table.add_column(&exp_column);
-	set_min_windowsize(get_fenstergroesse());
+	// room for the preview right of the files
+	set_min_windowsize(koord(get_fenstergroesse().x+preview_width, max(get_fenstergroesse().y, TITLEBAR_HEIGHT+20+PREVIEW_HEIGHT+48)));
 	set_resizemode(diagonal_resize);
 	//set_fenstergroesse(koord(640+36, get_fenstergroesse().y));
 }
@@ -343,15 +351,100 @@ const char *loadsave_frame_t::get_info(const char *fname)
 	// add the time too
 	struct tm *tm = localtime(&sb.st_mtime);
 	if(tm) {
-		strftime(date+n, 18, "%Y-%m-%d %H:%M", tm);
+		n += strftime(date+n, 18, "%Y-%m-%d %H:%M", tm);
 	}
 	else {
 		tstrncpy(date, "??.??.???? ??:??", lengthof(date));
+		n = strlen(date);
+	}
+
+	// map size and game date, if the file has a summary (only read from its end)
+	std::string summary;
+	if(  loadsave_t::read_info( path, "summary", summary )  ) {
+		int w, h, year, month;
+		const char *size = strstr( summary.c_str(), "size=" );
+		const char *when = strstr( summary.c_str(), "date=" );
+		if(  size  &&  when  &&  sscanf( size, "size=%dx%d", &w, &h )==2  &&  sscanf( when, "date=%d/%d", &year, &month )==2  ) {
+			sprintf( date+n, " - %dx%d, %d/%d", w, h, month, year );
+		}
 	}
 	return date;
 }
 
 
+void loadsave_frame_t::update_preview(const char *filename)
+{
+	if(  preview_file==filename  ) {
+		return;
+	}
+	preview_file = filename;
+	preview_map.resize( 0, 0 );
+	preview_has_settings = false;
+
+	// the thumbnail is only read from the end of the file
+	std::string thumbnail;
+	if(  loadsave_t::read_info( filename, "thumbnail", thumbnail )  &&  thumbnail.size()>=4  ) {
+		const uint8 *data = (const uint8 *)thumbnail.data();
+		const uint16 w = data[0] | (data[1]<<8);
+		const uint16 h = data[2] | (data[3]<<8);
+		if(  w<=THUMBNAIL_SIZE  &&  h<=THUMBNAIL_SIZE  &&  thumbnail.size()==4u+w*h  ) {
+			preview_map.resize( w, h );
+			memcpy( preview_map.to_array(), data+4, w*h );
+		}
+	}
+
+	// for the settings only the block containing them is decompressed, not the whole game
+	loadsave_t file;
+	if(  file.rd_open( filename )  ) {
+		const bool too_new = file.get_version() > loadsave_t::int_version(SAVEGAME_VER_NR, NULL, NULL).version  ||  file.get_experimental_version() > loadsave_t::int_version(EXPERIMENTAL_SAVEGAME_VERSION, NULL, NULL).experimental_version;
+		if(  !too_new  &&  file.seek_section( "settings" )  ) {
+			preview_settings.rdwr( &file );
+			preview_has_settings = true;
+		}
+		file.close();
+	}
+}
+
+
+void loadsave_frame_t::zeichnen(koord pos, koord gr)
+{
+	savegame_frame_t::zeichnen(pos, gr);
+
+	const int x = pos.x + scrolly.get_pos().x + scrolly.get_groesse().x + 6;
+	int y = pos.y + TITLEBAR_HEIGHT + scrolly.get_pos().y;
+	if(  preview_map.get_width()>0  ) {
+		display_ddd_box_clip( x, y, preview_map.get_width()+2, preview_map.get_height()+2, MN_GREY0, MN_GREY4 );
+		display_array_wh( x+1, y+1, preview_map.get_width(), preview_map.get_height(), preview_map.to_array() );
+	}
+	y += THUMBNAIL_SIZE+2+4;
+
+	if(  preview_has_settings  ) {
+		char buf[128];
+		sprintf( buf, "%s %d", translator::translate("5WORLD_CHOOSE"), preview_settings.get_anzahl_staedte() );
+		display_proportional_clip( x, y, buf, ALIGN_LEFT, COL_BLACK, true );
+		y += LINESPACE;
+		sprintf( buf, "%s %d", translator::translate("Land industries"), preview_settings.get_land_industry_chains() );
+		display_proportional_clip( x, y, buf, ALIGN_LEFT, COL_BLACK, true );
+		y += LINESPACE;
+		sprintf( buf, "%s %d", translator::translate("Tourist attractions"), preview_settings.get_tourist_attractions() );
+		display_proportional_clip( x, y, buf, ALIGN_LEFT, COL_BLACK, true );
+	}
+}
+
+
+bool loadsave_frame_t::action_triggered(gui_action_creator_t *komp, value_t p)
+{
+	if(  komp==&file_table  ) {
+		// preview the game under the mouse
+		const gui_table_event_t *event = (const gui_table_event_t *)p.p;
+		if(  event->is_cell_hit  ) {
+			update_preview( ((gui_file_table_row_t *)file_table.get_row( event->cell.get_y() ))->get_name() );
+		}
+	}
+	return savegame_frame_t::action_triggered( komp, p );
+}
+
+
 loadsave_frame_t::~loadsave_frame_t()
 {
 	// save hashtable
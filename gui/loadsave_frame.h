@@ -11,6 +11,8 @@
 
 #include "savegame_frame.h"
 #include "../tpl/stringhashtable_tpl.h"
+#include "../tpl/array2d_tpl.h"
+#include "../dataobj/einstellungen.h"
 #include <string>
 
 class karte_t;
@@ -79,6 +81,17 @@ private:
 	bool do_load;
 
 	static stringhashtable_tpl<sve_info_t *> cached_info;
+
+	/**
+	 * preview of the file under the mouse: the thumbnail from the table of
+	 * contents and the settings, read by seeking to their section
+	 */
+	std::string preview_file;
+	array2d_tpl<uint8> preview_map;
+	settings_t preview_settings;
+	bool preview_has_settings;
+
+	void update_preview(const char *filename);
 protected:
 	virtual void init(const char *suffix, const char *path);
 	virtual void set_file_table_default_sort_order();
@@ -113,6 +126,10 @@ public:
 	 * save hashtable to xml file
 	 */
 	virtual ~loadsave_frame_t();
+
+	virtual void zeichnen(koord pos, koord gr);
+
+	bool action_triggered(gui_action_creator_t*, value_t) OVERRIDE;
 };
 
 #endif
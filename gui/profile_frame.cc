@@ -0,0 +1,99 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#include <stdio.h>
+
+#include "profile_frame.h"
+#include "../simdebug.h"
+#include "../simsys.h"
+#include "../simgraph.h"
+#include "../dataobj/translator.h"
+#include "../dataobj/umgebung.h"
+#include "../utils/simprofile.h"
+
+#define WINDOW_WIDTH (400)
+#define HEADER_HEIGHT (BUTTON_HEIGHT+8)
+
+
+profile_frame_t::profile_frame_t() :
+	gui_frame_t( translator::translate("Profiling") ),
+	text(&buf),
+	scrolly(&text)
+{
+	enable.init( button_t::square_state, "Enabled", koord(4, 4), koord(BUTTON_WIDTH, BUTTON_HEIGHT) );
+	enable.pressed = profile_t::enabled;
+	enable.add_listener(this);
+	add_komponente(&enable);
+
+	reset.init( button_t::roundbox, "Reset", koord(WINDOW_WIDTH-2*BUTTON_WIDTH-8, 4), koord(BUTTON_WIDTH, BUTTON_HEIGHT) );
+	reset.add_listener(this);
+	add_komponente(&reset);
+
+	dump.init( button_t::roundbox, "Write to file", koord(WINDOW_WIDTH-BUTTON_WIDTH-4, 4), koord(BUTTON_WIDTH, BUTTON_HEIGHT) );
+	dump.set_tooltip( "Writes the data to profile.txt" );
+	dump.add_listener(this);
+	add_komponente(&dump);
+
+	update_text();
+	scrolly.set_pos( koord(0, HEADER_HEIGHT) );
+	scrolly.set_show_scroll_x(true);
+	scrolly.set_scroll_amount_y(LINESPACE);
+	add_komponente(&scrolly);
+
+	set_fenstergroesse( koord(WINDOW_WIDTH, TITLEBAR_HEIGHT+HEADER_HEIGHT+LINESPACE*20) );
+	set_min_windowsize( koord(WINDOW_WIDTH, TITLEBAR_HEIGHT+HEADER_HEIGHT+LINESPACE*4) );
+	set_resizemode(diagonal_resize);
+	resize( koord(0,0) );
+}
+
+
+void profile_frame_t::update_text()
+{
+	buf.clear();
+	profile_t::get_report( buf );
+	text.recalc_size();
+	last_update = dr_time();
+}
+
+
+void profile_frame_t::zeichnen(koord pos, koord gr)
+{
+	// about once per second is enough for reading
+	if(  profile_t::enabled  &&  dr_time() - last_update > 1000  ) {
+		update_text();
+	}
+	gui_frame_t::zeichnen( pos, gr );
+}
+
+
+void profile_frame_t::resize(const koord delta)
+{
+	gui_frame_t::resize( delta );
+	scrolly.set_groesse( get_fenstergroesse() - koord(0, TITLEBAR_HEIGHT+HEADER_HEIGHT) );
+}
+
+
+bool profile_frame_t::action_triggered( gui_action_creator_t *komp, value_t )
+{
+	if(  komp == &enable  ) {
+		profile_t::enabled = !profile_t::enabled;
+		enable.pressed = profile_t::enabled;
+		if(  profile_t::enabled  ) {
+			profile_t::reset();
+		}
+	}
+	else if(  komp == &reset  ) {
+		profile_t::reset();
+	}
+	else if(  komp == &dump  ) {
+		char filename[1024];
+		sprintf( filename, "%sprofile.txt", umgebung_t::user_dir );
+		if(  !profile_t::dump( filename )  ) {
+			dbg->error( "profile_frame_t::action_triggered()", "cannot write %s", filename );
+		}
+	}
+	update_text();
+	return true;
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#ifndef gui_profile_frame_h
+#define gui_profile_frame_h
+
+#include "gui_frame.h"
+#include "components/action_listener.h"
+#include "components/gui_button.h"
+#include "components/gui_scrollpane.h"
+#include "components/gui_textarea.h"
+#include "../utils/cbuffer_t.h"
+
+
+/**
+ * Shows the times measured by profile_t and switches the profiling on
+ * and off.
+ */
+class profile_frame_t : public gui_frame_t, private action_listener_t
+{
+private:
+	cbuffer_t buf;
+	gui_textarea_t text;
+	gui_scrollpane_t scrolly;
+	button_t enable, reset, dump;
+
+	// dr_time() of the last update of the text
+	unsigned long last_update;
+
+	void update_text();
+
+public:
+	profile_frame_t();
+
+	void zeichnen(koord pos, koord gr);
+
+	void resize(const koord delta);
+
+	bool action_triggered(gui_action_creator_t*, value_t) OVERRIDE;
+};
+
+#endif
@@ -44,6 +44,7 @@ savegame_frame_t::savegame_frame_t(const char *suffix, const char *path, bool on
 {
 	this->use_table = use_table;
 	this->only_directories = only_directories;
+	preview_width = 0;
 	init(suffix, path);
 }
 
@@ -183,7 +184,7 @@ void savegame_frame_t::fill_list()
 		set_file_table_default_sort_order();
 		file_table.sort_rows();
 		file_table.set_groesse(file_table.get_table_size());
-		set_fenstergroesse(file_table.get_groesse() + koord(25 + 14, 90));
+		set_fenstergroesse(file_table.get_groesse() + koord(25 + 14 + preview_width, 90));
 	}
 	else
 	{
@@ -489,7 +490,7 @@ void savegame_frame_t::set_fenstergroesse(koord groesse)
 	if (use_table)
 	{
 		y = file_table.get_table_height();
-		scrolly.set_groesse( koord(width,groesse.y-40-8) - scrolly.get_pos() );
+		scrolly.set_groesse( koord(width-preview_width,groesse.y-40-8) - scrolly.get_pos() );
 		scrolly.set_show_scroll_y(y > scrolly.get_groesse().y);
 		sint32 c = file_table.get_size().get_x();
 		if (c > 0) {
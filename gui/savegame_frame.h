@@ -180,6 +180,8 @@ protected:
 	gui_scrollpane_t scrolly;
 	// use file_table instead of button_frame:
 	bool use_table;
+	// room right of the file table, for a preview of a file
+	sint16 preview_width;
 
 	virtual void add_file(const char *filename, const bool not_cutting_suffix);
 
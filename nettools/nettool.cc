@@ -267,6 +267,25 @@ int say(SOCKET socket, uint32 command_id, int argc, char **argv) {
 	return 0;
 }
 
+int profile(SOCKET socket, uint32 command_id, int, char **argv) {
+	nwc_service_t nwcs;
+	nwcs.flag = command_id;
+	if (strcmp(argv[0], "on") == 0) {
+		nwcs.number = 1;
+	}
+	else if (strcmp(argv[0], "off") == 0) {
+		nwcs.number = 0;
+	}
+	else {
+		return 3;
+	}
+	if (!nwcs.send(socket)) {
+		fprintf(stderr, "Could not send request!\n");
+		return 2;
+	}
+	return 0;
+}
+
 // Print usage and exit
 void usage()
 {
@@ -310,6 +329,12 @@ void usage()
 		"      force-sync\n"
 		"        Force server to send sync command in order to save & reload the game\n"
 		"\n"
+		"      profile <on|off>\n"
+		"        Switch measuring the time spent in the parts of the simulation on or off\n"
+		"\n"
+		"      profile-dump\n"
+		"        Write the measured times to profile.txt in the user directory of the server\n"
+		"\n"
 		"    Return codes:\n"
 		"      0 .. success\n"
 		"      1 .. server not reachable\n"
@@ -411,7 +436,9 @@ int main(int argc, char* argv[]) {
 		{"unban-ip",    true,  nwc_service_t::SRVC_UNBAN_IP,        1, &unban_ip},
 		{"say",         true,  nwc_service_t::SRVC_ADMIN_MSG,       1, &say},
 		{"shutdown",    true,  nwc_service_t::SRVC_SHUTDOWN,        0, &simple_command},
-		{"force-sync",  true,  nwc_service_t::SRVC_FORCE_SYNC,      0, &simple_command}
+		{"force-sync",  true,  nwc_service_t::SRVC_FORCE_SYNC,      0, &simple_command},
+		{"profile",     true,  nwc_service_t::SRVC_PROFILE,         1, &profile},
+		{"profile-dump",true,  nwc_service_t::SRVC_PROFILE_DUMP,    0, &simple_command}
 	};
 	int numcommands = lengthof(commands);
 
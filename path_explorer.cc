@@ -9,6 +9,9 @@
 
 #include "tpl/slist_tpl.h"
 #include "dataobj/translator.h"
+#include "utils/cbuffer_t.h"
+#include "utils/min_plus.h"
+#include "utils/simprofile.h"
 #include "bauer/warenbauer.h"
 #include "besch/ware_besch.h"
 #include "simsys.h"
@@ -35,6 +38,7 @@ uint8 path_explorer_t::category_empty = 255;
 path_explorer_t::compartment_t *path_explorer_t::goods_compartment = NULL;
 uint8 path_explorer_t::current_compartment = 0;
 bool path_explorer_t::processing = false;
+uint32 path_explorer_t::step_counter = 0;
 
 
 void path_explorer_t::initialise(karte_t *welt)
@@ -54,6 +58,7 @@ void path_explorer_t::initialise(karte_t *welt)
 
 	current_compartment = 0;
 	processing = false;
+	step_counter = 0;
 
 	compartment_t::initialise();
 }
@@ -74,10 +79,25 @@ void path_explorer_t::finalise()
 
 void path_explorer_t::step()
 {
+	profile_scope_t profile( profile_t::path_explorer );
+	++step_counter;
+
+	// collect the results of path explorations handed to worker threads once they are due;
+	// this is done in category order at a fixed step, so that network clients stay in sync
+	for (uint8 c = 0; c < max_categories; ++c)
+	{
+		if ( goods_compartment[c].is_explore_job_due() )
+		{
+			goods_compartment[c].step();
+		}
+	}
+
 	// at most check all goods categories once
 	for (uint8 i = 0; i < max_categories; ++i)
 	{
+		// compartments waiting for a worker thread are skipped, so that other categories can proceed meanwhile
 		if ( current_compartment != category_empty
+			 && !goods_compartment[current_compartment].is_awaiting_worker()
 			 && (!goods_compartment[current_compartment].is_refresh_completed() 
 			     || goods_compartment[current_compartment].is_refresh_requested() ) )
 		{
@@ -135,8 +155,8 @@ void path_explorer_t::full_instant_refresh()
 			goods_compartment[c].reset(true);
 
 #ifndef DEBUG_EXPLORER_SPEED
-			// go through all 6 phases
-			for (uint8 p = 0; p < 6; ++p)
+			// go through the first 5 phases; with worker threads, path exploration is only started here
+			for (uint8 p = 0; p < 5; ++p)
 			{
 				// perform step
 				goods_compartment[c].step();
@@ -150,11 +170,31 @@ void path_explorer_t::full_instant_refresh()
 		}
 	}
 
+	// collect the explored paths and re-route goods
+	for (uint8 c = 0; c < max_categories; ++c)
+	{
+		if ( c != category_empty )
+		{
+			while ( !goods_compartment[c].is_refresh_completed() )
+			{
+				goods_compartment[c].step();
+			}
+			++curr_step;
+			display_progress(curr_step, total_steps);
+		}
+	}
+
 #ifdef DEBUG_EXPLORER_SPEED
 	diff = dr_time() - start;
 	printf("\n\nTotal time taken :  %lu ms \n", diff);
 #endif
 
+#ifdef DEBUG
+	cbuffer_t report;
+	get_memory_report(report);
+	DBG_MESSAGE("path_explorer_t::full_instant_refresh()", "memory usage of path data:\n%s", (const char *)report);
+#endif
+
 	// enable iteration limits again
 	compartment_t::enable_limits(true);
 
@@ -209,6 +249,7 @@ const char *const path_explorer_t::compartment_t::phase_name[] =
 path_explorer_t::compartment_t::connexion_list_entry_t path_explorer_t::compartment_t::connexion_list[65536];
 
 bool path_explorer_t::compartment_t::use_limits = true;
+bool path_explorer_t::compartment_t::limits_fixed = false;
 
 uint32 path_explorer_t::compartment_t::limit_rebuild_connexions = default_rebuild_connexions;
 uint32 path_explorer_t::compartment_t::limit_filter_eligible = default_filter_eligible;
@@ -222,6 +263,9 @@ uint32 path_explorer_t::compartment_t::local_fill_matrix = default_fill_matrix;
 uint64 path_explorer_t::compartment_t::local_explore_paths = default_explore_paths;
 uint32 path_explorer_t::compartment_t::local_reroute_goods = default_reroute_goods;
 
+bool path_explorer_t::compartment_t::limit_parallel_explore = false;
+bool path_explorer_t::compartment_t::local_parallel_explore = false;
+
 bool path_explorer_t::compartment_t::local_limits_changed = false;
 
 uint16 path_explorer_t::compartment_t::representative_halt_count = 0;
@@ -231,16 +275,34 @@ path_explorer_t::compartment_t::compartment_t()
 {
 	refresh_start_time = 0;
 
-	finished_matrix = NULL;
 	finished_halt_index_map = NULL;
 	finished_halt_count = 0;
 
-	working_matrix = NULL;
+	finished_row_start = NULL;
+	finished_target_list = NULL;
+	finished_path_list = NULL;
+
+	compressed_row_start = NULL;
+	compressed_target_list = NULL;
+	compressed_path_list = NULL;
+	compress_matrix = false;
+
+	finished_component = NULL;
+
 	transport_index_map = NULL;
 	transport_matrix = NULL;
 	working_halt_index_map = NULL;
 	working_halt_list = NULL;
 	working_halt_count = 0;
+	working_component = NULL;
+
+	working_previous_index = NULL;
+	working_halt_changed = NULL;
+	reused_halt_list = NULL;
+	reused_group_begin = NULL;
+	reused_group_end = NULL;
+	reused_halt_count = 0;
+	reused_copy_index = 0;
 
 	all_halts_list = NULL;
 	all_halts_count = 0;
@@ -257,6 +319,8 @@ path_explorer_t::compartment_t::compartment_t()
 	paths_available = false;
 	refresh_completed = true;
 	refresh_requested = true;
+	full_refresh_requested = true;
+	delta_refresh = false;
 
 	current_phase = phase_check_flag;
 
@@ -272,6 +336,13 @@ path_explorer_t::compartment_t::compartment_t()
 	outbound_connections = NULL;
 	process_next_transfer = true;
 
+	via_time_list = NULL;
+	improved_list = NULL;
+
+	explore_job = NULL;
+	explore_join_step = 0;
+	explore_in_parallel = false;
+
 	statistic_duration = 0;
 	statistic_iteration = 0;
 }
@@ -279,28 +350,19 @@ path_explorer_t::compartment_t::compartment_t()
 
 path_explorer_t::compartment_t::~compartment_t()
 {
-	if (finished_matrix)
+	// the worker must be done with the working set before it is deleted
+	if (explore_job)
 	{
-		for (uint16 i = 0; i < finished_halt_count; ++i)
-		{
-			delete[] finished_matrix[i];
-		}
-		delete[] finished_matrix;
-	}
-	if (finished_halt_index_map)
-	{
-		delete[] finished_halt_index_map;
+		wait_for_explore_job();
+		delete explore_job;
 	}
 
+	delete_finished_set();
+	delete_compressed_set();
+	delete_delta_set();
 
-	if (working_matrix)
-	{
-		for (uint16 i = 0; i < working_halt_count; ++i)
-		{
-			delete[] working_matrix[i];
-		}
-		delete[] working_matrix;
-	}
+
+	working_matrix.release(working_halt_count);
 	if (transport_index_map)
 	{
 		delete[] transport_index_map;
@@ -321,6 +383,10 @@ path_explorer_t::compartment_t::~compartment_t()
 	{
 		delete[] working_halt_list;
 	}
+	if (working_component)
+	{
+		delete[] working_component;
+	}
 
 
 	if (all_halts_list)
@@ -347,42 +413,33 @@ path_explorer_t::compartment_t::~compartment_t()
 	{
 		delete outbound_connections;
 	}
+
+	if (via_time_list)
+	{
+		delete[] via_time_list;
+		delete[] improved_list;
+	}
 }
 
 
 void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 {
+	// the worker must be done with the working set before it is deleted
+	wait_for_explore_job();
+
 	refresh_start_time = 0;
 
 	if (reset_finished_set)
 	{
-		if (finished_matrix)
-		{
-			for (uint16 i = 0; i < finished_halt_count; ++i)
-			{
-				delete[] finished_matrix[i];
-			}
-			delete[] finished_matrix;
-			finished_matrix = NULL;
-		}
-		if (finished_halt_index_map)
-		{
-			delete[] finished_halt_index_map;
-			finished_halt_index_map = NULL;
-		}		
-		finished_halt_count = 0;
+		delete_finished_set();
 	}
+	delete_compressed_set();
+	delete_delta_set();
+	// a full refresh follows
+	changed_schedule_halts.clear();
 
 
-	if (working_matrix)
-	{
-		for (uint16 i = 0; i < working_halt_count; ++i)
-		{
-			delete[] working_matrix[i];
-		}
-		delete[] working_matrix;
-		working_matrix = NULL;
-	}
+	working_matrix.release(working_halt_count);
 	if (transport_index_map)
 	{
 		delete[] transport_index_map;
@@ -407,6 +464,11 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 		delete[] working_halt_list;
 		working_halt_list = NULL;
 	}	
+	if (working_component)
+	{
+		delete[] working_component;
+		working_component = NULL;
+	}
 	working_halt_count = 0;
 
 
@@ -444,6 +506,14 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 	}
 	process_next_transfer = true;
 
+	if (via_time_list)
+	{
+		delete[] via_time_list;
+		delete[] improved_list;
+		via_time_list = NULL;
+		improved_list = NULL;
+	}
+
 #ifdef DEBUG_COMPARTMENT_STEP
 	step_count = 0;
 #endif
@@ -454,6 +524,9 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 	}
 	refresh_completed = true;
 	refresh_requested = true;
+	// halts may already hold connexions which are newer than the finished paths
+	full_refresh_requested = true;
+	delta_refresh = false;
 
 	current_phase = phase_check_flag;
 
@@ -473,6 +546,17 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 void path_explorer_t::compartment_t::initialise()
 {
 	initialise_connexion_list();
+
+	local_parallel_explore = worker_pool_t::is_parallel();
+	if ( !umgebung_t::networkmode || umgebung_t::server )
+	{
+		limit_parallel_explore = local_parallel_explore;
+	}
+	else if ( !local_parallel_explore )
+	{
+		// let the server know that this client cannot explore paths in parallel
+		local_limits_changed = true;
+	}
 }
 
 
@@ -504,6 +588,12 @@ void path_explorer_t::compartment_t::step()
 				refresh_requested = false;	// immediately reset it so that we can take new requests
 				refresh_completed = false;	// indicate that processing is at work
 				refresh_start_time = dr_time();
+				// finished paths of unchanged components can only be reused if there were only schedule changes
+				delta_refresh = !full_refresh_requested && finished_component;
+				full_refresh_requested = false;
+				// halts of schedules changed from now on are kept for the next refresh
+				swap( working_schedule_halts, changed_schedule_halts );
+				changed_schedule_halts.clear();
 				current_phase = phase_init_prepare;	// proceed to next phase
 				// no return statement here, as we want to fall through to the next phase
 			}
@@ -529,6 +619,11 @@ void path_explorer_t::compartment_t::step()
 			start = dr_time();	// start timing
 #endif
 
+			// path exploration only works on this compartment's matrices, thus it can be handed to a worker thread;
+			// during the initial full refresh this is done whenever worker threads exist,
+			// otherwise only if all clients of a network game have them
+			explore_in_parallel = use_limits ? limit_parallel_explore : worker_pool_t::is_parallel();
+
 			slist_tpl<halthandle_t>::iterator halt_iter = haltestelle_t::get_alle_haltestellen().begin();
 			all_halts_count = (uint16) haltestelle_t::get_alle_haltestellen().get_count();
 
@@ -957,7 +1052,7 @@ void path_explorer_t::compartment_t::step()
 			if (phase_counter == linkages->get_count())
 			{
 				// iteration limit adjustment
-				if ( catg == representative_category )
+				if ( catg == representative_category && !limits_fixed )
 				{
 					const uint32 projected_iterations = statistic_iteration * time_midpoint / statistic_duration;
 					if ( projected_iterations > 0 )
@@ -1039,6 +1134,11 @@ void path_explorer_t::compartment_t::step()
 			if ( phase_counter == 0 && all_halts_count > 0 )
 			{
 				working_halt_list = new halthandle_t[all_halts_count];
+				if ( delta_refresh )
+				{
+					working_previous_index = new uint16[all_halts_count];
+					working_halt_changed = new bool[all_halts_count];
+				}
 			}
 
 			start = dr_time();	// start timing
@@ -1061,6 +1161,14 @@ void path_explorer_t::compartment_t::step()
 					// valid connexion(s) found -> add to working halt list and update halt index map
 					working_halt_list[working_halt_count] = current_halt;
 					working_halt_index_map[ current_halt.get_id() ] = working_halt_count;
+					if ( delta_refresh )
+					{
+						// compare with the connexions of the previous refresh, which are still held by the halt
+						working_previous_index[working_halt_count] = finished_halt_index_map[ current_halt.get_id() ];
+						// a changed schedule may keep its halts, lines and convoys but change the journey times
+						working_halt_changed[working_halt_count] = working_schedule_halts.is_contained( current_halt.get_id() )
+							|| are_connexions_changed( current_halt->get_connexions(catg), connexion_list[ current_halt.get_id() ].connexion_table );
+					}
 					++working_halt_count;
 				}
 
@@ -1097,7 +1205,7 @@ void path_explorer_t::compartment_t::step()
 			if (phase_counter == all_halts_count)
 			{
 				// iteration limit adjustment
-				if ( catg == representative_category )
+				if ( catg == representative_category && !limits_fixed )
 				{
 					const uint32 projected_iterations = statistic_iteration * time_midpoint / statistic_duration;
 					if ( projected_iterations > 0 )
@@ -1165,11 +1273,7 @@ void path_explorer_t::compartment_t::step()
 				if (working_halt_count > 0)
 				{
 					// build working matrix
-					working_matrix = new path_element_t*[working_halt_count];
-					for (uint16 i = 0; i < working_halt_count; ++i)
-					{
-						working_matrix[i] = new path_element_t[working_halt_count];
-					}
+					working_matrix.allocate(working_halt_count);
 
 					// build transport matrix
 					transport_matrix = new transport_element_t*[working_halt_count];
@@ -1180,6 +1284,13 @@ void path_explorer_t::compartment_t::step()
 
 					// build transfer list
 					transfer_list = new uint16[working_halt_count];
+
+					// every halt starts as a component of its own
+					working_component = new uint16[working_halt_count];
+					for (uint16 i = 0; i < working_halt_count; ++i)
+					{
+						working_component[i] = i;
+					}
 				}
 			}
 
@@ -1254,18 +1365,20 @@ void path_explorer_t::compartment_t::step()
 					}
 
 					// update corresponding matrix element
-					working_matrix[phase_counter][reachable_halt_index].next_transfer = reachable_halt;
-					working_matrix[phase_counter][reachable_halt_index].aggregate_time = current_connexion->waiting_time + current_connexion->journey_time;
+					working_matrix.next_transfer[phase_counter][reachable_halt_index] = reachable_halt;
+					working_matrix.aggregate_time[phase_counter][reachable_halt_index] = current_connexion->waiting_time + current_connexion->journey_time;
 					transport_matrix[phase_counter][reachable_halt_index].first_transport 
 						= transport_matrix[phase_counter][reachable_halt_index].last_transport 
 						= transport_idx;
 
+					unite_components(phase_counter, reachable_halt_index);
+
 					// Debug journey times
-					// printf("\n%s -> %s : %lu \n",current_halt->get_name(), reachable_halt->get_name(), working_matrix[phase_counter][reachable_halt_index].journey_time);
+					// printf("\n%s -> %s : %lu \n",current_halt->get_name(), reachable_halt->get_name(), working_matrix.aggregate_time[phase_counter][reachable_halt_index]);
 				}
 
 				// Special case
-				working_matrix[phase_counter][phase_counter].aggregate_time = 0;
+				working_matrix.aggregate_time[phase_counter][phase_counter] = 0;
 
 				++phase_counter;
 				
@@ -1293,7 +1406,7 @@ void path_explorer_t::compartment_t::step()
 			if (phase_counter == working_halt_count)
 			{
 				// iteration limit adjustment
-				if ( catg == representative_category )
+				if ( catg == representative_category && !limits_fixed )
 				{				
 					const uint32 projected_iterations = statistic_iteration * time_midpoint / statistic_duration;
 					if ( projected_iterations > 0 )
@@ -1322,6 +1435,24 @@ void path_explorer_t::compartment_t::step()
 				statistic_duration = 0;
 				statistic_iteration = 0;
 
+				// replace the union-find parents with the component roots
+				for (uint16 i = 0; i < working_halt_count; ++i)
+				{
+					working_component[i] = find_component_root(i);
+				}
+
+				if ( delta_refresh && !plan_delta_refresh() )
+				{
+					// too many changes -> explore all paths again
+					delta_refresh = false;
+					delete_delta_set();
+				}
+				if (working_halt_changed)
+				{
+					delete[] working_halt_changed;
+					working_halt_changed = NULL;
+				}
+
 				// delete immediately after use
 				if (working_halt_list)
 				{
@@ -1360,119 +1491,45 @@ void path_explorer_t::compartment_t::step()
 			printf("\t\tCurrent Step : %lu \n", step_count);
 #endif
 
-			// temporary variables
-			uint16 combined_time;
-			uint32 target_member_index;
-			uint64 iterations_processed = 0;
-
-			// initialize only when not resuming
-			if ( via_index == 0 && origin_cluster_index == 0 && target_cluster_index == 0 && origin_member_index == 0 )
-			{
-				// build data structures for inbound/outbound connections to/from transfer halts
-				inbound_connections = new connection_t(64u, working_halt_count);
-				outbound_connections = new connection_t(64u, working_halt_count);
-			}
-
-			start = dr_time();	// start timing
-
-			// for each transfer
-			while ( via_index < transfer_count )
+			if ( explore_in_parallel )
 			{
-				const uint16 via = transfer_list[via_index];
-
-				if ( process_next_transfer )
+				if ( !explore_job )
 				{
-					// prevent reconstruction of connected halt list while resuming in subsequent steps
-					process_next_transfer = false;
-
-					// identify halts which are connected with the current transfer halt
-					for ( uint16 idx = 0; idx < working_halt_count; ++idx )
-					{
-						if ( working_matrix[via][idx].aggregate_time != 65535 && via != idx )
-						{
-							inbound_connections->register_connection( transport_matrix[idx][via].last_transport, idx );
-							outbound_connections->register_connection( transport_matrix[via][idx].first_transport, idx );
-						}
-					}
-
-					// should take into account the iterations above
-					iterations += (uint32)working_halt_count + ( inbound_connections->get_total_member_count() << 1 );
+					explore_job = new explore_job_t(this);
 				}
 
-				// for each origin cluster
-				while ( origin_cluster_index < inbound_connections->get_cluster_count() )
+				if ( !explore_job->is_pending() )
 				{
-					const connection_t::connection_cluster_t &origin_cluster = (*inbound_connections)[origin_cluster_index];
-					const uint16 inbound_transport = origin_cluster.transport;
-					const vector_tpl<uint16> &origin_halt_list = origin_cluster.connected_halts;
-
-					// for each target cluster
-					while ( target_cluster_index < outbound_connections->get_cluster_count() )
-					{
-						const connection_t::connection_cluster_t &target_cluster = (*outbound_connections)[target_cluster_index];
-						const uint16 outbound_transport = target_cluster.transport;
-						if ( inbound_transport == outbound_transport && inbound_transport != 0u )
-						{
-							++target_cluster_index;
-							continue;
-						}
-						const vector_tpl<uint16> &target_halt_list = target_cluster.connected_halts;
-
-						// for each origin cluster member
-						while ( origin_member_index < origin_halt_list.get_count() )
-						{
-							const uint16 origin = origin_halt_list[origin_member_index];
-
-							// for each target cluster member
-							for ( target_member_index = 0; target_member_index < target_halt_list.get_count(); ++target_member_index )
-							{
-								const uint16 target = target_halt_list[target_member_index];
-								
-								if ( ( combined_time = working_matrix[origin][via].aggregate_time 
-													 + working_matrix[via][target].aggregate_time ) 
-											< working_matrix[origin][target].aggregate_time			   )
-								{
-									working_matrix[origin][target].aggregate_time = combined_time;
-									working_matrix[origin][target].next_transfer = working_matrix[origin][via].next_transfer;
-									transport_matrix[origin][target].first_transport = transport_matrix[origin][via].first_transport;
-									transport_matrix[origin][target].last_transport = transport_matrix[via][target].last_transport;
-								}
-							}	// loop : target cluster member
-
-							++origin_member_index;
-
-							// iteration control
-							iterations_processed += target_halt_list.get_count();
-							if ( use_limits && iterations_processed >= limit_explore_paths )
-							{
-								goto loop_termination;
-							}
-
-						}	// loop : origin cluster member
-
-						origin_member_index = 0;
-
-						++target_cluster_index;
-
-					}	// loop : target cluster
+					prepare_path_exploration();
+					worker_pool_t::submit(explore_job);
+					// the result is collected at a fixed step regardless of when the worker finishes
+					explore_join_step = use_limits ? step_counter + explore_sync_delay : step_counter;
+#ifdef DEBUG_COMPARTMENT_STEP
+					printf("\t\t\tPath searching handed to worker thread\n");
+#endif
+					return;
+				}
 
-					target_cluster_index = 0;
+				if ( !is_explore_job_due() )
+				{
+					return;
+				}
 
-					++origin_cluster_index;
+				worker_pool_t::wait(explore_job);
+				finish_path_exploration();
+				return;
+			}
 
-				}	// loop : origin cluster
+			uint64 iterations_processed = 0;
 
-				origin_cluster_index = 0;
+			// the worker must never share the working set with the serial path
+			wait_for_explore_job();
 
-				// clear the inbound/outbound connections
-				inbound_connections->reset();
-				outbound_connections->reset();
-				process_next_transfer = true;
+			prepare_path_exploration();
 
-				++via_index;
-			}	// loop : transfer
+			start = dr_time();	// start timing
 
-		loop_termination :
+			const bool exploration_finished = explore_paths( use_limits ? limit_explore_paths : UINT64_MAX_VALUE, iterations_processed );
 
 			diff = dr_time() - start;	// stop timing
 
@@ -1488,10 +1545,10 @@ void path_explorer_t::compartment_t::step()
 			printf("\t\t\tPath searching -> %lu iterations takes :  %lu ms \n", static_cast<unsigned long>(iterations_processed), diff);
 #endif
 
-			if (via_index == transfer_count)
+			if ( exploration_finished )
 			{
 				// iteration limit adjustment
-				if ( catg == representative_category )
+				if ( catg == representative_category && !limits_fixed )
 				{
 					const uint64 projected_iterations = static_cast<uint64>( statistic_iteration / statistic_duration ) * static_cast<uint64>( time_midpoint );
 					if ( projected_iterations > 0 )
@@ -1516,77 +1573,7 @@ void path_explorer_t::compartment_t::step()
 					}
 				}
 
-				// reset statistic variables
-				statistic_duration = 0;
-				statistic_iteration = 0;
-
-
-				// path search completed -> delete old path info
-				if (finished_matrix)
-				{
-					for (uint16 i = 0; i < finished_halt_count; ++i)
-					{
-						delete[] finished_matrix[i];
-					}
-					delete[] finished_matrix;
-					finished_matrix = NULL;	
-				}											
-				if (finished_halt_index_map)
-				{
-					delete[] finished_halt_index_map;
-					finished_halt_index_map = NULL;
-				}
-
-				// transfer working to finished
-				finished_matrix = working_matrix;
-				working_matrix = NULL;
-				finished_halt_index_map = working_halt_index_map;
-				working_halt_index_map = NULL;
-				finished_halt_count = working_halt_count;
-				// working_halt_count is reset below after deleting transport matrix								
-
-				// path search completed -> delete auxilliary data structures
-				if (transport_matrix)
-				{
-					for (uint16 i = 0; i < working_halt_count; ++i)
-					{
-						delete[] transport_matrix[i];
-					}
-					delete[] transport_matrix;
-					transport_matrix = NULL;
-				}
-				working_halt_count = 0;
-				if (transfer_list)
-				{
-					delete[] transfer_list;
-					transfer_list = NULL;
-				}
-				transfer_count = 0;
-
-				if (inbound_connections)
-				{
-					delete inbound_connections;
-					inbound_connections = NULL;
-				}
-				if (outbound_connections)
-				{
-					delete outbound_connections;
-					outbound_connections = NULL;
-				}
-				process_next_transfer = true;
-
-				// Debug paths : to execute, working_halt_list should not be deleted in the previous phase
-				// enumerate_all_paths(finished_matrix, working_halt_list, finished_halt_index_map, finished_halt_count);
-
-				current_phase = phase_reroute_goods;	// proceed to the next phase
-
-				// reset counters
-				via_index = 0;
-				origin_cluster_index = 0;
-				target_cluster_index = 0;
-				origin_member_index = 0;
-
-				paths_available = true;
+				finish_path_exploration();
 			}
 			
 			return;
@@ -1645,7 +1632,7 @@ void path_explorer_t::compartment_t::step()
 			if (phase_counter == all_halts_count)
 			{
 				// iteration limit adjustment
-				if ( catg == representative_category )
+				if ( catg == representative_category && !limits_fixed )
 				{
 					const uint32 projected_iterations = statistic_iteration * time_midpoint / statistic_duration;
 					if ( projected_iterations > 0 )
@@ -1710,7 +1697,568 @@ void path_explorer_t::compartment_t::step()
 }
 
 
-void path_explorer_t::compartment_t::enumerate_all_paths(const path_element_t *const *const matrix, const halthandle_t *const halt_list, 
+void path_explorer_t::compartment_t::explore_job_t::run()
+{
+	uint64 iterations_processed = 0;
+	compartment->explore_paths(UINT64_MAX_VALUE, iterations_processed);
+	if ( compartment->compress_matrix )
+	{
+		compartment->compress_working_matrix();
+	}
+}
+
+
+void path_explorer_t::compartment_t::wait_for_explore_job()
+{
+	if ( explore_job && explore_job->is_pending() )
+	{
+		worker_pool_t::wait(explore_job);
+	}
+}
+
+
+void path_explorer_t::compartment_t::prepare_path_exploration()
+{
+	// initialize only when not resuming
+	if ( reused_copy_index == 0 && via_index == 0 && origin_cluster_index == 0 && target_cluster_index == 0 && origin_member_index == 0 )
+	{
+		// build data structures for inbound/outbound connections to/from transfer halts
+		inbound_connections = new connection_t(64u, working_halt_count);
+		outbound_connections = new connection_t(64u, working_halt_count);
+
+		via_time_list = new uint16[working_halt_count];
+		improved_list = new uint16[working_halt_count];
+
+		// fixed for this refresh, as the matrix may be compressed by a worker thread
+		compress_matrix = umgebung_t::sparse_path_matrix;
+	}
+}
+
+
+bool path_explorer_t::compartment_t::explore_paths(const uint64 iteration_limit, uint64 &iterations_processed)
+{
+	// This may run on a worker thread : only the working set of this compartment must be accessed here!
+
+	// delta refresh : take over the finished paths within unchanged components
+	while ( reused_copy_index < reused_halt_count )
+	{
+		const uint16 origin = reused_halt_list[reused_copy_index];
+		const uint16 previous_origin = working_previous_index[origin];
+		const uint16 group_begin = reused_group_begin[reused_copy_index];
+		const uint16 group_end = reused_group_end[reused_copy_index];
+
+		for ( uint16 k = group_begin; k < group_end; ++k )
+		{
+			const uint16 target = reused_halt_list[k];
+			if ( target != origin )
+			{
+				if ( !get_finished_path( previous_origin, working_previous_index[target], working_matrix.aggregate_time[origin][target], working_matrix.next_transfer[origin][target] ) )
+				{
+					working_matrix.aggregate_time[origin][target] = 65535;
+					working_matrix.next_transfer[origin][target] = halthandle_t();
+				}
+			}
+		}
+
+		++reused_copy_index;
+
+		// iteration control
+		iterations_processed += group_end - group_begin;
+		if ( iterations_processed >= iteration_limit )
+		{
+			return false;
+		}
+	}
+
+	// for each transfer
+	while ( via_index < transfer_count )
+	{
+		const uint16 via = transfer_list[via_index];
+
+		if ( process_next_transfer )
+		{
+			// prevent reconstruction of connected halt list while resuming in subsequent steps
+			process_next_transfer = false;
+
+			// identify halts which are connected with the current transfer halt
+			for ( uint16 idx = 0; idx < working_halt_count; ++idx )
+			{
+				if ( working_matrix.aggregate_time[via][idx] != 65535 && via != idx )
+				{
+					inbound_connections->register_connection( transport_matrix[idx][via].last_transport, idx );
+					outbound_connections->register_connection( transport_matrix[via][idx].first_transport, idx );
+				}
+			}
+
+			// should take into account the iterations above
+			iterations += (uint32)working_halt_count + ( inbound_connections->get_total_member_count() << 1 );
+		}
+
+		// for each origin cluster
+		while ( origin_cluster_index < inbound_connections->get_cluster_count() )
+		{
+			const connection_t::connection_cluster_t &origin_cluster = (*inbound_connections)[origin_cluster_index];
+			const uint16 inbound_transport = origin_cluster.transport;
+			const vector_tpl<uint16> &origin_halt_list = origin_cluster.connected_halts;
+
+			// for each target cluster
+			while ( target_cluster_index < outbound_connections->get_cluster_count() )
+			{
+				const connection_t::connection_cluster_t &target_cluster = (*outbound_connections)[target_cluster_index];
+				const uint16 outbound_transport = target_cluster.transport;
+				if ( inbound_transport == outbound_transport && inbound_transport != 0u )
+				{
+					++target_cluster_index;
+					continue;
+				}
+				const vector_tpl<uint16> &target_halt_list = target_cluster.connected_halts;
+				const uint16 *const target_list = target_halt_list.begin();
+				const uint32 target_count = target_halt_list.get_count();
+
+				// the times from the transfer to the targets are the same for every origin
+				const uint16 *const via_time_row = working_matrix.aggregate_time[via];
+				for ( uint32 k = 0; k < target_count; ++k )
+				{
+					via_time_list[k] = via_time_row[ target_list[k] ];
+				}
+
+				// for each origin cluster member
+				while ( origin_member_index < origin_halt_list.get_count() )
+				{
+					const uint16 origin = origin_halt_list[origin_member_index];
+
+					// relax the times of all target cluster members at once; only improved paths need further updates
+					const uint32 improved_count = min_plus_relax( working_matrix.aggregate_time[origin][via], via_time_list, target_list, target_count,
+																  working_matrix.aggregate_time[origin], improved_list );
+					for ( uint32 i = 0; i < improved_count; ++i )
+					{
+						const uint16 target = target_list[ improved_list[i] ];
+						working_matrix.next_transfer[origin][target] = working_matrix.next_transfer[origin][via];
+						transport_matrix[origin][target].first_transport = transport_matrix[origin][via].first_transport;
+						transport_matrix[origin][target].last_transport = transport_matrix[via][target].last_transport;
+					}
+
+					++origin_member_index;
+
+					// iteration control
+					iterations_processed += target_count;
+					if ( iterations_processed >= iteration_limit )
+					{
+						return false;
+					}
+
+				}	// loop : origin cluster member
+
+				origin_member_index = 0;
+
+				++target_cluster_index;
+
+			}	// loop : target cluster
+
+			target_cluster_index = 0;
+
+			++origin_cluster_index;
+
+		}	// loop : origin cluster
+
+		origin_cluster_index = 0;
+
+		// clear the inbound/outbound connections
+		inbound_connections->reset();
+		outbound_connections->reset();
+		process_next_transfer = true;
+
+		++via_index;
+	}	// loop : transfer
+
+	return true;
+}
+
+
+void path_explorer_t::compartment_t::compress_working_matrix()
+{
+	// only paths with a next transfer are ever returned by get_path_between()
+	compressed_row_start = new uint32[working_halt_count + 1];
+	uint32 path_count = 0;
+	for (uint16 origin = 0; origin < working_halt_count; ++origin)
+	{
+		compressed_row_start[origin] = path_count;
+		for (uint16 target = 0; target < working_halt_count; ++target)
+		{
+			if ( working_matrix.next_transfer[origin][target].get_id() != 0 )
+			{
+				++path_count;
+			}
+		}
+	}
+	compressed_row_start[working_halt_count] = path_count;
+
+	compressed_target_list = new uint16[path_count];
+	compressed_path_list = new path_element_t[path_count];
+	uint32 index = 0;
+	for (uint16 origin = 0; origin < working_halt_count; ++origin)
+	{
+		for (uint16 target = 0; target < working_halt_count; ++target)
+		{
+			if ( working_matrix.next_transfer[origin][target].get_id() != 0 )
+			{
+				compressed_target_list[index] = target;
+				compressed_path_list[index].aggregate_time = working_matrix.aggregate_time[origin][target];
+				compressed_path_list[index].next_transfer = working_matrix.next_transfer[origin][target];
+				++index;
+			}
+		}
+		// release each row as soon as possible to keep the peak memory down
+		working_matrix.release_row(origin);
+	}
+	working_matrix.release(working_halt_count);
+}
+
+
+void path_explorer_t::compartment_t::delete_finished_set()
+{
+	finished_matrix.release(finished_halt_count);
+	if (finished_row_start)
+	{
+		delete[] finished_row_start;
+		delete[] finished_target_list;
+		delete[] finished_path_list;
+		finished_row_start = NULL;
+		finished_target_list = NULL;
+		finished_path_list = NULL;
+	}
+	if (finished_halt_index_map)
+	{
+		delete[] finished_halt_index_map;
+		finished_halt_index_map = NULL;
+	}
+	if (finished_component)
+	{
+		delete[] finished_component;
+		finished_component = NULL;
+	}
+	finished_halt_count = 0;
+}
+
+
+void path_explorer_t::compartment_t::delete_compressed_set()
+{
+	if (compressed_row_start)
+	{
+		delete[] compressed_row_start;
+		delete[] compressed_target_list;
+		delete[] compressed_path_list;
+		compressed_row_start = NULL;
+		compressed_target_list = NULL;
+		compressed_path_list = NULL;
+	}
+}
+
+
+void path_explorer_t::compartment_t::delete_delta_set()
+{
+	if (working_previous_index)
+	{
+		delete[] working_previous_index;
+		working_previous_index = NULL;
+	}
+	if (working_halt_changed)
+	{
+		delete[] working_halt_changed;
+		working_halt_changed = NULL;
+	}
+	if (reused_halt_list)
+	{
+		delete[] reused_halt_list;
+		delete[] reused_group_begin;
+		delete[] reused_group_end;
+		reused_halt_list = NULL;
+		reused_group_begin = NULL;
+		reused_group_end = NULL;
+	}
+	reused_halt_count = 0;
+	reused_copy_index = 0;
+	working_schedule_halts.clear();
+}
+
+
+uint16 path_explorer_t::compartment_t::find_component_root(uint16 index)
+{
+	while ( working_component[index] != index )
+	{
+		// path halving
+		working_component[index] = working_component[ working_component[index] ];
+		index = working_component[index];
+	}
+	return index;
+}
+
+
+void path_explorer_t::compartment_t::unite_components(const uint16 index_a, const uint16 index_b)
+{
+	const uint16 root_a = find_component_root(index_a);
+	const uint16 root_b = find_component_root(index_b);
+	// the smaller index becomes the root, so that the result does not depend on the order of connexions
+	if ( root_a < root_b )
+	{
+		working_component[root_b] = root_a;
+	}
+	else if ( root_b < root_a )
+	{
+		working_component[root_a] = root_b;
+	}
+}
+
+
+void path_explorer_t::compartment_t::set_partial_refresh(const vector_tpl<uint16> &schedule_halts)
+{
+	refresh_requested = true;
+	FOR(vector_tpl<uint16>, const halt_id, schedule_halts)
+	{
+		changed_schedule_halts.append_unique(halt_id);
+	}
+}
+
+
+bool path_explorer_t::compartment_t::are_connexions_changed(const haltestelle_t::connexions_map_single old_connexions,
+															 const haltestelle_t::connexions_map_single new_connexions)
+{
+	// journey and waiting times are not compared : they change with every refresh
+	if ( !old_connexions || old_connexions->get_count() != new_connexions->get_count() )
+	{
+		return true;
+	}
+	FOR(connexions_map_single_remote, const& iter, *new_connexions)
+	{
+		const haltestelle_t::connexion *const old_connexion = old_connexions->get(iter.key);
+		if ( !old_connexion || old_connexion->best_line != iter.value->best_line || old_connexion->best_convoy != iter.value->best_convoy )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool path_explorer_t::compartment_t::plan_delta_refresh()
+{
+	// A component can take over its finished paths if it consists of the same halts as a component of the
+	// previous refresh, and none of its halts has had its connexions changed. As paths never leave
+	// a component, the paths within all other components are unaffected by exploring the changed ones.
+
+	uint16 *const previous_size = new uint16[finished_halt_count]();
+	for (uint16 i = 0; i < finished_halt_count; ++i)
+	{
+		++previous_size[ finished_component[i] ];
+	}
+
+	// all following arrays are indexed by component root
+	uint16 *const size = new uint16[working_halt_count]();
+	uint16 *const previous_root = new uint16[working_halt_count];
+	bool *const unchanged = new bool[working_halt_count];
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		previous_root[i] = 65535;
+		unchanged[i] = true;
+	}
+
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		const uint16 root = working_component[i];
+		++size[root];
+		const uint16 previous_index = working_previous_index[i];
+		if ( working_halt_changed[i] || previous_index == 65535 )
+		{
+			unchanged[root] = false;
+		}
+		else if ( previous_root[root] == 65535 )
+		{
+			previous_root[root] = finished_component[previous_index];
+		}
+		else if ( previous_root[root] != finished_component[previous_index] )
+		{
+			// halts of different previous components have been joined
+			unchanged[root] = false;
+		}
+	}
+
+	// a previous component which has lost halts to other components differs in size
+	uint32 reused_count = 0;
+	for (uint16 root = 0; root < working_halt_count; ++root)
+	{
+		if ( working_component[root] == root && unchanged[root] )
+		{
+			if ( previous_root[root] != 65535 && previous_size[ previous_root[root] ] == size[root] )
+			{
+				reused_count += size[root];
+			}
+			else
+			{
+				unchanged[root] = false;
+			}
+		}
+	}
+
+	delete[] previous_size;
+	delete[] previous_root;
+
+	const uint32 changed_count = (uint32)working_halt_count - reused_count;
+	if ( reused_count == 0 || changed_count * 100u > (uint32)working_halt_count * delta_refresh_max_percent )
+	{
+		delete[] size;
+		delete[] unchanged;
+		return false;
+	}
+
+	// group the halts of unchanged components; size is re-used for the next free position of each group
+	reused_halt_count = (uint16)reused_count;
+	reused_halt_list = new uint16[reused_halt_count];
+	reused_group_begin = new uint16[reused_halt_count];
+	reused_group_end = new uint16[reused_halt_count];
+	uint16 *const group_begin = new uint16[working_halt_count];
+	uint16 position = 0;
+	for (uint16 root = 0; root < working_halt_count; ++root)
+	{
+		if ( working_component[root] == root && unchanged[root] )
+		{
+			group_begin[root] = position;
+			position += size[root];
+			size[root] = group_begin[root];
+		}
+	}
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		const uint16 root = working_component[i];
+		if ( unchanged[root] )
+		{
+			const uint16 entry = size[root]++;
+			reused_halt_list[entry] = i;
+			reused_group_begin[entry] = group_begin[root];
+		}
+	}
+	for (uint16 k = 0; k < reused_halt_count; ++k)
+	{
+		reused_group_end[k] = size[ working_component[ reused_halt_list[k] ] ];
+	}
+	reused_copy_index = 0;
+
+	// only transfers within changed components need to be explored
+	uint16 kept_transfers = 0;
+	for (uint16 t = 0; t < transfer_count; ++t)
+	{
+		if ( !unchanged[ working_component[ transfer_list[t] ] ] )
+		{
+			transfer_list[kept_transfers++] = transfer_list[t];
+		}
+	}
+	transfer_count = kept_transfers;
+
+	delete[] group_begin;
+	delete[] size;
+	delete[] unchanged;
+
+#ifdef DEBUG_COMPARTMENT_STEP
+	printf("\tDelta refresh : %u of %u halts unchanged \n", (unsigned)reused_halt_count, (unsigned)working_halt_count);
+#endif
+
+	return true;
+}
+
+
+void path_explorer_t::compartment_t::finish_path_exploration()
+{
+	// reset statistic variables
+	statistic_duration = 0;
+	statistic_iteration = 0;
+
+
+	// path search completed -> delete old path info
+	delete_finished_set();
+
+	// a worker thread has already compressed the matrix
+	if ( compress_matrix && !compressed_row_start )
+	{
+		compress_working_matrix();
+	}
+
+	// transfer working to finished
+	if ( compressed_row_start )
+	{
+		finished_row_start = compressed_row_start;
+		finished_target_list = compressed_target_list;
+		finished_path_list = compressed_path_list;
+		compressed_row_start = NULL;
+		compressed_target_list = NULL;
+		compressed_path_list = NULL;
+	}
+	else
+	{
+		finished_matrix = working_matrix;
+	}
+	working_matrix = path_matrix_t();
+	finished_halt_index_map = working_halt_index_map;
+	working_halt_index_map = NULL;
+	finished_halt_count = working_halt_count;
+	finished_component = working_component;
+	working_component = NULL;
+	delete_delta_set();
+	delta_refresh = false;
+	// working_halt_count is reset below after deleting transport matrix								
+
+	// path search completed -> delete auxilliary data structures
+	if (transport_matrix)
+	{
+		for (uint16 i = 0; i < working_halt_count; ++i)
+		{
+			delete[] transport_matrix[i];
+		}
+		delete[] transport_matrix;
+		transport_matrix = NULL;
+	}
+	working_halt_count = 0;
+	if (transfer_list)
+	{
+		delete[] transfer_list;
+		transfer_list = NULL;
+	}
+	transfer_count = 0;
+
+	if (inbound_connections)
+	{
+		delete inbound_connections;
+		inbound_connections = NULL;
+	}
+	if (outbound_connections)
+	{
+		delete outbound_connections;
+		outbound_connections = NULL;
+	}
+	process_next_transfer = true;
+
+	if (via_time_list)
+	{
+		delete[] via_time_list;
+		delete[] improved_list;
+		via_time_list = NULL;
+		improved_list = NULL;
+	}
+
+	// Debug paths : to execute, working_halt_list should not be deleted in the previous phase
+	// enumerate_all_paths(finished_matrix, working_halt_list, finished_halt_index_map, finished_halt_count);
+
+	current_phase = phase_reroute_goods;	// proceed to the next phase
+
+	// reset counters
+	via_index = 0;
+	origin_cluster_index = 0;
+	target_cluster_index = 0;
+	origin_member_index = 0;
+
+	paths_available = true;
+}
+
+
+void path_explorer_t::compartment_t::enumerate_all_paths(const path_matrix_t &matrix, const halthandle_t *const halt_list, 
 														 const uint16 *const halt_map, const uint16 halt_count)
 {
 	// Debugging code : Enumerate all paths for validation
@@ -1725,9 +2273,9 @@ void path_explorer_t::compartment_t::enumerate_all_paths(const path_element_t *c
 				// print origin
 				printf("\n\nOrigin :  %s\n", halt_list[x]->get_name());
 				
-				transfer_halt = matrix[x][y].next_transfer;
+				transfer_halt = matrix.next_transfer[x][y];
 
-				if (matrix[x][y].aggregate_time == 65535)
+				if (matrix.aggregate_time[x][y] == 65535)
 				{
 					printf("\t\t\t\t******** No Route ********\n");
 				}
@@ -1739,7 +2287,7 @@ void path_explorer_t::compartment_t::enumerate_all_paths(const path_element_t *c
 
 						if ( halt_map[transfer_halt.get_id()] != 65535 )
 						{
-							transfer_halt = matrix[ halt_map[transfer_halt.get_id()] ][y].next_transfer;
+							transfer_halt = matrix.next_transfer[ halt_map[transfer_halt.get_id()] ][y];
 						}
 						else
 						{
@@ -1757,6 +2305,47 @@ void path_explorer_t::compartment_t::enumerate_all_paths(const path_element_t *c
 }
 
 
+bool path_explorer_t::compartment_t::get_finished_path(const uint16 origin_index, const uint16 target_index,
+													   uint16 &aggregate_time, halthandle_t &next_transfer) const
+{
+	if ( finished_matrix.is_allocated() )
+	{
+		if ( finished_matrix.next_transfer[origin_index][target_index].is_bound() )
+		{
+			aggregate_time = finished_matrix.aggregate_time[origin_index][target_index];
+			next_transfer = finished_matrix.next_transfer[origin_index][target_index];
+			return true;
+		}
+	}
+	else if ( finished_row_start )
+	{
+		// binary search for the target among the reachable targets of the origin
+		uint32 low = finished_row_start[origin_index];
+		uint32 high = finished_row_start[origin_index + 1];
+		while ( low < high )
+		{
+			const uint32 mid = ( low + high ) >> 1;
+			if ( finished_target_list[mid] < target_index )
+			{
+				low = mid + 1;
+			}
+			else
+			{
+				high = mid;
+			}
+		}
+		if ( low < finished_row_start[origin_index + 1] && finished_target_list[low] == target_index
+				&& finished_path_list[low].next_transfer.is_bound() )
+		{
+			aggregate_time = finished_path_list[low].aggregate_time;
+			next_transfer = finished_path_list[low].next_transfer;
+			return true;
+		}
+	}
+	return false;
+}
+
+
 bool path_explorer_t::compartment_t::get_path_between(const halthandle_t origin_halt, const halthandle_t target_halt, 
 													  uint16 &aggregate_time, halthandle_t &next_transfer)
 {
@@ -1765,12 +2354,12 @@ bool path_explorer_t::compartment_t::get_path_between(const halthandle_t origin_
 	// check if origin and target halts are both present in matrix; if yes, check the validity of the next transfer
 	if ( paths_available && origin_halt.is_bound() && target_halt.is_bound()
 			&& ( origin_index = finished_halt_index_map[ origin_halt.get_id() ] ) != 65535
-			&& ( target_index = finished_halt_index_map[ target_halt.get_id() ] ) != 65535
-			&& finished_matrix[origin_index][target_index].next_transfer.is_bound() )
+			&& ( target_index = finished_halt_index_map[ target_halt.get_id() ] ) != 65535 )
 	{
-		aggregate_time = finished_matrix[origin_index][target_index].aggregate_time;
-		next_transfer = finished_matrix[origin_index][target_index].next_transfer;
-		return true;
+		if ( get_finished_path( origin_index, target_index, aggregate_time, next_transfer ) )
+		{
+			return true;
+		}
 	}
 
 	// requested path not found
@@ -1838,3 +2427,70 @@ void path_explorer_t::compartment_t::finalise_connexion_list()
 	}
 }
 
+
+void path_explorer_t::compartment_t::get_memory_usage(uint64 &finished_bytes, uint64 &working_bytes, uint32 &stored_paths) const
+{
+	finished_bytes = 0;
+	stored_paths = 0;
+	if ( finished_matrix.is_allocated() )
+	{
+		stored_paths = (uint32)finished_halt_count * (uint32)finished_halt_count;
+		finished_bytes = (uint64)finished_halt_count * ( sizeof(uint16*) + sizeof(halthandle_t*) + sizeof(uint16) )
+						 + (uint64)stored_paths * ( sizeof(uint16) + sizeof(halthandle_t) );
+	}
+	else if ( finished_row_start )
+	{
+		stored_paths = finished_row_start[finished_halt_count];
+		finished_bytes = ( (uint64)finished_halt_count + 1u ) * sizeof(uint32) + (uint64)stored_paths * ( sizeof(uint16) + sizeof(path_element_t) );
+	}
+	if ( finished_halt_index_map )
+	{
+		finished_bytes += 65536u * sizeof(uint16);
+	}
+	if ( finished_component )
+	{
+		finished_bytes += (uint64)finished_halt_count * sizeof(uint16);
+	}
+
+	// working matrix and transport matrix exist from matrix filling until the end of path exploration
+	working_bytes = 0;
+	if ( current_phase == phase_fill_matrix || current_phase == phase_explore_paths )
+	{
+		const uint64 cells = (uint64)working_halt_count * (uint64)working_halt_count;
+		working_bytes = cells * ( sizeof(uint16) + sizeof(halthandle_t) + sizeof(transport_element_t) );
+	}
+}
+
+
+uint64 path_explorer_t::get_total_memory_usage()
+{
+	uint64 total = 0;
+	for (uint8 c = 0; c < max_categories; ++c)
+	{
+		uint64 finished_bytes, working_bytes;
+		uint32 stored_paths;
+		goods_compartment[c].get_memory_usage(finished_bytes, working_bytes, stored_paths);
+		total += finished_bytes + working_bytes;
+	}
+	return total;
+}
+
+
+void path_explorer_t::get_memory_report(cbuffer_t &buf)
+{
+	for (uint8 c = 0; c < max_categories; ++c)
+	{
+		if ( c == category_empty )
+		{
+			continue;
+		}
+		uint64 finished_bytes, working_bytes;
+		uint32 stored_paths;
+		goods_compartment[c].get_memory_usage(finished_bytes, working_bytes, stored_paths);
+		buf.printf( "%s: %s, %u halts, %u paths, %u KiB finished, %u KiB working\n",
+			translator::translate( goods_compartment[c].get_category_name() ),
+			goods_compartment[c].is_finished_set_sparse() ? "sparse" : "dense",
+			goods_compartment[c].get_finished_halt_count(), stored_paths,
+			(uint32)( finished_bytes >> 10 ), (uint32)( working_bytes >> 10 ) );
+	}
+}
@@ -9,6 +9,7 @@
 #define path_explorer_h
 
 #include "utils/memory_rw.h"
+#include "utils/worker_pool.h"
 #include "simline.h"
 #include "simhalt.h"
 #include "simworld.h"
@@ -21,6 +22,8 @@
 #include "tpl/vector_tpl.h"
 #include "tpl/quickstone_hashtable_tpl.h"
 
+class cbuffer_t;
+
 
 class path_explorer_t
 {
@@ -33,10 +36,11 @@ public:
 		uint32 fill_matrix;
 		uint64 explore_paths;
 		uint32 reroute_goods;
+		bool parallel_explore;	// path exploration is done by worker threads; only if all clients have them
 
-		limit_set_t() : rebuild_connexions(0), filter_eligible(0), fill_matrix(0), explore_paths(0), reroute_goods(0) { }
-		limit_set_t(bool) : rebuild_connexions(UINT32_MAX_VALUE), filter_eligible(UINT32_MAX_VALUE), fill_matrix(UINT32_MAX_VALUE), explore_paths(UINT64_MAX_VALUE), reroute_goods(UINT32_MAX_VALUE) { }
-		limit_set_t(uint32 c, uint32 e, uint32 m, uint64 p, uint32 g) : rebuild_connexions(c), filter_eligible(e), fill_matrix(m), explore_paths(p), reroute_goods(g) { }
+		limit_set_t() : rebuild_connexions(0), filter_eligible(0), fill_matrix(0), explore_paths(0), reroute_goods(0), parallel_explore(false) { }
+		limit_set_t(bool) : rebuild_connexions(UINT32_MAX_VALUE), filter_eligible(UINT32_MAX_VALUE), fill_matrix(UINT32_MAX_VALUE), explore_paths(UINT64_MAX_VALUE), reroute_goods(UINT32_MAX_VALUE), parallel_explore(true) { }
+		limit_set_t(uint32 c, uint32 e, uint32 m, uint64 p, uint32 g, bool t) : rebuild_connexions(c), filter_eligible(e), fill_matrix(m), explore_paths(p), reroute_goods(g), parallel_explore(t) { }
 		
 		void find_min_with(const limit_set_t &other)
 		{
@@ -45,6 +49,7 @@ public:
 			if( other.fill_matrix < fill_matrix ) { fill_matrix = other.fill_matrix; }
 			if( other.explore_paths < explore_paths ) { explore_paths = other.explore_paths; }
 			if( other.reroute_goods < reroute_goods ) { reroute_goods = other.reroute_goods; }
+			if( !other.parallel_explore ) { parallel_explore = false; }
 		}
 
 		bool operator == (const limit_set_t &other) const
@@ -53,7 +58,8 @@ public:
 				filter_eligible == other.filter_eligible		&&
 				fill_matrix == other.fill_matrix				&&
 				explore_paths == other.explore_paths			&&
-				reroute_goods == other.reroute_goods				)
+				reroute_goods == other.reroute_goods			&&
+				parallel_explore == other.parallel_explore			)
 			{
 				return true;
 			}
@@ -62,7 +68,8 @@ public:
 
 		bool operator != (const limit_set_t &other) const { return !( *this == other ); }
 
-		void rdwr(memory_rw_t *buffer)
+		// version is the network protocol version of the packet
+		void rdwr(memory_rw_t *buffer, const uint16 version)
 		{
 			buffer->rdwr_long( rebuild_connexions );
 			buffer->rdwr_long( filter_eligible );
@@ -81,6 +88,13 @@ public:
 				explore_paths = ((uint64)explore_paths_quotient << 32) | (uint64)explore_paths_remainder;
 			}
 			buffer->rdwr_long( reroute_goods );
+			if(  version >= 2  ) {
+				buffer->rdwr_bool( parallel_explore );
+			}
+			else if(  buffer->is_loading()  ) {
+				// older clients have no worker threads
+				parallel_explore = false;
+			}
 		}
 	};
 
@@ -107,6 +121,56 @@ private:
 			path_element_t() : aggregate_time(65535u) { }
 		};
 
+		// dense path data : times and next transfers are kept in separate rows,
+		// so that path exploration only has to stream through the times
+		struct path_matrix_t
+		{
+			uint16 **aggregate_time;		// each row has one entry of padding (see min_plus_relax())
+			halthandle_t **next_transfer;
+
+			path_matrix_t() : aggregate_time(NULL), next_transfer(NULL) { }
+
+			bool is_allocated() const { return aggregate_time != NULL; }
+
+			void allocate(const uint16 halt_count)
+			{
+				aggregate_time = new uint16*[halt_count];
+				next_transfer = new halthandle_t*[halt_count];
+				for (uint16 i = 0; i < halt_count; ++i)
+				{
+					aggregate_time[i] = new uint16[halt_count + 1u];
+					for (uint32 j = 0; j <= halt_count; ++j)
+					{
+						aggregate_time[i][j] = 65535u;
+					}
+					next_transfer[i] = new halthandle_t[halt_count];
+				}
+			}
+
+			void release_row(const uint16 row)
+			{
+				delete[] aggregate_time[row];
+				delete[] next_transfer[row];
+				aggregate_time[row] = NULL;
+				next_transfer[row] = NULL;
+			}
+
+			void release(const uint16 halt_count)
+			{
+				if ( aggregate_time )
+				{
+					for (uint16 i = 0; i < halt_count; ++i)
+					{
+						release_row(i);
+					}
+					delete[] aggregate_time;
+					delete[] next_transfer;
+					aggregate_time = NULL;
+					next_transfer = NULL;
+				}
+			}
+		};
+
 		// element used during path search only for storing best lines/convoys
 		struct transport_element_t
 		{
@@ -225,21 +289,60 @@ private:
 			convoihandle_t convoy;
 		};
 
+		// hands the path exploration phase of a compartment to a worker thread
+		class explore_job_t : public worker_job_t
+		{
+		private:
+			compartment_t *const compartment;
+
+		public:
+			explore_job_t(compartment_t *const owner) : compartment(owner) { }
+			virtual void run();
+		};
+
 		// store the start time of refresh
 		unsigned long refresh_start_time;
 
 		// set of variables for finished path data
-		path_element_t **finished_matrix;
+		path_matrix_t finished_matrix;
 		uint16 *finished_halt_index_map;
 		uint16 finished_halt_count;
 
+		// sparse storage of finished path data, used instead of finished_matrix (see umgebung_t::sparse_path_matrix)
+		// -> paths from origin o are at [finished_row_start[o], finished_row_start[o+1]), sorted by target index
+		uint32 *finished_row_start;
+		uint16 *finished_target_list;
+		path_element_t *finished_path_list;
+
+		// sparse storage built from the working matrix, waiting to be transferred to the finished set
+		uint32 *compressed_row_start;
+		uint16 *compressed_target_list;
+		path_element_t *compressed_path_list;
+		bool compress_matrix;	// decided when path exploration starts
+
+		// component (root = smallest member index) of each halt in the finished set, for the next delta refresh
+		uint16 *finished_component;
+
 		// set of variables for working path data
-		path_element_t **working_matrix;
+		path_matrix_t working_matrix;
 		uint16 *transport_index_map;
 		transport_element_t **transport_matrix;
 		uint16 *working_halt_index_map;
 		halthandle_t *working_halt_list;
 		uint16 working_halt_count;
+		uint16 *working_component;		// union-find parents during matrix filling, component roots afterwards
+
+		// set of variables for delta refresh
+		// -> components whose halts and connexions are unchanged since the previous refresh take over the finished paths
+		uint16 *working_previous_index;	// index of the same halt in the finished set, or 65535
+		bool *working_halt_changed;		// connexions of the halt differ from those of the previous refresh
+		uint16 *reused_halt_list;		// halts of unchanged components, grouped by component
+		uint16 *reused_group_begin;		// range of the component in reused_halt_list, for each entry
+		uint16 *reused_group_end;
+		uint16 reused_halt_count;
+		uint16 reused_copy_index;		// phase counter for taking over the finished paths
+		vector_tpl<uint16> changed_schedule_halts;	// ids of halts served by schedules changed since the current refresh started
+		vector_tpl<uint16> working_schedule_halts;	// the same for the current refresh; their connexions count as changed
 
 		// set of variables for full halt list
 		halthandle_t *all_halts_list;
@@ -260,6 +363,8 @@ private:
 		bool paths_available;
 		bool refresh_completed;
 		bool refresh_requested;
+		bool full_refresh_requested;	// some refresh request cannot be served by a delta refresh
+		bool delta_refresh;				// the current refresh reuses the paths of unchanged components
 
 		// phase indicator
 		uint8 current_phase;
@@ -279,6 +384,17 @@ private:
 		connection_t *outbound_connections;		// relative to the current transfer
 		bool process_next_transfer;
 
+		// scratch lists for the relaxation kernel, sized for the working halts
+		uint16 *via_time_list;			// times from the current transfer to the members of a target cluster
+		uint16 *improved_list;			// positions in the target cluster whose paths have been improved
+
+		// path exploration running on a worker thread and the explorer step at which its result is collected
+		explore_job_t *explore_job;
+		uint32 explore_join_step;
+		// whether this refresh explores on a worker thread; fixed in phase_init_prepare,
+		// so a change of the limits cannot switch to the serial path while the job runs
+		bool explore_in_parallel;
+
 		// statistics for determining limits
 		uint32 statistic_duration;
 		uint32 statistic_iteration;
@@ -296,6 +412,10 @@ private:
 		// indicate whether phase limits are used or not
 		// -> it is turned off for initial full instant search
 		static bool use_limits;
+
+		// indicate whether the limits are kept as they are instead of being adapted to the time taken
+		// -> it is turned on for benchmarks, whose results must not depend on the speed of the machine
+		static bool limits_fixed;
 		
 		// iteration limits
 		static uint32 limit_rebuild_connexions;
@@ -311,6 +431,10 @@ private:
 		static uint64 local_explore_paths;
 		static uint32 local_reroute_goods;
 
+		// path exploration on worker threads : active setting and local capability
+		static bool limit_parallel_explore;
+		static bool local_parallel_explore;
+
 		// indicate whether local limits has changed
 		static bool local_limits_changed;
 
@@ -321,6 +445,12 @@ private:
 		static const uint64 default_explore_paths = 1048576;
 		static const uint32 default_reroute_goods = 4096;
 
+		// delta refresh falls back to a full refresh if more than this percentage of halts are in changed components
+		static const uint32 delta_refresh_max_percent = 50;
+
+		// number of explorer steps between handing path exploration to a worker and swapping in its result
+		static const uint32 explore_sync_delay = 16;
+
 		// phase indices
 		static const uint8 phase_check_flag = 0;
 		static const uint8 phase_init_prepare = 1;
@@ -342,9 +472,35 @@ private:
 		static const uint32 percent_lower_limit = 100 - percent_deviation;
 		static const uint32 percent_upper_limit = 100 + percent_deviation;
 
-		void enumerate_all_paths(const path_element_t *const *const matrix, const halthandle_t *const halt_list,
+		void enumerate_all_paths(const path_matrix_t &matrix, const halthandle_t *const halt_list,
 								 const uint16 *const halt_map, const uint16 halt_count);
 
+		// the 3 parts of the path exploration phase; only explore_paths() may run on a worker thread
+		void prepare_path_exploration();
+		bool explore_paths(const uint64 iteration_limit, uint64 &iterations_processed);
+		void finish_path_exploration();
+
+		// convert the working matrix into sparse storage; may run on a worker thread
+		void compress_working_matrix();
+
+		void delete_finished_set();
+		void delete_compressed_set();
+		void delete_delta_set();
+
+		// finished path data by matrix indices; false if there is no path
+		bool get_finished_path(const uint16 origin_index, const uint16 target_index, uint16 &aggregate_time, halthandle_t &next_transfer) const;
+
+		uint16 find_component_root(uint16 index);
+		void unite_components(const uint16 index_a, const uint16 index_b);
+
+		static bool are_connexions_changed(const haltestelle_t::connexions_map_single old_connexions,
+										   const haltestelle_t::connexions_map_single new_connexions);
+
+		// select the unchanged components whose paths are taken over; false if a full refresh is more appropriate
+		bool plan_delta_refresh();
+
+		void wait_for_explore_job();
+
 	public:
 
 		compartment_t();
@@ -358,13 +514,21 @@ private:
 		bool are_paths_available() { return paths_available; }
 		bool is_refresh_completed() { return refresh_completed; }
 		bool is_refresh_requested() { return refresh_requested; }
+		bool is_awaiting_worker() const { return explore_job && explore_job->is_pending(); }
+		bool is_explore_job_due() const { return is_awaiting_worker() && (sint32)(step_counter - explore_join_step) >= 0; }
 
 		void set_category(uint8 category);
-		void set_refresh() { refresh_requested = true; }
+		void set_refresh() { refresh_requested = true; full_refresh_requested = true; }
+		void set_partial_refresh(const vector_tpl<uint16> &schedule_halts);
 
 		bool get_path_between(const halthandle_t origin_halt, const halthandle_t target_halt,
 							  uint16 &aggregate_time, halthandle_t &next_transfer);
 
+		// memory used by finished and working path data of this compartment, in bytes
+		void get_memory_usage(uint64 &finished_bytes, uint64 &working_bytes, uint32 &stored_paths) const;
+		bool is_finished_set_sparse() const { return finished_row_start != NULL; }
+		uint16 get_finished_halt_count() const { return finished_halt_count; }
+
 		const char *get_category_name() { return ( catg_name ? catg_name : "" ); }
 		const char *get_current_phase_name() { return phase_name[current_phase]; }
 
@@ -380,15 +544,25 @@ private:
 		{
 			use_limits = yesno;
 		}
+
+		static void fix_limits(const bool yesno)
+		{
+			limits_fixed = yesno;
+		}
+
+		static limit_set_t get_default_limits()
+		{
+			return limit_set_t( default_rebuild_connexions, default_filter_eligible, default_fill_matrix, default_explore_paths, default_reroute_goods, true );
+		}
 		
 		static limit_set_t get_local_limits()
 		{
-			return limit_set_t( local_rebuild_connexions, local_filter_eligible, local_fill_matrix, local_explore_paths, local_reroute_goods );
+			return limit_set_t( local_rebuild_connexions, local_filter_eligible, local_fill_matrix, local_explore_paths, local_reroute_goods, local_parallel_explore );
 		}
 
 		static limit_set_t get_active_limits()
 		{
-			return limit_set_t( limit_rebuild_connexions, limit_filter_eligible, limit_fill_matrix, limit_explore_paths, limit_reroute_goods );
+			return limit_set_t( limit_rebuild_connexions, limit_filter_eligible, limit_fill_matrix, limit_explore_paths, limit_reroute_goods, limit_parallel_explore );
 		}
 
 		static void set_limits(const limit_set_t &limit_set)
@@ -398,6 +572,7 @@ private:
 			limit_fill_matrix = limit_set.fill_matrix;
 			limit_explore_paths = limit_set.explore_paths;
 			limit_reroute_goods = limit_set.reroute_goods;
+			limit_parallel_explore = limit_set.parallel_explore;
 		}
 
 		static void set_default_limits()
@@ -416,6 +591,7 @@ private:
 		static uint32 get_limit_fill_matrix() { return limit_fill_matrix; }
 		static uint64 get_limit_explore_paths() { return limit_explore_paths; }
 		static uint32 get_limit_reroute_goods() { return limit_reroute_goods; }
+		static bool is_parallel_explore() { return limit_parallel_explore; }
 
 	};
 
@@ -425,6 +601,7 @@ private:
 	static compartment_t *goods_compartment;
 	static uint8 current_compartment;
 	static bool processing;
+	static uint32 step_counter;	// number of calls to step() since initialise(); identical on all network clients
 
 public:
 
@@ -435,6 +612,9 @@ public:
 	static void full_instant_refresh();
 	static void refresh_all_categories(const bool reset_working_set);
 	static void refresh_category(const uint8 category) { goods_compartment[category].set_refresh(); }
+	// only components of the halt network whose connexions have changed, or which contain one of the
+	// given halts (those of a changed schedule), are explored again
+	static void refresh_category_partially(const uint8 category, const vector_tpl<uint16> &schedule_halts) { goods_compartment[category].set_partial_refresh(schedule_halts); }
 	static bool get_catg_path_between(const uint8 category, const halthandle_t origin_halt, const halthandle_t target_halt,
 									  uint16 &aggregate_time, halthandle_t &next_transfer)
 	{
@@ -447,15 +627,23 @@ public:
 	static limit_set_t get_local_limits() { return compartment_t::get_local_limits(); }
 	static limit_set_t get_active_limits() { return compartment_t::get_active_limits(); }
 	static void set_limits(const limit_set_t &limit_set) { compartment_t::set_limits(limit_set); }
+	static limit_set_t get_default_limits() { return compartment_t::get_default_limits(); }
+	static void fix_limits(const bool yesno) { compartment_t::fix_limits(yesno); }
 	static uint32 get_limit_rebuild_connexions() { return compartment_t::get_limit_rebuild_connexions(); }
 	static uint32 get_limit_filter_eligible() { return compartment_t::get_limit_filter_eligible(); }
 	static uint32 get_limit_fill_matrix() { return compartment_t::get_limit_fill_matrix(); }
 	static uint64 get_limit_explore_paths() { return compartment_t::get_limit_explore_paths(); }
 	static uint32 get_limit_reroute_goods() { return compartment_t::get_limit_reroute_goods(); }
+	static bool is_parallel_explore() { return compartment_t::is_parallel_explore(); }
 	static bool is_processing() { return processing; }
 	static const char *get_current_category_name() { return goods_compartment[current_compartment].get_category_name(); }
 	static const char *get_current_phase_name() { return goods_compartment[current_compartment].get_current_phase_name(); }
 
+	// memory used by the path data of all categories, in bytes
+	static uint64 get_total_memory_usage();
+	// one line per category : storage mode, halt count, stored paths and memory usage
+	static void get_memory_report(cbuffer_t &buf);
+
 };
 
 #endif
@@ -285,6 +285,7 @@ public:
 	 * @author Hj. Malthaner
 	 */
 	double get_konto_als_double() const { return konto / 100.0; }
+	sint64 get_konto() const { return konto; }
 
 	/**
 	 * @return true wenn Konto berzogen ist
@@ -58,11 +58,13 @@
 #include "bauer/fabrikbauer.h"
 #include "utils/cbuffer_t.h"
 #include "utils/simstring.h"
+#include "utils/simprofile.h"
 #ifdef DEBUG_WEIGHTMAPS
 #include "utils/dbg_weightmap.h"
 #endif
 
 #include "tpl/minivec_tpl.h"
+#include "tpl/ptrhashtable_tpl.h"
 
 karte_t* stadt_t::welt = NULL; // one is enough ...
 
@@ -401,11 +403,69 @@ public:
 	}
 };
 
+/**
+ * Properties of a tile tested by the rules, one bit each. The cells of the
+ * 7x7 square around a location are numbered x+7*y, so for each property the
+ * cells having it form a 49 bit mask.
+ */
+enum {
+	cell_on_map = 0,	// outside of the map no rule can be applied
+	cell_road,	// s, S
+	cell_house,	// h
+	cell_fundament,	// H
+	cell_nature,	// n
+	cell_wegbar,	// U, u
+	cell_halt,	// t, T
+	CELL_CLASS_COUNT
+};
+
 class rule_t {
 public:
 	sint16  chance;
 	vector_tpl<rule_entry_t> rule;
-	rule_t(uint32 count=0) : chance(0), rule(count) {}
+
+	// the cells which must have / must not have a property, per rotation (0, 90, 180, 270 degrees), see compile()
+	uint64 must_set[4][CELL_CLASS_COUNT];
+	uint64 must_clear[4][CELL_CLASS_COUNT];
+
+	rule_t(uint32 count=0) : chance(0), rule(count)
+	{
+		compile();
+	}
+
+	// translates the entries into the masks above
+	void compile()
+	{
+		MEMZERO(must_set);
+		MEMZERO(must_clear);
+		FOR(vector_tpl<rule_entry_t>, const& r, rule) {
+			for(  int rot = 0;  rot < 4;  rot++  ) {
+				uint8 x,y;
+				switch (rot) {
+					default:
+					case 0: x=r.x; y=r.y; break;
+					case 1: x=r.y; y=6-r.x; break;
+					case 2: x=6-r.x; y=6-r.y; break;
+					case 3: x=6-r.y; y=r.x; break;
+				}
+				const uint64 cell = (uint64)1 << (x + 7*y);
+				must_set[rot][cell_on_map] |= cell;
+				switch (r.flag) {
+					case 's': must_set[rot][cell_road] |= cell; break;
+					case 'S': must_clear[rot][cell_road] |= cell; break;
+					case 'h': must_set[rot][cell_house] |= cell; break;
+					case 'H': must_clear[rot][cell_fundament] |= cell; break;
+					case 'n': must_set[rot][cell_nature] |= cell; break;
+					case 'U': must_set[rot][cell_wegbar] |= cell; break;
+					case 'u': must_clear[rot][cell_wegbar] |= cell; break;
+					case 't': must_set[rot][cell_halt] |= cell; break;
+					case 'T': must_clear[rot][cell_halt] |= cell; break;
+					default: ;
+						// ignore
+				}
+			}
+		}
+	}
 
 	void rdwr(loadsave_t* file)
 	{
@@ -422,9 +482,122 @@ public:
 			}
 			rule[i].rdwr(file);
 		}
+		if (file->is_loading()) {
+			compile();
+		}
 	}
 };
 
+
+/**
+ * The properties of the tiles around a city, looked up when a rule needs
+ * them the first time. They are only valid during one call of
+ * stadt_t::baue(), since the candidate locations are all evaluated before
+ * anything is built; tiles may be changed by anyone in between.
+ */
+class rule_cells_t
+{
+private:
+	// stamp<<8 | property bits, only valid if the stamp is the current one
+	vector_tpl<uint32> cells;
+	koord origin;
+	sint16 width, height;
+	uint32 stamp;
+
+	// the masks for the 7x7 cells around window_pos
+	koord window_pos;
+	uint32 window_stamp;
+	uint64 planes[CELL_CLASS_COUNT];
+
+	static uint8 classify(karte_t *welt, koord k)
+	{
+		const grund_t* gr = welt->lookup_kartenboden(k);
+		if (gr == NULL) {
+			return 0;
+		}
+		uint8 c = 1 << cell_on_map;
+		if (gr->hat_weg(road_wt)) {
+			c |= 1 << cell_road;
+		}
+		if (gr->get_typ() == grund_t::fundament) {
+			c |= 1 << cell_fundament;
+			if (gr->obj_bei(0)  &&  gr->obj_bei(0)->get_typ()==ding_t::gebaeude) {
+				c |= 1 << cell_house;
+			}
+		}
+		if (gr->ist_natur()  &&  gr->kann_alle_obj_entfernen(NULL) == NULL) {
+			c |= 1 << cell_nature;
+		}
+		if (hang_t::ist_wegbar(gr->get_grund_hang())) {
+			c |= 1 << cell_wegbar;
+		}
+		if (gr->is_halt()) {
+			c |= 1 << cell_halt;
+		}
+		return c;
+	}
+
+	uint8 get_class(karte_t *welt, koord k)
+	{
+		const koord d = k - origin;
+		if(  d.x < 0  ||  d.y < 0  ||  d.x >= width  ||  d.y >= height  ) {
+			return classify(welt, k);
+		}
+		uint32 &cell = cells[d.x + d.y*(uint32)width];
+		if(  (cell >> 8) != stamp  ) {
+			cell = (stamp << 8) | classify(welt, k);
+		}
+		return (uint8)cell;
+	}
+
+public:
+	rule_cells_t() : width(0), height(0), stamp(0), window_stamp(0) {}
+
+	// forgets everything; the locations within lo..ur (and the cells around them) will be evaluated
+	void reset(koord lo, koord ur)
+	{
+		origin = lo - koord(4,4);
+		width = ur.x - lo.x + 9;
+		height = ur.y - lo.y + 9;
+		const uint32 size = (uint32)width * height;
+		while(  cells.get_count() < size  ) {
+			cells.append(0);
+		}
+		if(  ++stamp >= (1u << 24)  ) {
+			// the stamp wraps around
+			stamp = 1;
+			for(  uint32 i = 0;  i < cells.get_count();  i++  ) {
+				cells[i] = 0;
+			}
+		}
+		window_stamp = 0;
+	}
+
+	// the cells with each property around pos, cell (x,y) is tile pos+(x-3,y-3)
+	const uint64 *get_window(karte_t *welt, koord pos)
+	{
+		if(  window_stamp != stamp  ||  window_pos != pos  ) {
+			MEMZERO(planes);
+			for(  int y = 0;  y < 7;  y++  ) {
+				for(  int x = 0;  x < 7;  x++  ) {
+					const uint8 c = get_class(welt, pos + koord(x-3, y-3));
+					const uint64 cell = (uint64)1 << (x + 7*y);
+					for(  int p = 0;  p < CELL_CLASS_COUNT;  p++  ) {
+						if(  c & (1 << p)  ) {
+							planes[p] |= cell;
+						}
+					}
+				}
+			}
+			window_pos = pos;
+			window_stamp = stamp;
+		}
+		return planes;
+	}
+};
+
+static rule_cells_t rule_cells;
+
 // house rules
 static vector_tpl<rule_t *> house_rules;
 
@@ -644,67 +817,14 @@ static char const* const allowed_chars_in_rule = "SsnHhTtUu";
 //			}
 bool stadt_t::bewerte_loc(const koord pos, const rule_t &regel, int rotation)
 {
-	//printf("Test for (%s) in rotation %d\n", pos.get_str(), rotation);
-	koord k;
-
-	FOR(vector_tpl<rule_entry_t>, const& r, regel.rule) {
-		uint8 x,y;
-		switch (rotation) {
-			default:
-			case   0: x=r.x; y=r.y; break;
-			case  90: x=r.y; y=6-r.x; break;
-			case 180: x=6-r.x; y=6-r.y; break;
-			case 270: x=6-r.y; y=r.x; break;
-		}
-
-		const koord k(pos.x+x-3, pos.y+y-3);
-		const grund_t* gr = welt->lookup_kartenboden(k);
-		if (gr == NULL) {
-			// outside of the map => cannot apply this rule
+	const uint64 *const planes = rule_cells.get_window(welt, pos);
+	const uint64 *const must_set = regel.must_set[rotation/90];
+	const uint64 *const must_clear = regel.must_clear[rotation/90];
+	for(  int p = 0;  p < CELL_CLASS_COUNT;  p++  ) {
+		if(  (planes[p] & must_set[p]) != must_set[p]  ||  (planes[p] & must_clear[p]) != 0  ) {
 			return false;
 		}
-		switch (r.flag) {
-			case 's':
-				// road?
-				if (!gr->hat_weg(road_wt)) return false;
-				break;
-			case 'S':
-				// not road?
-				if (gr->hat_weg(road_wt)) return false;
-				break;
-			case 'h':
-				// is house
-				if (gr->get_typ() != grund_t::fundament  ||  gr->obj_bei(0)->get_typ()!=ding_t::gebaeude) return false;
-				break;
-			case 'H':
-				// no house
-				if (gr->get_typ() == grund_t::fundament) return false;
-				break;
-			case 'n':
-				// nature/empty
-				if (!gr->ist_natur() || gr->kann_alle_obj_entfernen(NULL) != NULL) return false;
-				break;
-			case 'U':
-				// unbuildable for road
-				if (!hang_t::ist_wegbar(gr->get_grund_hang())) return false;
-				break;
-			case 'u':
-				// road may be buildable
-				if (hang_t::ist_wegbar(gr->get_grund_hang())) return false;
-				break;
-			case 't':
-				// here is a stop/extension building
-				if (!gr->is_halt()) return false;
-				break;
-			case 'T':
-				// no stop
-				if (gr->is_halt()) return false;
-				break;
-			default: ;
-				// ignore
-		}
 	}
-	//printf("Success\n");
 	return true;
 }
 
@@ -908,6 +1028,12 @@ bool stadt_t::cityrules_init(const std::string &objfilename)
 			printf("Road-Rule %d: Pos (%d,%d) Flag %d\n",i,road_rules[i]->rule[j].x,road_rules[i]->rule[j].y,road_rules[i]->rule[j].flag);
 		
 	}
+	FOR(vector_tpl<rule_t*>, const r, house_rules) {
+		r->compile();
+	}
+	FOR(vector_tpl<rule_t*>, const r, road_rules) {
+		r->compile();
+	}
 	return true;
 }
 
@@ -2356,11 +2482,15 @@ void stadt_t::step(long delta_t)
 	}
 
 	// create passenger rate proportional to town size
+	// all buildings due in this step are handled as one batch
+	uint32 buildings_due = 0;
 	while(step_interval < next_step) {
-		step_passagiere();
-		step_count++;
+		buildings_due++;
 		next_step -= step_interval;
 	}
+	if(  buildings_due > 0  ) {
+		step_passagiere_batch( buildings_due );
+	}
 
 	// update history (might be changed do to construction/destroying of houses)
 	city_history_month[0][HIST_CITICENS] = get_einwohner();	// total number
@@ -2504,6 +2634,10 @@ void stadt_t::neuer_monat(bool check) //"New month" (Google)
 		connected_industries.clear();
 		connected_attractions.clear();
 		check_road_connexions = false;
+		if(!welt->get_settings().get_assume_everywhere_connected_by_road())
+		{
+			calc_road_connexions();
+		}
 	}
 	
 	if (!stadtauto_t::list_empty()) 
@@ -2844,45 +2978,23 @@ uint16 stadt_t::check_road_connexion_to(const fabrik_t* industry)
 		}
 	}
 
-	vector_tpl<koord> industry_tiles;
-	industry->get_tile_list(industry_tiles);
-	weg_t* road = NULL;
-	ITERATE(industry_tiles, n)
+	const weg_t* road = find_road_near(welt, industry);
+	if(road != NULL)
 	{
-		const koord pos = industry_tiles.get_element(n);
-		grund_t *gr;
-		for(uint8 i = 0; i < 16; i ++)
+		const koord3d destination = road->get_pos();
+		const uint16 journey_time_per_tile = check_road_connexion(destination);
+		connected_industries.put(industry->get_pos().get_2d(), journey_time_per_tile);
+		if(journey_time_per_tile == 65535)
 		{
-			koord3d pos3d(pos + pos.second_neighbours[i], welt->lookup_hgt(pos + pos.second_neighbours[i]));
-			gr = welt->lookup(pos3d);
-			if(!gr)
-			{
-				pos3d.z ++;
-				gr = welt->lookup(pos3d);
-				if(!gr)
-				{
-					continue;
-				}
-			}
-			road = gr->get_weg(road_wt);
-			if(road != NULL)
+			// We know that, if this city is not connected to any given industry, then every city
+			// to which this city is connected must likewise not be connected. So, avoid
+			// unnecessary recalculation by propogating this now.
+			FOR(connexion_map, const& iter, connected_cities)
 			{
-				const koord3d destination = road->get_pos();
-				const uint16 journey_time_per_tile = check_road_connexion(destination);
-				connected_industries.put(industry->get_pos().get_2d(), journey_time_per_tile);
-				if(journey_time_per_tile == 65535)
-				{
-					// We know that, if this city is not connected to any given industry, then every city
-					// to which this city is connected must likewise not be connected. So, avoid
-					// unnecessary recalculation by propogating this now.
-					FOR(connexion_map, const& iter, connected_cities)
-					{
-						welt->get_city(iter.key)->set_no_connexion_to_industry(industry);
-					}
-				}
-				return journey_time_per_tile;
+				welt->get_city(iter.key)->set_no_connexion_to_industry(industry);
 			}
 		}
+		return journey_time_per_tile;
 	}
 
 	// No road connecting to industry - no connexion at all.
@@ -2909,28 +3021,7 @@ uint16 stadt_t::check_road_connexion_to(const gebaeude_t* attraction)
 	{
 		return connected_attractions.get(attraction->get_pos().get_2d());
 	}
-	const koord pos = attraction->get_pos().get_2d();
-	grund_t *gr;
-	weg_t* road = NULL;
-	for(uint8 i = 0; i < 16; i ++)
-	{
-		koord3d pos3d(pos + pos.second_neighbours[i], welt->lookup_hgt(pos + pos.second_neighbours[i]));
-		gr = welt->lookup(pos3d);
-		if(!gr)
-		{
-			pos3d.z ++;
-			gr = welt->lookup(pos3d);
-			if(!gr)
-			{
-				continue;
-			}
-		}
-		road = gr->get_weg(road_wt);
-		if(road != NULL)
-		{
-			break;
-		}
-	}
+	const weg_t* road = find_road_near(welt, attraction->get_pos().get_2d());
 	if(road == NULL)
 	{
 		// No road connecting to attraction - no connexion at all.
@@ -2968,7 +3059,7 @@ uint16 stadt_t::check_road_connexion(koord3d dest)
 	finder->set_destination(dest);
 	const uint32 depth = welt->get_max_road_check_depth();
 	// Must use calc_route rather than find_route, or else this will be *far* too slow: only calc_route uses A*.
-	if(!private_car_route->calc_route(welt, origin, dest, finder, welt->get_citycar_speed_average(), 0, depth))
+	if(!private_car_route->calc_route(welt, origin, dest, finder, welt->get_citycar_speed_average(), 0, depth, 0xFFFFFFFF, true))
 	{
 		return 65535;
 	}
@@ -2986,13 +3077,254 @@ uint16 stadt_t::check_road_connexion(koord3d dest)
 		speed_sum += min(top_speed, vehicle_speed_average);
 		count += road->is_diagonal() ? 7 : 10; //Use precalculated numbers to avoid division here.
 	}
+	return calc_journey_time_per_tile(welt, speed_sum, count, private_car_route->get_count(), origin.get_2d(), dest.get_2d());
+}
+
+
+uint16 stadt_t::calc_journey_time_per_tile(const karte_t *welt, sint32 speed_sum, uint32 count, uint32 tiles, koord origin, koord dest)
+{
 	const sint32 speed_average = (speed_sum * 100) / (count * 13); // was (float)(speed_sum / ((float)count / 10.0F))  / 1.3F;
-	const uint32 journey_distance_m = private_car_route->get_count() *welt->get_settings().get_meters_per_tile();
+	const uint32 journey_distance_m = tiles * welt->get_settings().get_meters_per_tile();
 	const uint16 journey_time = speed_average == 0 ? 65535 : (6 * journey_distance_m) / (10 * speed_average); // *Tenths* of minutes: hence *0.6, not *0.06.
-	const uint16 straight_line_distance_tiles = shortest_distance(origin.get_2d(), dest.get_2d());
+	const uint16 straight_line_distance_tiles = shortest_distance(origin, dest);
 	return journey_time / (straight_line_distance_tiles == 0 ? 1 : straight_line_distance_tiles);
 }
 
+
+weg_t* stadt_t::find_road_near(karte_t *welt, koord pos)
+{
+	for(uint8 i = 0; i < 16; i ++)
+	{
+		koord3d pos3d(pos + pos.second_neighbours[i], welt->lookup_hgt(pos + pos.second_neighbours[i]));
+		grund_t *gr = welt->lookup(pos3d);
+		if(!gr)
+		{
+			pos3d.z ++;
+			gr = welt->lookup(pos3d);
+			if(!gr)
+			{
+				continue;
+			}
+		}
+		weg_t* road = gr->get_weg(road_wt);
+		if(road != NULL)
+		{
+			return road;
+		}
+	}
+	return NULL;
+}
+
+
+weg_t* stadt_t::find_road_near(karte_t *welt, const fabrik_t* industry)
+{
+	vector_tpl<koord> industry_tiles;
+	industry->get_tile_list(industry_tiles);
+	FOR(vector_tpl<koord>, const& pos, industry_tiles)
+	{
+		weg_t* road = find_road_near(welt, pos);
+		if(road != NULL)
+		{
+			return road;
+		}
+	}
+	return NULL;
+}
+
+
+/**
+ * One destination of calc_road_connexions(): the road tile by which a city,
+ * industry or attraction is reached. Destinations on the same tile are chained.
+ */
+struct road_connexion_target_t
+{
+	enum { city, industry, attraction } type;
+	koord key;  // position used as key in the connexion maps
+	koord3d dest;
+	uint32 next_on_tile;  // index+1 of the next target on the same tile, 0 = none
+};
+
+
+void stadt_t::calc_road_connexions()
+{
+	const koord3d origin(townhall_road, welt->lookup_hgt(townhall_road));
+	const grund_t* start = welt->lookup(origin);
+	if(start == NULL  ||  !finder->ist_befahrbar(start))
+	{
+		// leave it to the single searches, which will find nothing either
+		return;
+	}
+
+	// collect the destination roads; first target index+1 per tile
+	vector_tpl<road_connexion_target_t> targets;
+	ptrhashtable_tpl<const grund_t*, uint32> first_target;
+	uint32 targets_left = 0;
+	road_connexion_target_t t;
+	t.next_on_tile = 0;
+	const weighted_vector_tpl<stadt_t*>& staedte = welt->get_staedte();
+	for(uint32 i = 0; i < staedte.get_count(); i ++)
+	{
+		const stadt_t* city = staedte[i];
+		if(city == this)
+		{
+			// the own city does not need a search
+			continue;
+		}
+		t.type = road_connexion_target_t::city;
+		t.key = city->get_pos();
+		t.dest = koord3d(city->get_townhall_road(), welt->lookup_hgt(city->get_townhall_road()));
+		targets.append(t);
+	}
+	FOR(vector_tpl<fabrik_t*>, const fab, welt->get_fab_list())
+	{
+		if(fab->get_city())
+		{
+			// these use the connexion to their city first
+			continue;
+		}
+		const weg_t* road = find_road_near(welt, fab);
+		if(road == NULL)
+		{
+			connected_industries.set(fab->get_pos().get_2d(), 65535);
+			continue;
+		}
+		t.type = road_connexion_target_t::industry;
+		t.key = fab->get_pos().get_2d();
+		t.dest = road->get_pos();
+		targets.append(t);
+	}
+	FOR(weighted_vector_tpl<gebaeude_t*>, const attraction, welt->get_ausflugsziele())
+	{
+		const weg_t* road = find_road_near(welt, attraction->get_pos().get_2d());
+		if(road == NULL)
+		{
+			connected_attractions.set(attraction->get_pos().get_2d(), 65535);
+			continue;
+		}
+		t.type = road_connexion_target_t::attraction;
+		t.key = attraction->get_pos().get_2d();
+		t.dest = road->get_pos();
+		targets.append(t);
+	}
+	for(uint32 i = 0; i < targets.get_count(); i ++)
+	{
+		const grund_t* gr = welt->lookup(targets[i].dest);
+		if(gr == NULL)
+		{
+			continue;
+		}
+		targets[i].next_on_tile = first_target.get(gr);
+		first_target.set(gr, i + 1);
+		targets_left ++;
+	}
+	if(targets_left == 0)
+	{
+		return;
+	}
+
+	// Dijkstra from the townhall road until all destinations are reached:
+	// one search instead of one calc_route() per destination
+	if(!route_t::MAX_STEP)
+	{
+		route_t::INIT_NODES(welt->get_settings().get_max_route_steps(), welt->get_groesse_x(), welt->get_groesse_y());
+	}
+	route_t::search_context_t &context = route_t::get_main_context();
+	context.prepare(welt);
+	binary_heap_tpl<route_t::ANode*> &queue = context.queue[0];
+	marker_t &closed = context.closed[0];
+	route_t::ANode *nodes;
+	const uint8 ni = context.get_nodes(&nodes);
+
+	const sint32 vehicle_speed_average = welt->get_citycar_speed_average();
+	uint32 step = 0;
+	route_t::ANode* tmp = &nodes[step++];
+	tmp->parent = NULL;
+	tmp->gr = start;
+	tmp->f = tmp->g = 0;
+	tmp->dir = 0;
+	tmp->count = 0;
+	queue.insert(tmp);
+
+	bool out_of_steps = false;
+	while(!queue.empty()  &&  targets_left > 0  &&  !out_of_steps)
+	{
+		tmp = queue.pop();
+		const grund_t* gr = tmp->gr;
+		if(closed.ist_markiert(gr))
+		{
+			continue;
+		}
+		closed.markiere(gr);
+
+		for(uint32 i = first_target.get(gr); i != 0; i = targets[i - 1].next_on_tile)
+		{
+			// evaluate the journey along the path, as check_road_connexion() does for a route
+			sint32 speed_sum = 0;
+			uint32 count = 0;
+			for(const route_t::ANode* n = tmp; n != NULL; n = n->parent)
+			{
+				const weg_t* road = n->gr->get_weg(road_wt);
+				speed_sum += min((sint32)road->get_max_speed(), vehicle_speed_average);
+				count += road->is_diagonal() ? 7 : 10;
+			}
+			const road_connexion_target_t& target = targets[i - 1];
+			const uint16 journey_time_per_tile = calc_journey_time_per_tile(welt, speed_sum, count, tmp->count + 1, origin.get_2d(), target.dest.get_2d());
+			switch(target.type)
+			{
+				case road_connexion_target_t::city:       connected_cities.set(target.key, journey_time_per_tile);      break;
+				case road_connexion_target_t::industry:   connected_industries.set(target.key, journey_time_per_tile);  break;
+				case road_connexion_target_t::attraction: connected_attractions.set(target.key, journey_time_per_tile); break;
+			}
+			targets_left --;
+		}
+
+		const ribi_t::ribi ribi = finder->get_ribi(gr);
+		for(int r = 0; r < 4; r ++)
+		{
+			grund_t* to;
+			if((ribi & ribi_t::nsow[r]) == 0  ||  !gr->get_neighbour(to, road_wt, ribi_t::nsow[r])  ||  !finder->ist_befahrbar(to)  ||  closed.ist_markiert(to))
+			{
+				continue;
+			}
+			const weg_t* w = to->get_weg(road_wt);
+			if((ribi_t::nsow[r] & w->get_ribi_maske()) != 0)
+			{
+				// one way sign
+				continue;
+			}
+			if(step >= route_t::MAX_STEP)
+			{
+				out_of_steps = true;
+				break;
+			}
+			route_t::ANode* k = &nodes[step++];
+			k->parent = tmp;
+			k->gr = to;
+			k->g = k->f = tmp->g + finder->get_kosten(to, vehicle_speed_average, gr->get_pos().get_2d());
+			k->dir = 0;
+			k->count = tmp->count + 1;
+			queue.insert(k);
+		}
+	}
+
+	if(queue.empty()  &&  !out_of_steps)
+	{
+		// the whole road network in reach has been searched: everything else is unreachable
+		for(uint32 i = 0; i < targets.get_count(); i ++)
+		{
+			const road_connexion_target_t& target = targets[i];
+			connexion_map& map = target.type == road_connexion_target_t::city ? connected_cities : target.type == road_connexion_target_t::industry ? connected_industries : connected_attractions;
+			if(!map.is_contained(target.key))
+			{
+				map.put(target.key, 65535);
+			}
+		}
+	}
+	// otherwise the destinations not reached are searched one by one when needed
+
+	context.release_nodes(ni);
+}
+
 void stadt_t::add_road_connexion(uint16 journey_time_per_tile, stadt_t* origin_city)
 {
 	
@@ -3022,34 +3354,54 @@ void stadt_t::set_no_connexion_to_attraction(const gebaeude_t* unconnected_attra
 }
 
 
+// Halt lists of step_passagiere(), kept between the calls to save the
+// allocations for every building and every destination.
+static minivec_tpl<halthandle_t> start_halt_buffer;
+static minivec_tpl<halthandle_t> destination_halt_buffer;
+
+stadt_t::step_passagiere_params_t::step_passagiere_params_t(settings_t const& s, const sint16 private_car_percent) :
+	local_passengers_min_distance( s.get_local_passengers_min_distance() ),
+	local_passengers_max_distance( s.get_local_passengers_max_distance() ),
+	midrange_passengers_min_distance( s.get_midrange_passengers_min_distance() ),
+	midrange_passengers_max_distance( s.get_midrange_passengers_max_distance() ),
+	longdistance_passengers_min_distance( s.get_longdistance_passengers_min_distance() ),
+	longdistance_passengers_max_distance( s.get_longdistance_passengers_max_distance() ),
+	min_local_tolerance( s.get_min_local_tolerance() ),
+	max_local_tolerance( max(0, s.get_max_local_tolerance() - s.get_min_local_tolerance()) ),
+	min_midrange_tolerance( s.get_min_midrange_tolerance() ),
+	max_midrange_tolerance( max(0, s.get_max_midrange_tolerance() - s.get_min_midrange_tolerance()) ),
+	min_longdistance_tolerance( s.get_min_longdistance_tolerance() ),
+	max_longdistance_tolerance( max(0, s.get_max_longdistance_tolerance() - s.get_min_longdistance_tolerance()) ),
+	passenger_packet_size( s.get_passenger_routing_packet_size() ),
+	passenger_routing_local_chance( s.get_passenger_routing_local_chance() ),
+	passenger_routing_midrange_chance( s.get_passenger_routing_midrange_chance() ),
+	always_prefer_car_percent( s.get_always_prefer_car_percent() ),
+	base_car_preference_percent( s.get_base_car_preference_percent() ),
+	max_destinations( (s.get_max_alternative_destinations() < 16 ? s.get_max_alternative_destinations() : 15) + 1 ),
+	max_walking_distance( s.get_max_walking_distance() ),
+	random_pedestrians( s.get_random_pedestrians() ),
+	private_car_percent( private_car_percent )
+{
+}
+
+
+// the settings and the car ownership are looked up once for the whole batch
+void stadt_t::step_passagiere_batch(const uint32 count)
+{
+	profile_scope_t profile( profile_t::step_passagiere );
+	const step_passagiere_params_t params( welt->get_settings(), get_private_car_ownership( welt->get_timeline_year_month() ) );
+	for(  uint32 i=0;  i<count;  i++  ) {
+		step_passagiere( params );
+		step_count++;
+	}
+}
+
+
 /* this creates passengers and mail for everything is is therefore one of the CPU hogs of the machine
  * think trice, before applying optimisation here ...
  */
-void stadt_t::step_passagiere()
+void stadt_t::step_passagiere(const step_passagiere_params_t &p)
 {
-	settings_t const& s = welt->get_settings();
-
-	//@author: jamespetts
-	// Passenger routing and generation metrics.	
-	const uint32 local_passengers_min_distance = s.get_local_passengers_min_distance();
-	const uint32 local_passengers_max_distance = s.get_local_passengers_max_distance();
-	const uint32 midrange_passengers_min_distance = s.get_midrange_passengers_min_distance();
-	const uint32 midrange_passengers_max_distance = s.get_midrange_passengers_max_distance();
-	const uint32 longdistance_passengers_min_distance = s.get_longdistance_passengers_min_distance();
-	const uint32 longdistance_passengers_max_distance = s.get_longdistance_passengers_max_distance();
-
-	const uint16 min_local_tolerance = s.get_min_local_tolerance();
-	const uint16 max_local_tolerance = max(0, s.get_max_local_tolerance() - min_local_tolerance);
-	const uint16 min_midrange_tolerance = s.get_min_midrange_tolerance();
-	const uint16 max_midrange_tolerance = max( 0, s.get_max_midrange_tolerance() - min_midrange_tolerance);
-	const uint16 min_longdistance_tolerance = s.get_min_longdistance_tolerance();
-	const uint16 max_longdistance_tolerance = max(0, s.get_max_longdistance_tolerance() - min_longdistance_tolerance);
-
-	const uint8 passenger_packet_size = s.get_passenger_routing_packet_size();
-	const uint8 passenger_routing_local_chance = s.get_passenger_routing_local_chance();
-	const uint8 passenger_routing_midrange_chance = s.get_passenger_routing_midrange_chance();
-	const uint8 always_prefer_car_percent = s.get_always_prefer_car_percent();
-
 	//	DBG_MESSAGE("stadt_t::step_passagiere()", "%s step_passagiere called (%d,%d - %d,%d)\n", name, li, ob, re, un);
 	//	long t0 = get_current_time_millis();
 
@@ -3078,11 +3430,12 @@ void stadt_t::step_passagiere()
 
 	
 	// Hajo: track number of generated passengers.
+	profile_t::count( profile_t::pax_mail_generated, num_pax );
 	city_history_year[0][history_type+1] += num_pax;
 	city_history_month[0][history_type+1] += num_pax;
 			
 	// create pedestrians in the near area?
-	if (s.get_random_pedestrians() && wtyp == warenbauer_t::passagiere) {
+	if (p.random_pedestrians && wtyp == warenbauer_t::passagiere) {
 		haltestelle_t::erzeuge_fussgaenger(welt, gb->get_pos(), num_pax);
 	}
 
@@ -3091,7 +3444,8 @@ void stadt_t::step_passagiere()
 	const planquadrat_t *const plan = welt->lookup(origin_pos);
 	const halthandle_t *const halt_list = plan->get_haltlist();
 
-	minivec_tpl<halthandle_t> start_halts(plan->get_haltlist_count());
+	minivec_tpl<halthandle_t> &start_halts = start_halt_buffer;
+	start_halts.clear();
 	for (int h = plan->get_haltlist_count() - 1; h >= 0; h--) 
 	{
 		halthandle_t halt = halt_list[h];
@@ -3105,9 +3459,8 @@ void stadt_t::step_passagiere()
 
 	// Check whether this batch of passengers has access to a private car each.
 	// Check run in batches to save computational effort.
-	const sint16 private_car_percent = wtyp == warenbauer_t::passagiere ? get_private_car_ownership(welt->get_timeline_year_month()) : 0; 
 	// Only passengers have private cars
-	const bool has_private_car = private_car_percent > 0 ? simrand(100, "void stadt_t::step_passagiere() (has private car?)") <= (uint16)private_car_percent : false;
+	const bool has_private_car = wtyp == warenbauer_t::passagiere && p.private_car_percent > 0 ? simrand(100, "void stadt_t::step_passagiere() (has private car?)") <= (uint16)p.private_car_percent : false;
 	
 	// Record the most useful set of information about why passengers cannot reach their chosen destination:
 	//  Too slow > overcrowded > no route. Tiebreaker: higher destination preference.
@@ -3125,8 +3478,8 @@ void stadt_t::step_passagiere()
 		// regardless of whether they might go to other destinations by public transport.
 
 		// Now that private cars also have a journey time tolerance and check whether the roads are connected, passengers *might*
-		// not be able to get to their destination by private car either, so the above is redundant. 
-		const uint8 max_destinations = (s.get_max_alternative_destinations() < 16 ? s.get_max_alternative_destinations() : 15) + 1;
+		// not be able to get to their destination by private car either, so the above is redundant
+		// (see step_passagiere_params_t::max_destinations).
 
 		// Find passenger destination
 		for(  int pax_routed=0, pax_left_to_do=0;  pax_routed<num_pax;  pax_routed+=pax_left_to_do  ) 
@@ -3139,30 +3492,30 @@ void stadt_t::step_passagiere()
 			* Number now not fixed at 7, but set in simuconf.tab (@author: jamespetts)
 			*/
 
-			pax_left_to_do = min(passenger_packet_size, num_pax - pax_routed);
+			pax_left_to_do = min(p.passenger_packet_size, num_pax - pax_routed);
 
 			// search target for the passenger
 			pax_return_type will_return;
 
-			const uint8 destination_count = simrand(max_destinations, "void stadt_t::step_passagiere() (number of destinations?)") + 1;
+			const uint8 destination_count = simrand(p.max_destinations, "void stadt_t::step_passagiere() (number of destinations?)") + 1;
 
 			// Split passengers: between local, midrange and long-distance
 			// according to the percentages set in simuconf.tab.
 			// Note: a random town will be found if there are no towns within range.
 			const uint8 passenger_routing_choice = simrand(100, "void stadt_t::step_passagiere() (passenger routing choice?)");
 			const journey_distance_type range = 
-				passenger_routing_choice <= passenger_routing_local_chance ? 
+				passenger_routing_choice <= p.passenger_routing_local_chance ? 
 				local :
-			passenger_routing_choice <= (passenger_routing_local_chance + passenger_routing_midrange_chance) ? 
+			passenger_routing_choice <= (p.passenger_routing_local_chance + p.passenger_routing_midrange_chance) ? 
 				midrange : longdistance;
 			const uint16 tolerance = 
 				wtyp != warenbauer_t::passagiere ? 
 				0 : 
 				range == local ? 
-					simrand(max_local_tolerance, "void stadt_t::step_passagiere() (local tolerance?)") + min_local_tolerance : 
+					simrand(p.max_local_tolerance, "void stadt_t::step_passagiere() (local tolerance?)") + p.min_local_tolerance : 
 				range == midrange ? 
-					simrand(max_midrange_tolerance, "void stadt_t::step_passagiere() (midrange tolerance?)") + min_midrange_tolerance : 
-				simrand(max_longdistance_tolerance, "void stadt_t::step_passagiere() (longdistance tolerance?)") + min_longdistance_tolerance;
+					simrand(p.max_midrange_tolerance, "void stadt_t::step_passagiere() (midrange tolerance?)") + p.min_midrange_tolerance : 
+				simrand(p.max_longdistance_tolerance, "void stadt_t::step_passagiere() (longdistance tolerance?)") + p.min_longdistance_tolerance;
 			destination destinations[16];
 			for(int destinations_assigned = 0; destinations_assigned <= destination_count; destinations_assigned ++)
 			{				
@@ -3172,23 +3525,23 @@ void stadt_t::step_passagiere()
 					if(passenger_routing_choice <= adjusted_passenger_routing_local_chance)
 					{
 						// Will always be a destination in the current town.
-						destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, 0, local_passengers_max_distance, origin_pos);	
+						destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, 0, p.local_passengers_max_distance, origin_pos);	
 					}
 					else
 					{
-						destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, local_passengers_min_distance, local_passengers_max_distance, origin_pos);
+						destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, p.local_passengers_min_distance, p.local_passengers_max_distance, origin_pos);
 					}
 				}
 				else if(range == midrange)
 				{
 					//Medium
-					destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, midrange_passengers_min_distance, midrange_passengers_max_distance, origin_pos);
+					destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, p.midrange_passengers_min_distance, p.midrange_passengers_max_distance, origin_pos);
 				}
 				else
 				//else if(range == longdistance)
 				{
 					//Long distance
-					destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, longdistance_passengers_min_distance, longdistance_passengers_max_distance, origin_pos); 
+					destinations[destinations_assigned] = find_destination(target_factories, city_history_month[0][history_type+1], &will_return, p.longdistance_passengers_min_distance, p.longdistance_passengers_max_distance, origin_pos); 
 				}
 			}
 			
@@ -3198,7 +3551,6 @@ void stadt_t::step_passagiere()
 
 			route_status route_good = no_route;
 			
-			const uint16 max_walking_distance = s.get_max_walking_distance();
 			uint16 car_minutes = 65535;
 
 			best_bad_destination = destinations[0].location;
@@ -3212,13 +3564,14 @@ void stadt_t::step_passagiere()
 				const halthandle_t* dest_list = dest_plan->get_haltlist();
 
 				// Knightly : we can avoid duplicated efforts by building destination halt list here at the same time
-				minivec_tpl<halthandle_t> destination_list(dest_plan->get_haltlist_count());
+				minivec_tpl<halthandle_t> &destination_list = destination_halt_buffer;
+				destination_list.clear();
 				
 				halthandle_t start_halt;
 				
 				// Check whether the destination is within walking distance first.
 				// @author: jamespetts, December 2009
-				if(shortest_distance(destinations[current_destination].location, origin_pos) <= max_walking_distance)
+				if(shortest_distance(destinations[current_destination].location, origin_pos) <= p.max_walking_distance)
 				{
 					// Passengers will always walk if they are close enough.
 					route_good = can_walk;
@@ -3267,7 +3620,7 @@ void stadt_t::step_passagiere()
 					//start_halt->add_pax_happy(pax_left_to_do);
 
 					merke_passagier_ziel(destinations[current_destination].location, COL_DARK_YELLOW);
-					if (s.get_random_pedestrians() && wtyp == warenbauer_t::passagiere) 
+					if (p.random_pedestrians && wtyp == warenbauer_t::passagiere) 
 					{
 						if(!start_halts.empty() && !start_halt.is_bound())
 						{
@@ -3394,14 +3747,14 @@ void stadt_t::step_passagiere()
 						
 						//Weighted random.
 						const uint16 private_car_chance = (uint16)simrand(100, "void stadt_t::step_passagiere() (private car chance?)");
-						if(private_car_chance <= always_prefer_car_percent)
+						if(private_car_chance <= p.always_prefer_car_percent)
 						{
 							route_good = private_car_only;
 						}
 						else
 						{
 							// The basic preference for using a private car if available.
-							uint16 car_preference = s.get_base_car_preference_percent();
+							uint16 car_preference = p.base_car_preference_percent;
 										
 							// Firstly, congestion. Drivers will turn to public transport if the origin or destination towns are congested.
 
@@ -3665,7 +4018,7 @@ void stadt_t::step_passagiere()
 		//const koord ziel = finde_passagier_ziel(&will_return);
 		destination destination_now;
 		destination_now = find_destination(target_factories, city_history_month[0][history_type+1], &will_return);
-		sint32 amount = min(passenger_packet_size, num_pax);
+		sint32 amount = min(p.passenger_packet_size, num_pax);
 		if(destination_now.factory_entry)
 		{
 			register_factory_passenger_generation(&amount, wtyp, target_factories, destination_now.factory_entry);
@@ -3675,7 +4028,7 @@ void stadt_t::step_passagiere()
 		// they do not have a start halt does not mean that they cannot
 		// walk to their destination!
 		const uint32 tile_distance = shortest_distance(origin_pos, destination_now.location);
-		if(tile_distance <= s.get_max_walking_distance())
+		if(tile_distance <= p.max_walking_distance)
 		{
 			// Passengers will walk to their destination if it is within the specified range.
 			// (Default: 1.5km)
@@ -3835,9 +4188,11 @@ void stadt_t::recalc_target_cities()
 void stadt_t::add_target_attraction(gebaeude_t *const attraction)
 {
 	assert( attraction != NULL );
-	target_attractions.append(
-		attraction,
-		weight_by_distance( attraction->get_passagier_level() << 4, shortest_distance( this->get_pos(), attraction->get_pos().get_2d() ) ),
+	const uint32 distance = shortest_distance( this->get_pos(), attraction->get_pos().get_2d() );
+	target_attractions.insert_ordered(
+		target_attraction_t( attraction, distance ),
+		weight_by_distance( attraction->get_passagier_level() << 4, distance ),
+		target_attraction_t::less_than,
 		64u
 	);
 }
@@ -3851,6 +4206,50 @@ void stadt_t::recalc_target_attractions()
 	}
 }
 
+/**
+ * Weighted random pick among the entries of a target list (ordered by the
+ * distance from this town) with min_distance <= distance <= max_distance.
+ * These entries form one block, which is found by binary search; a random
+ * weight within the block then selects the entry without any retries.
+ * The whole list is used if no entry is in range; it must not be empty.
+ */
+template<class T> static T const& pick_in_distance_range(weighted_vector_tpl<T> const& list, const uint32 min_distance, const uint32 max_distance)
+{
+	const uint32 count = list.get_count();
+	uint32 low = 0;
+	uint32 high = count;
+	while(  low < high  ) {
+		const uint32 mid = (low + high) >> 1;
+		if(  list[mid].distance < min_distance  ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	const uint32 first = low;
+	high = count;
+	while(  low < high  ) {
+		const uint32 mid = (low + high) >> 1;
+		if(  list[mid].distance <= max_distance  ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	const uint32 end = low;
+
+	if(  first >= end  ) {
+		return pick_any_weighted(list);
+	}
+	// weight_at() is the sum of the weights before the position
+	const unsigned long first_weight = list.weight_at(first);
+	const unsigned long end_weight = end < count ? list.weight_at(end) : list.get_sum_weight();
+	return list.at_weight( first_weight + simrand( end_weight - first_weight, "pick_in_distance_range()" ) );
+}
+
+
 /* this function generates a random target for passenger/mail
  * changing this strongly affects selection of targets and thus game strategy
  */
@@ -3865,6 +4264,14 @@ stadt_t::destination stadt_t::find_destination(factory_set_t &target_factories,
 		origin = this->get_pos();
 	}
 
+	// The target lists are ordered by the distance from the centre of this town. As the passengers
+	// start anywhere in this town, the range is widened by the extent of the town.
+	const uint16 max_x = max((origin.x - ur.x), (origin.x - lo.x));
+	const uint16 max_y = max((origin.y - ur.y), (origin.y - lo.y));
+	const uint16 max_internal_distance = max(max_x, max_y);
+	const uint32 near_distance = min_distance > max_internal_distance ? min_distance - max_internal_distance : 0;
+	const uint32 far_distance = max_distance + max_internal_distance;
+
 	// Note: unlike in Standard, this must remain random in Experimental, as passengers will only travel to industries within range, and will have multiple
 	// destinations to which they will travel if they cannot get to the factories.
 	if(rand < welt->get_settings().get_factory_worker_percentage() && target_factories.total_remaining > 0 && (sint64)target_factories.generation_ratio > ((sint64)(target_factories.total_generated*100) << RATIO_BITS) / (generated + 1))
@@ -3891,16 +4298,11 @@ stadt_t::destination stadt_t::find_destination(factory_set_t &target_factories,
 		return current_destination;
 	} 
 	
-	else if(rand <welt->get_settings().get_tourist_percentage() + welt->get_settings().get_factory_worker_percentage() && welt->get_ausflugsziele().get_sum_weight() > 0 ) 
+	else if(rand <welt->get_settings().get_tourist_percentage() + welt->get_settings().get_factory_worker_percentage() && welt->get_ausflugsziele().get_sum_weight() > 0 && !target_attractions.empty() ) 
 	{ 		
 		*will_return = tourist_return;	// tourists will return
-		const gebaeude_t* gb = pick_any_weighted(target_attractions);
+		const gebaeude_t* gb = pick_in_distance_range(target_attractions, near_distance, far_distance).attraction;
 		current_destination.type = TOURIST_PAX;
-		uint8 counter = 0;
-		while(counter ++ < 32 && (shortest_distance(origin, gb->get_pos().get_2d()) > max_distance || shortest_distance(origin, gb->get_pos().get_2d()) < min_distance))
-		{
-			gb =  pick_any_weighted(target_attractions);
-		}
 		current_destination.location = gb->get_pos().get_2d();
 		current_destination.object.attraction = gb;
 		return current_destination;
@@ -3910,65 +4312,17 @@ stadt_t::destination stadt_t::find_destination(factory_set_t &target_factories,
 	{
 		stadt_t* zielstadt;
 
-		if(max_distance == 0)
+		if(max_distance == 0 || target_cities.empty())
 		{
 			// A proportion of local passengers will always travel *within* the town.
 			// This enables the town finding routine to be skipped.
+			// (Also if the target cities have not been set up yet.)
 			zielstadt = this;
 		}
 
 		else
 		{
-			const uint32 weight = welt->get_town_list_weight();
-			const uint32 number_of_towns = welt->get_staedte().get_count();
-			uint32 town_step = weight / number_of_towns;
-			uint32 random = simrand(weight, "stadt_t::destination stadt_t::finde_passagier_ziel (town)");
-			uint32 distance = 0;
-			const uint16 max_x = max((origin.x - ur.x), (origin.x - lo.x));
-			const uint16 max_y = max((origin.y - ur.y), (origin.y - lo.y));
-			const uint16 max_internal_distance = max(max_x, max_y);
-			const uint8 max_count = 96;
-			for(uint8 i = 0; i < max_count; i ++)
-			{
-				zielstadt = welt->get_town_at(random);
-				// Add max_internal_distnace here, as the destination building might be *closer* than the town hall.
-				
-				if(zielstadt == this)
-				{
-					distance = shortest_distance(origin, zielstadt->get_pos()) + max_internal_distance; 
-				}
-				else
-				{
-					distance = shortest_distance(origin, zielstadt->get_pos()) + max(max_internal_distance, zielstadt->get_max_dimension());
-				}
-				
-				if(distance <= max_distance && distance >= min_distance)
-				{
-					break;
-				}
-
-				random += town_step;
-				if(random > weight)
-				{
-					random = 0;
-				}
-				/*if(i == 16 || i == 32 || i == 64)
-				{
-					// Necessary to modulate the destinations to avoid repeatedly hitting the same towns.
-					town_step -= 128;
-				}*/
-
-				/*if(i == 8 || i == 24 || i == 48)
-				{
-					town_step += 64;
-				}*/
-
-				// This is almost never hit, even on very big maps. It is therefore an unnecessary check.
-				/*if(i == max_count && distance > max_distance && min_distance < max_internal_distance)
-				{
-					zielstadt = this;
-				}*/
-			}
+			zielstadt = pick_in_distance_range(target_cities, near_distance, far_distance).city;
 		}
 
 		// long distance traveller? => then we return
@@ -4981,6 +5335,7 @@ void stadt_t::baue(bool new_town)
 
 		// checks only make sense on empty ground
 		if(gr->ist_natur()) {
+			rule_cells.reset(k, k);
 
 			// since only a single location is checked, we can stop after we have found a positive rule
 			best_strasse.reset(k);
@@ -5058,6 +5413,7 @@ void stadt_t::baue(bool new_town)
 		}
 
 		// loop until all candidates are exhausted or until we find a suitable location to build road or city building
+		rule_cells.reset(lo, ur);
 		while(  candidates.get_count()>0  ) {
 			const uint32 idx = simrand( candidates.get_count(), "void stadt_t::baue" );
 			const koord k = candidates[idx];
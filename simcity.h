@@ -26,6 +26,7 @@
 class karte_t;
 class spieler_t;
 class fabrik_t;
+class settings_t;
 
 class rule_t;
 
@@ -399,11 +400,48 @@ private:
 
 	enum pax_return_type { no_return, factory_return, tourist_return, city_return };
 
+	/**
+	 * Settings used by step_passagiere(), read once for all buildings
+	 * handled in one step instead of for every building.
+	 */
+	struct step_passagiere_params_t
+	{
+		uint32 local_passengers_min_distance;
+		uint32 local_passengers_max_distance;
+		uint32 midrange_passengers_min_distance;
+		uint32 midrange_passengers_max_distance;
+		uint32 longdistance_passengers_min_distance;
+		uint32 longdistance_passengers_max_distance;
+
+		// the max_ tolerances are the random range above the min_ ones
+		uint16 min_local_tolerance;
+		uint16 max_local_tolerance;
+		uint16 min_midrange_tolerance;
+		uint16 max_midrange_tolerance;
+		uint16 min_longdistance_tolerance;
+		uint16 max_longdistance_tolerance;
+
+		uint8 passenger_packet_size;
+		uint8 passenger_routing_local_chance;
+		uint8 passenger_routing_midrange_chance;
+		uint8 always_prefer_car_percent;
+		uint8 base_car_preference_percent;
+		// including the first choice, at most 16
+		uint8 max_destinations;
+		uint16 max_walking_distance;
+		bool random_pedestrians;
+
+		sint16 private_car_percent;
+
+		step_passagiere_params_t(settings_t const& s, const sint16 private_car_percent);
+	};
+
 	/**
 	 * verteilt die Passagiere auf die Haltestellen
+	 * (of the building at step_count)
 	 * @author Hj. Malthaner
 	 */
-	void step_passagiere();
+	void step_passagiere(const step_passagiere_params_t &p);
 
 	/**
 	 * ein Passagierziel in die Zielkarte eintragen
@@ -493,6 +531,21 @@ private:
 	uint16 check_road_connexion_to(const gebaeude_t* attraction);
 	uint16 check_road_connexion(koord3d destination);
 
+	/**
+	 * Fills the connexion maps for all other cities, industries outside
+	 * cities and attractions with a single search along the roads from the
+	 * townhall road. Destinations which could not be reached within the
+	 * route step limit are left to check_road_connexion_to().
+	 */
+	void calc_road_connexions();
+
+	// journey time per tile of straight line distance for a road journey, see check_road_connexion()
+	static uint16 calc_journey_time_per_tile(const karte_t *welt, sint32 speed_sum, uint32 count, uint32 tiles, koord origin, koord dest);
+
+	// the first road next to pos (or any tile of industry), or NULL
+	static weg_t* find_road_near(karte_t *welt, koord pos);
+	static weg_t* find_road_near(karte_t *welt, const fabrik_t* industry);
+
 	// Adds a connexion back from a city when a route has been calculated.
 	void add_road_connexion(uint16 journey_time_per_tile, stadt_t* origin_city);
 	void set_no_connexion_to_industry(const fabrik_t* unconnected_industry);
@@ -647,6 +700,12 @@ public:
 
 	void step(long delta_t);
 
+	/**
+	 * generates the passengers and mail of the next count buildings, like
+	 * step() does for the buildings due (public for the -paxtimes benchmark)
+	 */
+	void step_passagiere_batch(const uint32 count);
+
 	void neuer_monat(bool check);
 
 	//@author: jamespetts
@@ -699,10 +758,27 @@ private:
 	weighted_vector_tpl<target_city_t> target_cities;
 
 	/**
-	 * List of target attractions weighted by both passenger level and distance
+	 * Record of a target attraction
+	 */
+	struct target_attraction_t
+	{
+		gebaeude_t *attraction;
+		uint32 distance;
+
+		target_attraction_t() : attraction(NULL), distance(0) { }
+		target_attraction_t(gebaeude_t *const _attraction, const uint32 _distance) : attraction(_attraction), distance(_distance) { }
+
+		bool operator == (const target_attraction_t &other) const { return attraction == other.attraction; }
+
+		static bool less_than(const target_attraction_t &a, const target_attraction_t &b) { return a.distance < b.distance; }
+	};
+
+	/**
+	 * List of target attractions weighted by both passenger level and distance,
+	 * ordered by distance like the target cities
 	 * @author Knightly
 	 */
-	weighted_vector_tpl<gebaeude_t *> target_attractions;
+	weighted_vector_tpl<target_attraction_t> target_attractions;
 
 public:
 
@@ -721,7 +797,7 @@ public:
 	 * @author Knightly
 	 */
 	void add_target_attraction(gebaeude_t *const attraction);
-	void remove_target_attraction(gebaeude_t *const attraction) { target_attractions.remove(attraction); }
+	void remove_target_attraction(gebaeude_t *const attraction) { target_attractions.remove( target_attraction_t(attraction, 0) ); }
 	void recalc_target_attractions();
 
 	/**
@@ -158,6 +158,8 @@ void convoi_t::init(karte_t *wl, spieler_t *sp)
 	departures = new inthashtable_tpl<uint16, departure_data_t>;
 
 	reset();
+	has_requested_route = false;
+	requested_route_found = false;
 	is_electric = false;
 	sum_gesamtgewicht = sum_gewicht = sum_gear_und_leistung = sum_leistung = 0;
 	previous_delta_v = 0;
@@ -780,6 +782,29 @@ bool convoi_t::calc_route(koord3d start, koord3d ziel, sint32 max_speed)
 	return fahr[0]->calc_route(start, ziel, max_speed, &route);
 }
 
+bool convoi_t::request_route(route_batch_t &batch)
+{
+	clear_requested_route();
+	// only the plain case of ROUTING_1 in step(), which goes directly to drive_to()
+	if(  wait_lock!=0  ||  state!=ROUTING_1  ||  line_update_pending.is_bound()  ||  anz_vehikel==0  ||  fpl==NULL  ||  fpl->empty()  ||  !fahr[0]->can_route_in_parallel()  ) {
+		return false;
+	}
+	const koord3d start = fahr[0]->get_pos();
+	const koord3d ziel = fpl->get_current_eintrag().pos;
+	if(  start==ziel  ) {
+		// schedule must advance first
+		return false;
+	}
+	// reservations stay until the route is picked up in drive_to()
+	batch.add( &requested_route, start, ziel, fahr[0], speed_to_kmh(min_top_speed), fahr[0]->get_route_weight(), fahr[0]->get_route_tile_length(), 0xFFFFFFFF, true );
+	requested_route_start = start;
+	requested_route_ziel = ziel;
+	requested_route_found = false;
+	has_requested_route = true;
+	return true;
+}
+
+
 void convoi_t::update_route(uint32 index, const route_t &replacement)
 {
 	// replace route with replacement starting at index.
@@ -1159,7 +1184,21 @@ bool convoi_t::drive_to()
 			}
 		}
 
-		if(  !calc_route( start, ziel, speed_to_kmh(min_top_speed))  ) {
+		bool route_found;
+		if(  has_requested_route  &&  start==requested_route_start  &&  ziel==requested_route_ziel  ) {
+			// already searched by karte_t::step(); release our reservations
+			// now, in the same order as calc_route() would
+			fahr[0]->prepare_route_search();
+			route_infos.clear();
+			route = requested_route;
+			route_found = requested_route_found;
+		}
+		else {
+			route_found = calc_route( start, ziel, speed_to_kmh(min_top_speed));
+		}
+		clear_requested_route();
+
+		if(  !route_found  ) {
 			if(  state != NO_ROUTE  ) {
 				state = NO_ROUTE;
 				get_besitzer()->bescheid_vehikel_problem( self, ziel );
@@ -199,6 +199,15 @@ private:
 	*/
 	route_t route;
 
+	/**
+	* Route searched in advance by karte_t::step() for the next drive_to(),
+	* if the convoi still goes from requested_route_start to requested_route_ziel
+	*/
+	route_t requested_route;
+	koord3d requested_route_start, requested_route_ziel;
+	bool has_requested_route;
+	bool requested_route_found;
+
 	/**
 	* assigned line
 	* @author hsiegeln
@@ -705,6 +714,16 @@ public:
 	bool calc_route(koord3d start, koord3d ziel, sint32 max_speed);
 	void update_route(uint32 index, const route_t &replacement); // replace route with replacement starting at index.
 
+	/**
+	* If the next step() will search a new route, does the part of the route
+	* calculation which changes the world and adds the search to the batch.
+	* The result must be passed to set_requested_route_found() before step().
+	* @return true if a search was added
+	*/
+	bool request_route(route_batch_t &batch);
+	void set_requested_route_found(bool found) { requested_route_found = found; }
+	void clear_requested_route() { has_requested_route = false; requested_route.clear(); }
+
 	/**
 	* get line
 	* @author hsiegeln
@@ -48,6 +48,7 @@
 
 #include "dataobj/einstellungen.h"
 #include "dataobj/fahrplan.h"
+#include "dataobj/freight_index.h"
 #include "dataobj/loadsave.h"
 #include "dataobj/translator.h"
 #include "dataobj/umgebung.h"
@@ -322,6 +323,7 @@ haltestelle_t::haltestelle_t(karte_t* wl, loadsave_t* file)
 	const uint8 max_categories = warenbauer_t::get_max_catg_index();
 
 	waren = (vector_tpl<ware_t> **)calloc( max_categories, sizeof(vector_tpl<ware_t> *) );
+	freight_index = (freight_index_t **)calloc( max_categories, sizeof(freight_index_t *) );
 	non_identical_schedules = new uint8[ max_categories ];
 
 	for ( uint8 i = 0; i < max_categories; i++ ) {
@@ -377,6 +379,7 @@ haltestelle_t::haltestelle_t(karte_t* wl, koord k, spieler_t* sp)
 	const uint8 max_categories = warenbauer_t::get_max_catg_index();
 
 	waren = (vector_tpl<ware_t> **)calloc( max_categories, sizeof(vector_tpl<ware_t> *) );
+	freight_index = (freight_index_t **)calloc( max_categories, sizeof(freight_index_t *) );
 	non_identical_schedules = new uint8[ max_categories ];
 
 	for ( uint8 i = 0; i < max_categories; i++ ) {
@@ -511,8 +514,10 @@ haltestelle_t::~haltestelle_t()
 			delete waren[i];
 			waren[i] = NULL;
 		}
+		delete freight_index[i];
 	}
 	free( waren );
+	free( freight_index );
 	
 	for(uint8 i = 0; i < max_categories; i++)
 	{
@@ -558,6 +563,7 @@ void haltestelle_t::rotate90( const sint16 y_size )
 					(*warray).remove_at( j );
 				}
 			}
+			update_freight_index( i );
 		}
 	}
 
@@ -1051,6 +1057,10 @@ void haltestelle_t::step()
 						
 						// The goods/passengers leave.
 						tmp.menge = 0;
+						if(  freight_index[j]  )
+						{
+							freight_index[j]->set_empty( i );
+						}
 					}		
 				}
 			}
@@ -1193,6 +1203,7 @@ uint32 haltestelle_t::reroute_goods(const uint8 catg)
 		// replace the array
 		delete waren[catg];
 		waren[catg] = new_warray;
+		update_freight_index( catg );
 
 		// likely the display must be updated after this
 		resort_freight_info = true;
@@ -1308,15 +1319,25 @@ void haltestelle_t::reset_connexions(uint8 category)
 // @jamespetts: modified the code to combine with previous method and provide options about partially delayed refreshes for performance.
 void haltestelle_t::refresh_routing(const schedule_t *const sched, const minivec_tpl<uint8> &categories, const spieler_t *const player)
 {
-	halthandle_t tmp_halt;
-
 	if(sched && player)
 	{
 		const uint8 catg_count = categories.get_count();
 
+		// the journey times between these halts may have changed even if their connexions have not
+		vector_tpl<uint16> schedule_halts(sched->get_count());
+		for (uint8 i = 0; i < sched->get_count(); i++)
+		{
+			const halthandle_t tmp_halt = haltestelle_t::get_halt(path_explorer_t::get_world(), sched->eintrag[i].pos, player);
+			if(tmp_halt.is_bound())
+			{
+				schedule_halts.append_unique(tmp_halt.get_id());
+			}
+		}
+
+		// a schedule change leaves the paths of unconnected parts of the network intact
 		for (uint8 i = 0; i < catg_count; i++)
 		{
-			path_explorer_t::refresh_category(categories[i]);
+			path_explorer_t::refresh_category_partially(categories[i], schedule_halts);
 		}
 	}
 	else
@@ -1472,7 +1493,8 @@ void haltestelle_t::liefere_an_fabrik(const ware_t& ware) const //"deliver to th
 bool haltestelle_t::recall_ware( ware_t& w, uint32 menge )
 {
 	w.menge = 0;
-	vector_tpl<ware_t> *warray = waren[w.get_besch()->get_catg_index()];
+	const uint8 catg = w.get_besch()->get_catg_index();
+	vector_tpl<ware_t> *warray = waren[catg];
 	if(warray!=NULL) {
 		FOR(vector_tpl<ware_t>, & tmp, *warray) {
 			// skip empty entries
@@ -1490,6 +1512,9 @@ bool haltestelle_t::recall_ware( ware_t& w, uint32 menge )
 				// leave an empty entry => joining will more often work
 				w.menge = tmp.menge;
 				tmp.menge = 0;
+				if(  freight_index[catg]  ) {
+					freight_index[catg]->set_empty( &tmp - warray->begin() );
+				}
 			}
 			book(w.menge, HALT_ARRIVED);
 			resort_freight_info = true;
@@ -1509,6 +1534,7 @@ ware_t haltestelle_t::hole_ab(const ware_besch_t *wtyp, uint32 maxi, const sched
 	// this allows for separate high speed and normal service
 	const uint8 count = fpl->get_count();
 	vector_tpl<ware_t> *warray = waren[wtyp->get_catg_index()];
+	freight_index_t *const goods_index = freight_index[wtyp->get_catg_index()];
 
 	if(warray != NULL) 
 	{
@@ -1574,17 +1600,30 @@ ware_t haltestelle_t::hole_ab(const ware_besch_t *wtyp, uint32 maxi, const sched
 				halthandle_t next_transfer;
 				uint8 catg_index;
 
-				for(uint16 i = 0;  i < warray->get_count();  i++) 
+				// With an index, only the packets to plan_halt are visited, starting at the
+				// first one behind the random offset; this finds the same packet as scanning
+				// the whole array from the offset.
+				const vector_tpl<uint32> *entries = NULL;
+				uint32 candidates = warray->get_count();
+				uint32 start = offset;
+				if(goods_index)
 				{
-					ware_t &tmp = (*warray)[ i+offset ];
-					next_transfer = tmp.get_zwischenziel();
-					catg_index = tmp.get_besch()->get_catg_index();
+					entries = goods_index->get_transfer_entries(plan_halt);
+					candidates = entries ? entries->get_count() : 0;
+					start = entries ? std::lower_bound(entries->begin(), entries->end(), (uint32)offset) - entries->begin() : 0;
+				}
 
-					// prevent overflow (faster than division)
-					if(i + offset + 1 >= warray->get_count()) 
+				for(uint32 i = 0;  i < candidates;  i++) 
+				{
+					uint32 n = start + i;
+					if(n >= candidates)
 					{
-						offset -= warray->get_count();
+						n -= candidates;
 					}
+					const uint32 pos = entries ? (*entries)[n] : n;
+					ware_t &tmp = (*warray)[pos];
+					next_transfer = tmp.get_zwischenziel();
+					catg_index = tmp.get_besch()->get_catg_index();
 
 					// skip empty entries
 					if(tmp.menge == 0) 
@@ -1740,6 +1779,10 @@ ware_t haltestelle_t::hole_ab(const ware_besch_t *wtyp, uint32 maxi, const sched
 						{
 							// leave an empty entry => joining will more often work
 							tmp.menge = 0;
+							if(goods_index)
+							{
+								goods_index->set_empty(pos);
+							}
 						}
 				
 						book(neu.menge, HALT_DEPARTED);
@@ -1867,11 +1910,23 @@ bool haltestelle_t::vereinige_waren(const ware_t &ware) //"unite were" (Google)
 	// pruefen ob die ware mit bereits wartender ware vereinigt werden kann
 	// "examine whether the ware with software already waiting to be united" (Google)
 
-	vector_tpl<ware_t> * warray = waren[ware.get_besch()->get_catg_index()];
+	const uint8 catg = ware.get_besch()->get_catg_index();
+	vector_tpl<ware_t> * warray = waren[catg];
 	if(warray != NULL) 
 	{
-		FOR(vector_tpl<ware_t>, & tmp, *warray) 
+		// with an index, only packets with the same destination and origin are candidates
+		const vector_tpl<uint32> *entries = NULL;
+		uint32 candidates = warray->get_count();
+		if(freight_index[catg])
+		{
+			entries = freight_index[catg]->get_destination_entries(ware);
+			candidates = entries ? entries->get_count() : 0;
+		}
+
+		for(uint32 i = 0; i < candidates; i++) 
 		{
+			const uint32 pos = entries ? (*entries)[i] : i;
+			ware_t &tmp = (*warray)[pos];
 
 			/*
 			* OLD SYSTEM - did not take account of origins and timings when merging.
@@ -1894,6 +1949,10 @@ bool haltestelle_t::vereinige_waren(const ware_t &ware) //"unite were" (Google)
 				if(  ware.get_zwischenziel().is_bound()  &&  ware.get_zwischenziel()!=self  ) 
 				{
 					// update route if there is newer route
+					if(freight_index[catg])
+					{
+						freight_index[catg]->change_transfer(pos, tmp.get_zwischenziel(), ware.get_zwischenziel());
+					}
 					tmp.set_zwischenziel( ware.get_zwischenziel() );
 				}
 
@@ -1931,15 +1990,31 @@ void haltestelle_t::add_ware_to_halt(ware_t ware, bool from_saved)
 	ware.set_last_transfer(self);
 
 	// now we have to add the ware to the stop
-	vector_tpl<ware_t> * warray = waren[ware.get_besch()->get_catg_index()];
+	const uint8 catg = ware.get_besch()->get_catg_index();
+	vector_tpl<ware_t> * warray = waren[catg];
 	if(warray==NULL) 
 	{
 		// this type was not stored here before ...
 		warray = new vector_tpl<ware_t>(4);
-		waren[ware.get_besch()->get_catg_index()] = warray;
+		waren[catg] = warray;
 	}
 	// the ware will be put into the first entry with menge==0
 	resort_freight_info = true;
+	if(freight_index[catg])
+	{
+		uint32 pos;
+		if(freight_index[catg]->take_empty(*warray, pos))
+		{
+			freight_index[catg]->set_entry(pos, &(*warray)[pos], ware);
+			(*warray)[pos] = ware;
+		}
+		else
+		{
+			freight_index[catg]->set_entry(warray->get_count(), NULL, ware);
+			warray->append(ware);
+		}
+		return;
+	}
 #ifdef DEBUG_SIMRAND_CALLS
 	int n = 0;
 #endif
@@ -1993,6 +2068,21 @@ void haltestelle_t::add_ware_to_halt(ware_t ware, bool from_saved)
 	}
 #endif
 	warray->append(ware);
+	if(warray->get_count() >= freight_index_t::MIN_PACKETS)
+	{
+		update_freight_index(catg);
+	}
+}
+
+
+void haltestelle_t::update_freight_index(uint8 catg)
+{
+	delete freight_index[catg];
+	freight_index[catg] = NULL;
+	if(waren[catg]  &&  waren[catg]->get_count() >= freight_index_t::MIN_PACKETS)
+	{
+		freight_index[catg] = new freight_index_t(*waren[catg]);
+	}
 }
 
 
@@ -2466,6 +2556,7 @@ void haltestelle_t::transfer_goods(halthandle_t halt)
 			}
 			delete waren[i];
 			waren[i] = NULL;
+			update_freight_index(i);
 		}
 	}
 }
@@ -3084,6 +3175,8 @@ void haltestelle_t::laden_abschliessen(bool need_recheck_for_walking_distance)
 					}
 				}
 			}
+			// the handles may have been corrected above
+			update_freight_index(i);
 		}
 	}
 
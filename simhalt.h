@@ -49,6 +49,7 @@
 class cbuffer_t;
 class grund_t;
 class fabrik_t;
+class freight_index_t;
 class karte_t;
 class koord3d;
 class loadsave_t;
@@ -281,6 +282,12 @@ private:
 	// Array with different categries that contains all waiting goods at this stop
 	vector_tpl<ware_t> **waren;
 
+	// Index of the goods in waren per category, only for many waiting packets (else NULL)
+	freight_index_t **freight_index;
+
+	// creates or deletes the index after waren[catg] was changed as a whole
+	void update_freight_index(uint8 catg);
+
 	/**
 	 * Liste der angeschlossenen Fabriken
 	 * @author Hj. Malthaner
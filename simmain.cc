@@ -28,6 +28,7 @@
 #include "simticker.h"
 #include "simmesg.h"
 #include "simwerkz.h"
+#include "path_explorer.h"
 
 #include "simsys.h"
 #include "simgraph.h"
@@ -67,6 +68,8 @@
 #include "sound/sound.h"
 
 #include "utils/cbuffer_t.h"
+#include "utils/worker_pool.h"
+#include "utils/simprofile.h"
 
 #include "bauer/vehikelbauer.h"
 #include "vehicle/simvehikel.h"
@@ -172,9 +175,167 @@ static void show_times(karte_t *welt, karte_ansicht_t *view)
 	}
 	DBG_MESSAGE("test", "welt->sync_step/step(200,1,1): %i iterations took %i ms", i, dr_time() - ms);
 }
+
+
+// a savegame format of show_save_times()
+struct save_times_format_t
+{
+	loadsave_t::mode_t mode;
+	const char *name;
+};
+
+
+// saves and loads the current map in every savegame format
+static void show_save_times(karte_t *welt)
+{
+	static const save_times_format_t formats[] = {
+		{ loadsave_t::binary, "binary" },	// first: its size is the amount of data
+		{ loadsave_t::zipped, "zipped" },
+		{ loadsave_t::bzip2, "bzip2" },
+		{ loadsave_t::zipped_blocks, "zipped_blocks" },
+		{ loadsave_t::xml, "xml" },
+		{ loadsave_t::xml_zipped, "xml_zipped" },
+		{ loadsave_t::xml_bzip2, "xml_bzip2" },
+		{ loadsave_t::xml_zipped_blocks, "xml_zipped_blocks" }
+	};
+	const char *filename = "save/_savetimes.sve";
+	const loadsave_t::mode_t old_mode = loadsave_t::save_mode;
+	const bool old_background_save = umgebung_t::background_save;
+	umgebung_t::background_save = false;
+
+	double data_mb = 0.0;
+	for(  uint i = 0;  i < lengthof(formats);  i++  ) {
+		loadsave_t::set_savemode( formats[i].mode );
+		long ms = dr_time();
+		welt->speichern( filename, umgebung_t::savegame_version_str, umgebung_t::savegame_ex_version_str, true );
+		const long save_ms = max( dr_time() - ms, 1 );
+
+		long file_size = 0;
+		if(  FILE *f = fopen( filename, "rb" )  ) {
+			fseek( f, 0, SEEK_END );
+			file_size = ftell( f );
+			fclose( f );
+		}
+		if(  i == 0  ) {
+			data_mb = file_size / (1024.0 * 1024.0);
+		}
+
+		ms = dr_time();
+		welt->laden( filename );
+		const long load_ms = max( dr_time() - ms, 1 );
+		DBG_MESSAGE( "test", "%s: %.1f MB data, %.1f MB file, saving %li ms (%.1f MB/s), loading %li ms (%.1f MB/s)",
+			formats[i].name, data_mb, file_size / (1024.0 * 1024.0), save_ms, data_mb * 1000.0 / save_ms, load_ms, data_mb * 1000.0 / load_ms );
+	}
+	remove( filename );
+
+	loadsave_t::set_savemode( old_mode );
+	umgebung_t::background_save = old_background_save;
+}
+
+
+// generates the passengers and mail of every building of every city rounds
+// times with a fixed random seed and shows the passengers and mail per ms;
+// the generated passengers stay in the game
+static void show_passenger_times(karte_t *welt, uint32 rounds)
+{
+	setsimrand( 42, 42 );
+	const bool old_enabled = profile_t::enabled;
+	profile_t::reset();
+	profile_t::enabled = true;
+
+	uint32 buildings = 0;
+	const uint64 start_us = profile_t::get_time_us();
+	for(  uint32 r = 0;  r < rounds;  r++  ) {
+		FOR( weighted_vector_tpl<stadt_t*>, const c, welt->get_staedte() ) {
+			c->step_passagiere_batch( c->get_buildings() );
+			buildings += c->get_buildings();
+		}
+	}
+	const uint64 us = max( profile_t::get_time_us() - start_us, (uint64)1 );
+	const uint64 generated = profile_t::counter[profile_t::pax_mail_generated];
+	profile_t::enabled = old_enabled;
+
+	printf( "step_passagiere: %u buildings, %llu passengers and mail in %llu ms (%.1f per ms)\n",
+		buildings, (unsigned long long)generated, (unsigned long long)(us / 1000), generated * 1000.0 / us );
+}
 #endif
 
 
+/**
+ * Runs the current game for some months as fast as possible, without
+ * display and with a fixed random seed, and writes the time spent in the
+ * subsystems and the final state digest to report_name (as key=value lines).
+ * The path explorer uses fixed limits like a network game instead of adapting
+ * them to the time taken, and always explores on the worker threads (without
+ * threads the job runs when its result is due). Thus the same savegame and
+ * version give the same digest for any number of threads and any machine.
+ */
+static void run_benchmark(karte_t *welt, const char *savegame, uint32 months, const char *report_name)
+{
+	const uint32 seed = 42;
+	printf( "Benchmarking %u months ...\n", months );
+
+	// real time must not matter
+	intr_disable();
+	welt->set_fast_forward( true );
+	setsimrand( seed, seed );
+	const path_explorer_t::limit_set_t old_limits = path_explorer_t::get_active_limits();
+	path_explorer_t::set_limits( path_explorer_t::get_default_limits() );
+	path_explorer_t::fix_limits( true );
+
+	profile_t::reset();
+	profile_t::enabled = true;
+	const uint32 start_month = welt->get_current_month();
+	const long start_steps = welt->get_steps();
+	const uint64 start_us = profile_t::get_time_us();
+	while(  welt->get_current_month() < start_month + months  ) {
+		welt->sync_step( 100, true, false );
+		set_random_mode( STEP_RANDOM );
+		welt->step();
+		clear_random_mode( STEP_RANDOM );
+	}
+	const uint64 total_us = profile_t::get_time_us() - start_us;
+	profile_t::enabled = false;
+	welt->set_fast_forward( false );
+	path_explorer_t::fix_limits( false );
+	path_explorer_t::set_limits( old_limits );
+
+	FILE *report = fopen( report_name, "w" );
+	if(  report == NULL  ) {
+		dbg->error( "run_benchmark()", "cannot write report to %s", report_name );
+		return;
+	}
+	fprintf( report, "# Simutrans-Experimental benchmark, times in microseconds\n" );
+	// step_passagiere was timed per building before, so compare count_pax_mail_generated instead
+	fprintf( report, "# calls_step_passagiere counts batches of buildings, one per city step\n" );
+	fprintf( report, "version=" VERSION_NUMBER EXPERIMENTAL_VERSION "\n" );
+	fprintf( report, "savegame=%s\n", savegame );
+	fprintf( report, "threads=%u\n", worker_pool_t::get_thread_count() + 1 );
+	fprintf( report, "seed=%u\n", seed );
+	fprintf( report, "start_month=%u\n", start_month );
+	fprintf( report, "months=%u\n", months );
+	fprintf( report, "steps=%li\n", welt->get_steps() - start_steps );
+	fprintf( report, "time_total=%llu\n", (unsigned long long)total_us );
+	for(  int i = 0;  i < profile_t::SECTION_COUNT;  i++  ) {
+		const char *name = profile_t::get_name( (profile_t::section_t)i );
+		fprintf( report, "time_%s=%llu\n", name, (unsigned long long)profile_t::time_us[i] );
+		fprintf( report, "calls_%s=%u\n", name, profile_t::calls[i] );
+	}
+	for(  int c = 0;  c < profile_t::COUNTER_COUNT;  c++  ) {
+		fprintf( report, "count_%s=%llu\n", profile_t::get_name( (profile_t::counter_t)c ), (unsigned long long)profile_t::counter[c] );
+	}
+	uint32 digest[checklist_t::DIGEST_COUNT];
+	welt->calc_full_state_digest( digest );
+	for(  int i = 0;  i < checklist_t::DIGEST_COUNT;  i++  ) {
+		fprintf( report, "digest_%s=%08x\n", checklist_t::digest_names[i], digest[i] );
+	}
+	fprintf( report, "random_seed=%08x\n", get_random_seed() );
+	fclose( report );
+
+	printf( "%u months took %llu ms, report written to %s\n", months, (unsigned long long)(total_us / 1000), report_name );
+}
+
+
 void modal_dialogue( gui_frame_t *gui, long magic, karte_t *welt, bool (*quit)() )
 {
 	if(  display_get_width()==0  ) {
@@ -416,9 +577,16 @@ int simu_main(int argc, char** argv)
 #ifdef DEBUG
 			" -sizes              Show current size of some structures\n"
 #endif
+			" -benchmark MONTHS [FILE] runs the game MONTHS months without display,\n"
+			"                     then writes times and state to FILE and quits\n"
+			"                     (default benchmark.txt in the user directory)\n"
 			" -startyear N        start in year N\n"
+			" -threads N          use N threads for background work (MULTI_THREAD)\n"
 			" -timeline           enables timeline\n"
 #if defined DEBUG || defined PROFILE
+			" -paxtimes [N]       generates the passengers of every building N times\n"
+			"                     (default 10) and shows the passengers per ms\n"
+			" -savetimes          saves and loads the map in every savegame format\n"
 			" -times              does some simple profiling\n"
 			" -until MONTH        quits when MONTH = (month*12+year-1) starts\n"
 #endif
@@ -806,6 +974,12 @@ int simu_main(int argc, char** argv)
 		}
 	}
 
+	// start the worker threads for background computations
+	if(  const char *ref_str = gimme_arg(argc, argv, "-threads", 1)  ) {
+		umgebung_t::num_threads = clamp( atoi(ref_str), 1, 33 );
+	}
+	worker_pool_t::initialise( umgebung_t::num_threads );
+
 	// now (re)set the correct length from the pak
 	umgebung_t::default_einstellungen.set_pak_diagonal_multiplier( pak_diagonal_multiplier );
 	vehikel_basis_t::set_diagonal_multiplier( pak_diagonal_multiplier, pak_diagonal_multiplier );
@@ -1082,6 +1256,17 @@ DBG_MESSAGE("simmain","loadgame file found at %s",buffer);
 		show_times(welt, view);
 	}
 
+	// benchmark the savegame formats?
+	if (gimme_arg(argc, argv, "-savetimes", 0) != NULL) {
+		show_save_times(welt);
+	}
+
+	// benchmark the passenger generation?
+	if (gimme_arg(argc, argv, "-paxtimes", 0) != NULL) {
+		const char *rounds = gimme_arg(argc, argv, "-paxtimes", 1);
+		show_passenger_times( welt, rounds != NULL  &&  rounds[0] != '-' ? atoi(rounds) : 10 );
+	}
+
 	// finish after a certain month? (must be entered decimal, i.e. 12*year+month
 	if(  gimme_arg(argc, argv, "-until", 0) != NULL  ) {
 		quit_month = atoi( gimme_arg(argc, argv, "-until", 1) );
@@ -1089,6 +1274,16 @@ DBG_MESSAGE("simmain","loadgame file found at %s",buffer);
 	}
 #endif
 
+	// measure the simulation speed and quit?
+	if(  gimme_arg(argc, argv, "-benchmark", 1) != NULL  ) {
+		const char *report_name = gimme_arg(argc, argv, "-benchmark", 2);
+		if(  report_name == NULL  ||  report_name[0] == '-'  ) {
+			report_name = "benchmark.txt";
+		}
+		run_benchmark( welt, loadgame.c_str(), atoi( gimme_arg(argc, argv, "-benchmark", 1) ), report_name );
+		umgebung_t::quit_simutrans = true;
+	}
+
 	welt->reset_timer();
 	if(  !umgebung_t::networkmode  &&  !umgebung_t::server  ) {
 #ifdef display_in_main
@@ -1184,6 +1379,10 @@ DBG_MESSAGE("simmain","loadgame file found at %s",buffer);
 	delete welt;
 	welt = NULL;
 
+	// an autosave may still be written, possibly using the worker threads
+	loadsave_t::wait_for_background_save();
+	worker_pool_t::finalise();
+
 	delete view;
 	view = 0;
 
@@ -170,6 +170,17 @@ uint32 sim_async_rand( uint32 max )
 	return (rand_seed >> 8) % max;
 }
 
+uint32 simrand_local(uint32 &state, const uint32 max)
+{
+	state *= 3141592621u;
+	state ++;
+	if(  max<=1  ) {
+		return 0;
+	}
+	return (state >> 8) % max;
+}
+
+
 static uint32 noise_seed = 0;
 
 uint32 setsimrand(uint32 seed,uint32 ns)
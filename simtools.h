@@ -27,6 +27,12 @@ uint32 simrand(const uint32 max, const char*);
 /* generates a random number on [0,0xFFFFFFFFu]-interval */
 uint32 simrand_plain(void);
 
+/* generates a random number on [0,max-1]-interval from its own state
+ * instead of the game sequence; for work split among threads, where
+ * every part is seeded from what it works on
+ */
+uint32 simrand_local(uint32 &state, const uint32 max);
+
 double perlin_noise_2D(const double x, const double y, const double persistence, const sint32 map_size = 512);
 
 // for netowrk debugging, i.e. finding hidden simrands in worng places
@@ -94,7 +94,9 @@ enum magic_numbers {
 	magic_replace=magic_halt_detail+65536,
 	magic_toolbar=magic_replace+65536,
 	magic_info_pointer=magic_toolbar+256,
-	magic_max = magic_info_pointer+843
+	// new ones only here, since open windows are saved with their magic number
+	magic_profile_frame_t=magic_info_pointer+843,
+	magic_max
 };
 
 // Haltezeit fr Nachrichtenfenster
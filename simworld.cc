@@ -92,6 +92,8 @@
 #include "utils/cbuffer_t.h"
 #include "utils/simstring.h"
 #include "utils/memory_rw.h"
+#include "utils/simprofile.h"
+#include "utils/worker_pool.h"
 
 #include "bauer/brueckenbauer.h"
 #include "bauer/tunnelbauer.h"
@@ -159,6 +161,9 @@ static std::string last_network_game;
 
 stringhashtable_tpl<karte_t::missing_level_t>missing_pak_names;
 
+const char *checklist_t::digest_names[checklist_t::DIGEST_COUNT] = { "convois", "halts", "factories", "players" };
+
+
 void checklist_t::rdwr(memory_rw_t *buffer)
 {
 	buffer->rdwr_long(random_seed);
@@ -170,13 +175,153 @@ void checklist_t::rdwr(memory_rw_t *buffer)
 		buffer->rdwr_long(industry_density_proportion);
 		buffer->rdwr_long(actual_industry_density);
 		buffer->rdwr_long(traffic);
+		for(  int i=0;  i<DIGEST_COUNT;  i++  ) {
+			buffer->rdwr_long(digest[i]);
+		}
 	}
 }
 
 
 int checklist_t::print(char *buffer, const char *entity) const
 {
-	return sprintf(buffer, "%s=[rand=%u halt=%u line=%u cnvy=%u ind_dns_prop=%u act_ind_dens=%u traffic=%u] ", entity, random_seed, halt_entry, line_entry, convoy_entry, industry_density_proportion, actual_industry_density, traffic);
+	return sprintf(buffer, "%s=[rand=%u halt=%u line=%u cnvy=%u ind_dns_prop=%u act_ind_dens=%u traffic=%u digest=%08x/%08x/%08x/%08x] ", entity, random_seed, halt_entry, line_entry, convoy_entry, industry_density_proportion, actual_industry_density, traffic,
+		digest[digest_convois], digest[digest_halts], digest[digest_factories], digest[digest_players]);
+}
+
+
+int checklist_t::print_digest_mismatch(char *buffer, const checklist_t &other) const
+{
+	int n = sprintf(buffer, "differing state:");
+	for(  int i=0;  i<DIGEST_COUNT;  i++  ) {
+		if(  digest[i]!=other.digest[i]  ) {
+			n += sprintf(buffer + n, " %s", digest_names[i]);
+		}
+	}
+	return n;
+}
+
+
+// mixes v into the hash h of an object
+static inline uint32 digest_mix(uint32 h, uint32 v)
+{
+	h ^= v;
+	h *= 0x01000193u;	// FNV prime
+	return h ^ (h >> 15);
+}
+
+static inline uint32 digest_mix(uint32 h, sint64 v)
+{
+	return digest_mix( digest_mix( h, (uint32)v ), (uint32)(v >> 32) );
+}
+
+static inline uint32 digest_mix(uint32 h, koord3d pos)
+{
+	return digest_mix( h, (uint32)(pos.x & 0xFFFF) | ((uint32)pos.y << 16) ) + pos.z;
+}
+
+
+void karte_t::calc_state_digest(uint32 *digest, uint32 slice, uint32 slices, FILE *dump)
+{
+	uint32 i = 0;
+	FOR(vector_tpl<convoihandle_t>, const cnv, convoi_array) {
+		if(  (i++ % slices)!=slice  ) {
+			continue;
+		}
+		uint32 h = digest_mix( 0x811C9DC5u, (uint32)cnv.get_id() );
+		h = digest_mix( h, (uint32)cnv->get_state() );
+		h = digest_mix( h, (uint32)cnv->get_akt_speed() );
+		if(  cnv->get_vehikel_anzahl()>0  ) {
+			h = digest_mix( h, cnv->front()->get_pos() );
+			h = digest_mix( h, (uint32)cnv->front()->get_route_index() );
+		}
+		digest[checklist_t::digest_convois] += h;
+		if(  dump  ) {
+			fprintf( dump, "convoi %u %08x\n", cnv.get_id(), h );
+		}
+	}
+
+	i = 0;
+	FOR(slist_tpl<halthandle_t>, const halt, haltestelle_t::get_alle_haltestellen()) {
+		if(  (i++ % slices)!=slice  ) {
+			continue;
+		}
+		uint32 h = digest_mix( 0x811C9DC5u, (uint32)halt.get_id() );
+		h = digest_mix( h, halt->get_finance_history(0, HALT_WAITING) );
+		h = digest_mix( h, halt->get_finance_history(0, HALT_ARRIVED) );
+		h = digest_mix( h, halt->get_finance_history(0, HALT_DEPARTED) );
+		digest[checklist_t::digest_halts] += h;
+		if(  dump  ) {
+			fprintf( dump, "halt %u %08x\n", halt.get_id(), h );
+		}
+	}
+
+	i = 0;
+	FOR(vector_tpl<fabrik_t*>, const fab, fab_list) {
+		if(  (i++ % slices)!=slice  ) {
+			continue;
+		}
+		uint32 h = digest_mix( 0x811C9DC5u, fab->get_pos() );
+		FOR(array_tpl<ware_production_t>, const& w, fab->get_eingang()) {
+			h = digest_mix( h, (uint32)w.menge );
+		}
+		FOR(array_tpl<ware_production_t>, const& w, fab->get_ausgang()) {
+			h = digest_mix( h, (uint32)w.menge );
+		}
+		digest[checklist_t::digest_factories] += h;
+		if(  dump  ) {
+			fprintf( dump, "factory %s %08x\n", fab->get_pos().get_str(), h );
+		}
+	}
+
+	for(  int i=0;  i<MAX_PLAYER_COUNT;  i++  ) {
+		if(  spieler[i]  &&  (i % slices)==slice  ) {
+			const uint32 h = digest_mix( digest_mix( 0x811C9DC5u, (uint32)i ), spieler[i]->get_konto() );
+			digest[checklist_t::digest_players] += h;
+			if(  dump  ) {
+				fprintf( dump, "player %i %08x\n", i, h );
+			}
+		}
+	}
+}
+
+
+void karte_t::update_state_digest()
+{
+	if(  !umgebung_t::networkmode  ) {
+		return;
+	}
+
+	FILE *dump = NULL;
+	if(  umgebung_t::dump_state_digest  ) {
+		char dump_name[64];
+		sprintf( dump_name, "digest-%s-%ld.txt", umgebung_t::server ? "server" : "client", steps );
+		dump = fopen( dump_name, "w" );
+		// keep only the recent ones
+		char old_name[64];
+		sprintf( old_name, "digest-%s-%ld.txt", umgebung_t::server ? "server" : "client", steps-LAST_CHECKLISTS_COUNT );
+		remove( old_name );
+	}
+
+	// each step hashes only one slice of the objects, and folds it into the running digest;
+	// so a difference in any object shows up within STATE_DIGEST_SLICES steps and stays
+	uint32 slice_digest[checklist_t::DIGEST_COUNT];
+	MEMZERO(slice_digest);
+	calc_state_digest( slice_digest, (uint32)steps % STATE_DIGEST_SLICES, STATE_DIGEST_SLICES, dump );
+	for(  int i=0;  i<checklist_t::DIGEST_COUNT;  i++  ) {
+		state_digest[i] = digest_mix( state_digest[i], slice_digest[i] );
+	}
+
+	if(  dump  ) {
+		fprintf( dump, "total %08x %08x %08x %08x\n", state_digest[0], state_digest[1], state_digest[2], state_digest[3] );
+		fclose( dump );
+	}
+}
+
+
+void karte_t::calc_full_state_digest(uint32 *digest)
+{
+	memset( digest, 0, sizeof(uint32)*checklist_t::DIGEST_COUNT );
+	calc_state_digest( digest, 0, 1, NULL );
 }
 
 
@@ -941,6 +1086,24 @@ void karte_t::create_rivers( sint16 number )
 
 
 
+// in the second phase of intercity road building, each town is only connected to this many of its nearest towns
+static const uint32 INTERCITY_ROAD_NEIGHBOURS = 8;
+
+struct intercity_candidate_t
+{
+	sint32 dist;
+	koord conn;	// the two towns, the smaller index first
+
+	static bool compare(const intercity_candidate_t &a, const intercity_candidate_t &b)
+	{
+		if(  a.dist != b.dist  ) {
+			return a.dist < b.dist;
+		}
+		return a.conn.x != b.conn.x ? a.conn.x < b.conn.x : a.conn.y < b.conn.y;
+	}
+};
+
+
 void karte_t::distribute_groundobjs_cities( settings_t const * const sets, sint16 old_x, sint16 old_y)
 {
 	DBG_DEBUG("karte_t::distribute_groundobjs_cities()","distributing groundobjs");
@@ -1183,95 +1346,182 @@ DBG_DEBUG("karte_t::distribute_groundobjs_cities()","prepare cities");
 			}
 
 			// get a default vehikel
-			route_t verbindung;
 			vehikel_t* test_driver;
 			vehikel_besch_t test_drive_besch(road_wt, 500, vehikel_besch_t::diesel );
 			test_driver = vehikelbauer_t::baue(koord3d(), spieler[1], NULL, &test_drive_besch);
 			test_driver->set_flag( ding_t::not_on_map );
 
 			bool ready=false;
-			uint8 phase=0;
-			// 0 - first phase: built minimum spanning tree (edge weights: city distance)
-			// 1 - second phase: try to complete the graph, avoid edges that
-			// == have similar length then already existing connection
-			// == lead to triangles with an angle >90 deg
-
-			while( phase < 2  ) {
+			// first phase: built minimum spanning tree (edge weights: city distance)
+			while(  !ready  ) {
 				ready = true;
 				koord conn = koord::invalid;
 				sint32 best = umgebung_t::intercity_road_length;
 
-				if(  phase == 0  ) {
-					// loop over all unconnected cities
-					for (int i = 0; i < settings.get_anzahl_staedte(); ++i) {
-						if(  city_flag[i] == conn_comp  ) {
-							// loop over all connections to connected cities
-							for (int j = old_anzahl_staedte; j < settings.get_anzahl_staedte(); ++j) {
-								if(  city_flag[j] == 0  ) {
-									ready=false;
-									if(  city_dist.at(i,j) < best  ) {
-										best = city_dist.at(i,j);
-										conn = koord(i,j);
-									}
+				// loop over all unconnected cities
+				for (int i = 0; i < settings.get_anzahl_staedte(); ++i) {
+					if(  city_flag[i] == conn_comp  ) {
+						// loop over all connections to connected cities
+						for (int j = old_anzahl_staedte; j < settings.get_anzahl_staedte(); ++j) {
+							if(  city_flag[j] == 0  ) {
+								ready=false;
+								if(  city_dist.at(i,j) < best  ) {
+									best = city_dist.at(i,j);
+									conn = koord(i,j);
 								}
 							}
 						}
 					}
-					// did we completed a connection component?
-					if(  !ready  &&  best == umgebung_t::intercity_road_length  ) {
-						// next component
-						conn_comp++;
-						// try the first not connected city
-						ready = true;
-						for (int i = old_anzahl_staedte; i < settings.get_anzahl_staedte(); ++i) {
-							if(  city_flag[i] ==0 ) {
-								city_flag[i] = conn_comp;
-								ready=false;
-								break;
-							}
+				}
+				// did we completed a connection component?
+				if(  !ready  &&  best == umgebung_t::intercity_road_length  ) {
+					// next component
+					conn_comp++;
+					// try the first not connected city
+					ready = true;
+					for (int i = old_anzahl_staedte; i < settings.get_anzahl_staedte(); ++i) {
+						if(  city_flag[i] ==0 ) {
+							city_flag[i] = conn_comp;
+							ready=false;
+							break;
 						}
 					}
 				}
-				else {
-					// loop over all unconnected cities
-					for (int i = 0; i < settings.get_anzahl_staedte(); ++i) {
-						for (int j = max(old_anzahl_staedte, i + 1);  j < settings.get_anzahl_staedte(); ++j) {
-							if(  city_dist.at(i,j) < best  &&  city_flag[i] == city_flag[j]  ) {
-								bool ok = true;
-								// is there a connection i..l..j ? forbid stumpfe winkel
-								for (int l = 0; l < settings.get_anzahl_staedte(); ++l) {
-									if(  city_flag[i] == city_flag[l]  &&  city_dist.at(i,l) == umgebung_t::intercity_road_length  &&  city_dist.at(j,l) == umgebung_t::intercity_road_length  ) {
-										// cosine < 0 ?
-										koord3d d1 = k[i]-k[l];
-										koord3d d2 = k[j]-k[l];
-										if(  d1.x*d2.x + d1.y*d2.y < 0  ) {
-											city_dist.at(i,j) = umgebung_t::intercity_road_length+1;
-											city_dist.at(j,i) = umgebung_t::intercity_road_length+1;
-											ok = false;
-											count ++;
-											break;
-										}
-									}
-								}
-								if(ok) {
-									ready = false;
-									best = city_dist.at(i,j);
-									conn = koord(i,j);
-								}
+				// valid connection?
+				if(  conn.x >= 0  ) {
+					bauigel.set_maximum(umgebung_t::intercity_road_length);
+					bauigel.calc_route(k[conn.x],k[conn.y]);
+					if(  bauigel.get_count() >= 2  ) {
+						bauigel.baue();
+						city_flag[ conn.y ] = conn_comp;
+						// mark as built
+						city_dist.at(conn) =  umgebung_t::intercity_road_length;
+						city_dist.at(conn.y, conn.x) =  umgebung_t::intercity_road_length;
+						count ++;
+					}
+					else {
+						// do not try again
+						city_dist.at(conn) =  umgebung_t::intercity_road_length+1;
+						city_dist.at(conn.y, conn.x) =  umgebung_t::intercity_road_length+1;
+						count ++;
+
+						// do not try to connect to this connected component again
+						for (int i = 0; i < settings.get_anzahl_staedte(); ++i) {
+							if (  city_flag[i] == conn_comp  && city_dist.at(i, conn.y)<umgebung_t::intercity_road_length) {
+								city_dist.at(i, conn.y) =  umgebung_t::intercity_road_length+1;
+								city_dist.at(conn.y, i) =  umgebung_t::intercity_road_length+1;
+								count++;
 							}
 						}
 					}
 				}
-				// valid connection?
-				if(  conn.x >= 0  ) {
+				//printf("IC-Road Progress : %d/%d\n", count, max_count);
+				// progress bar stuff
+				if(  is_display_init()  &&  count<=max_count  ) {
+					int const progress_count = 16 + 2 * new_anzahl_staedte + count * settings.get_anzahl_staedte() * 2 / max_count;
+					if(  old_progress_count != progress_count  ) {
+						display_progress(progress_count, max_display_progress );
+						old_progress_count = progress_count;
+					}
+				}
+			}
+
+			// second phase: try to complete the graph, avoid edges that
+			// == have similar length then already existing connection
+			// == lead to triangles with an angle >90 deg
+			// Only the edges to the nearest towns are tried: the others were almost always
+			// rejected, after two expensive route searches each.
+			const uint32 phase2_start = dr_time();
+			vector_tpl<intercity_candidate_t> candidates;
+			uint32 possible_pairs = 0;
+			for (int i = 0; i < settings.get_anzahl_staedte(); ++i) {
+				vector_tpl<intercity_candidate_t> nearest(INTERCITY_ROAD_NEIGHBOURS+1);
+				for (int j = 0; j < settings.get_anzahl_staedte(); ++j) {
+					if(  j == i  ||  max(i,j) < old_anzahl_staedte  ||  city_dist.at(i,j) >= umgebung_t::intercity_road_length  ||  city_flag[i] != city_flag[j]  ) {
+						continue;
+					}
+					if(  i < j  ) {
+						possible_pairs ++;
+					}
+					intercity_candidate_t c;
+					c.dist = city_dist.at(i,j);
+					c.conn = koord( min(i,j), max(i,j) );
+					nearest.insert_ordered( c, intercity_candidate_t::compare );
+					if(  nearest.get_count() > INTERCITY_ROAD_NEIGHBOURS  ) {
+						nearest.pop_back();
+					}
+				}
+				FOR(vector_tpl<intercity_candidate_t>, const& c, nearest) {
+					candidates.append( c );
+				}
+			}
+			// same order as searching the smallest distance each time, without duplicates
+			std::sort( candidates.begin(), candidates.end(), intercity_candidate_t::compare );
+			for(  sint32 c = candidates.get_count()-1;  c > 0;  c--  ) {
+				if(  candidates[c].conn == candidates[c-1].conn  ) {
+					candidates.remove_at( c );
+				}
+			}
+			count += possible_pairs - candidates.get_count();
+
+			// The test for an existing connection is done for several candidates at once,
+			// on the worker threads. The results are valid until the next road is built.
+			const uint32 batch_size = worker_pool_t::is_parallel() ? 4*(worker_pool_t::get_thread_count()+1) : 1;
+			route_t *verbindung = new route_t[batch_size];
+			route_batch_t connection_tests;
+			vector_tpl<uint32> batch(batch_size);
+			uint32 next = 0;
+			uint32 searches = 0;
+			while(  next < candidates.get_count()  ) {
+				connection_tests.clear();
+				batch.clear();
+				for(  uint32 c = next;  c < candidates.get_count()  &&  batch.get_count() < batch_size;  c++  ) {
+					if(  city_dist.at(candidates[c].conn) < umgebung_t::intercity_road_length  ) {
+						connection_tests.add( verbindung+batch.get_count(), k[candidates[c].conn.x], k[candidates[c].conn.y], test_driver, 0, 0, 0 );
+						batch.append( c );
+					}
+				}
+				if(  batch.empty()  ) {
+					break;
+				}
+				connection_tests.run( this );
+				searches += batch.get_count();
+
+				bool built = false;
+				for(  uint32 b = 0;  b < batch.get_count()  &&  !built;  b++  ) {
+					const koord conn = candidates[batch[b]].conn;
+					const int i = conn.x;
+					const int j = conn.y;
+					next = batch[b] + 1;
+
+					// is there a connection i..l..j ? forbid stumpfe winkel
+					bool ok = true;
+					for (int l = 0; l < settings.get_anzahl_staedte(); ++l) {
+						if(  city_flag[i] == city_flag[l]  &&  city_dist.at(i,l) == umgebung_t::intercity_road_length  &&  city_dist.at(j,l) == umgebung_t::intercity_road_length  ) {
+							// cosine < 0 ?
+							koord3d d1 = k[i]-k[l];
+							koord3d d2 = k[j]-k[l];
+							if(  d1.x*d2.x + d1.y*d2.y < 0  ) {
+								city_dist.at(i,j) = umgebung_t::intercity_road_length+1;
+								city_dist.at(j,i) = umgebung_t::intercity_road_length+1;
+								ok = false;
+								count ++;
+								break;
+							}
+						}
+					}
+					if(  !ok  ) {
+						continue;
+					}
+
 					// is there a connection already
-					const bool connected = (  phase==1  &&  verbindung.calc_route( this, k[conn.x], k[conn.y], test_driver, 0, 0, 0 )  );
+					const bool connected = connection_tests.is_found(b);
 					// build this connestion?
 					bool build = false;
 					// set appropriate max length for way builder
 					if(  connected  ) {
-						if(  2*verbindung.get_count() > (uint32)city_dist.at(conn)  ) {
-							bauigel.set_maximum(verbindung.get_count() / 2);
+						if(  2*verbindung[b].get_count() > (uint32)city_dist.at(conn)  ) {
+							bauigel.set_maximum(verbindung[b].get_count() / 2);
 							build = true;
 						}
 					}
@@ -1286,33 +1536,21 @@ DBG_DEBUG("karte_t::distribute_groundobjs_cities()","prepare cities");
 
 					if(  build  &&  bauigel.get_count() >= 2  ) {
 						bauigel.baue();
-						if (phase==0) {
-							city_flag[ conn.y ] = conn_comp;
-						}
 						// mark as built
 						city_dist.at(conn) =  umgebung_t::intercity_road_length;
 						city_dist.at(conn.y, conn.x) =  umgebung_t::intercity_road_length;
 						count ++;
+						// the remaining tests of this batch are outdated
+						built = true;
 					}
 					else {
 						// do not try again
 						city_dist.at(conn) =  umgebung_t::intercity_road_length+1;
 						city_dist.at(conn.y, conn.x) =  umgebung_t::intercity_road_length+1;
 						count ++;
-
-						if (phase==0) {
-							// do not try to connect to this connected component again
-							for (int i = 0; i < settings.get_anzahl_staedte(); ++i) {
-								if (  city_flag[i] == conn_comp  && city_dist.at(i, conn.y)<umgebung_t::intercity_road_length) {
-									city_dist.at(i, conn.y) =  umgebung_t::intercity_road_length+1;
-									city_dist.at(conn.y, i) =  umgebung_t::intercity_road_length+1;
-									count++;
-								}
-							}
-						}
 					}
 				}
-				//printf("IC-Road Progress : %d/%d\n", count, max_count);
+
 				// progress bar stuff
 				if(  is_display_init()  &&  count<=max_count  ) {
 					int const progress_count = 16 + 2 * new_anzahl_staedte + count * settings.get_anzahl_staedte() * 2 / max_count;
@@ -1321,12 +1559,10 @@ DBG_DEBUG("karte_t::distribute_groundobjs_cities()","prepare cities");
 						old_progress_count = progress_count;
 					}
 				}
-				// next phase?
-				if (ready) {
-					phase++;
-					ready = false;
-				}
 			}
+			delete [] verbindung;
+			dbg->message("karte_t::distribute_groundobjs_cities()", "intercity roads: tried %u of %u town pairs (%u connection tests) in %u ms",
+				candidates.get_count(), possible_pairs, searches, (uint32)(dr_time()-phase2_start) );
 			delete test_driver;
 		}
 	}
@@ -1567,6 +1803,35 @@ DBG_DEBUG("karte_t::init()","built timeline");
 }
 
 
+/**
+ * Computes the perlin heights of every stride-th grid column in [x_start, x_end)
+ * of the new part of the map. The height of a point depends only on its
+ * position and the settings, so the map is the same for any number of threads.
+ */
+class height_field_job_t : public worker_job_t
+{
+public:
+	karte_t *welt;
+	koord old_size;
+	sint32 map_size;
+	sint16 x_start;
+	sint16 x_end;
+	sint16 stride;
+
+	virtual void run()
+	{
+		settings_t const* const sets = &welt->get_settings();
+		for(  sint16 x = x_start;  x < x_end;  x += stride  ) {
+			for(  sint16 y = (x>=old_size.x)?0:old_size.y;  y<=welt->get_groesse_y();  y++  ) {
+				koord pos(x,y);
+				sint16 const h = karte_t::perlin_hoehe( sets, pos, old_size, map_size );
+				welt->set_grid_hgt( pos, h*Z_TILE_STEP );
+			}
+		}
+	}
+};
+
+
 void karte_t::enlarge_map(settings_t const* sets, sint8 const* const h_field)
 {
 	sint16 new_groesse_x = sets->get_groesse_x();
@@ -1655,20 +1920,31 @@ void karte_t::enlarge_map(settings_t const* sets, sint8 const* const h_field)
 			// otherwise neagtive offsets may occur, so we cache only non-rotated maps
 			init_perlin_map(new_groesse_x,new_groesse_y);
 		}
-		int next_progress, old_progress = 0;
-		// loop only new tiles:
-		for(  sint16 x = 0;  x<=new_groesse_x;  x++  ) {
-			for(  sint16 y = (x>=old_x)?0:old_y;  y<=new_groesse_y;  y++  ) {
-				koord pos(x,y);
-				sint16 const h = perlin_hoehe(&settings, pos, koord(old_x, old_y), map_size);
-				set_grid_hgt( pos, h*Z_TILE_STEP);
-			}
-			next_progress = (x*16)/new_groesse_x;
-			if ( next_progress > old_progress ){
-				old_progress = next_progress;
-				display_progress(old_progress, max_display_progress);
-			}
-		}
+		// loop only new tiles, in 16 parts for the progress bar;
+		// the columns of each part are shared by the main thread and the workers
+		const uint32 jobs = min( (uint32)worker_pool_t::get_thread_count()+1, (uint32)new_groesse_x+1 );
+		height_field_job_t *job = new height_field_job_t[jobs];
+		for(  int progress = 1;  progress<=16;  progress++  ) {
+			const sint16 x_start = ((new_groesse_x+1)*(progress-1))/16;
+			const sint16 x_end = ((new_groesse_x+1)*progress)/16;
+			for(  uint32 j=0;  j<jobs;  j++  ) {
+				job[j].welt = this;
+				job[j].old_size = koord(old_x, old_y);
+				job[j].map_size = map_size;
+				job[j].x_start = x_start+j;
+				job[j].x_end = x_end;
+				job[j].stride = jobs;
+			}
+			for(  uint32 j=1;  j<jobs;  j++  ) {
+				worker_pool_t::submit( job+j );
+			}
+			job[0].run();
+			for(  uint32 j=1;  j<jobs;  j++  ) {
+				worker_pool_t::wait( job+j );
+			}
+			display_progress(progress, max_display_progress);
+		}
+		delete [] job;
 		exit_perlin_map();
 	}
 
@@ -1803,6 +2079,7 @@ karte_t::karte_t() :
 	marker(0,0)
 {
 	is_shutting_down = false;
+	MEMZERO(state_digest);
 
 	// length of day and other time stuff
 	ticks_per_world_month_shift = 20;
@@ -3048,6 +3325,7 @@ bool karte_t::sync_remove(sync_steppable *obj)	// entfernt alle dinge == obj aus
  */
 void karte_t::sync_step(long delta_t, bool sync, bool display )
 {
+	profile_scope_t profile( profile_t::sync_step );
 	set_random_mode( SYNC_STEP_RANDOM );
 	haltestelle_t::pedestrian_limit = 0;
 	if(sync) {
@@ -3256,10 +3534,15 @@ void karte_t::neuer_monat()
 	DBG_MESSAGE("karte_t::neuer_monat()","sync_step %u objects", sync_list.get_count() );
 
 	// this should be done before a map update, since the map may want an update of the way usage
+	// (the ways roll their statistics over when they are next used)
 //	DBG_MESSAGE("karte_t::neuer_monat()","ways");
-	FOR(slist_tpl<weg_t*>, const w, weg_t::get_alle_wege()) {
-		w->neuer_monat();
-	}
+	weg_t::neuer_monat();
+
+	// Only the ways are rolled over lazily. Everything below still runs in this step:
+	// convoys, factories and players book against each other's finances of the month
+	// that has just ended, the electricity totals of factories and cities decide on new
+	// industries below, and halts must have rolled over before the paths are refreshed.
+	// Spreading these over several steps would book parts of a month into the wrong one.
 
 //	DBG_MESSAGE("karte_t::neuer_monat()","depots");
 	// Bernd Gabriel - call new month for depots	
@@ -3677,6 +3960,8 @@ void karte_t::notify_record( convoihandle_t cnv, sint32 max_speed, koord pos )
 
 void karte_t::step()
 {
+	profile_t::next_step();
+	profile_scope_t profile( profile_t::step );
 	DBG_DEBUG4("karte_t::step", "start step");
 	unsigned long time = dr_time();
 
@@ -3782,29 +4067,61 @@ void karte_t::step()
 	INT_CHECK("karte_t::step 2");
 	
 	DBG_DEBUG4("karte_t::step 4", "step %d convois", convoi_array.get_count());
-	// since convois will be deleted during stepping, we need to step backwards
-	for(sint32 i=convoi_array.get_count()-1;  i>=0;  i--  ) {
-		convoihandle_t cnv = convoi_array[i];
-		cnv->step();
-		if((i&7)==0) {
-			INT_CHECK("karte_t::step 5");
+	{
+		profile_scope_t profile( profile_t::convoys );
+		// First the route searches of all convois about to search a new route, all at once
+		// and on the worker threads if there are any. The world does not change meanwhile,
+		// and this is done for any number of threads, so the results are network safe.
+		route_batch_t convoi_routes;
+		vector_tpl<convoihandle_t> routing_convois;
+		for(sint32 i=convoi_array.get_count()-1;  i>=0;  i--  ) {
+			if(  convoi_array[i]->request_route(convoi_routes)  ) {
+				routing_convois.append( convoi_array[i] );
+			}
+		}
+		convoi_routes.run(this);
+		for(  uint32 j=0;  j<routing_convois.get_count();  j++  ) {
+			routing_convois[j]->set_requested_route_found( convoi_routes.is_found(j) );
+		}
+
+		// then the steps themselves, which take the routes found above
+		// since convois will be deleted during stepping, we need to step backwards
+		for(sint32 i=convoi_array.get_count()-1;  i>=0;  i--  ) {
+			convoihandle_t cnv = convoi_array[i];
+			cnv->step();
+			if((i&7)==0) {
+				INT_CHECK("karte_t::step 5");
+			}
+		}
+
+		// routes not picked up (e.g. after a schedule change) are not kept
+		FOR(vector_tpl<convoihandle_t>, const cnv, routing_convois) {
+			if(  cnv.is_bound()  ) {
+				cnv->clear_requested_route();
+			}
 		}
 	}
 
 	// now step all towns (to generate passengers)
 	DBG_DEBUG4("karte_t::step 6", "step cities");
 	sint64 bev=0;
-	FOR(weighted_vector_tpl<stadt_t*>, const i, stadt) {
-		i->step(delta_t);
-		bev += i->get_finance_history_month(0, HIST_CITICENS);
+	{
+		profile_scope_t profile( profile_t::cities );
+		FOR(weighted_vector_tpl<stadt_t*>, const i, stadt) {
+			i->step(delta_t);
+			bev += i->get_finance_history_month(0, HIST_CITICENS);
+		}
 	}
 
 	// the inhabitants stuff
 	finance_history_month[0][WORLD_CITICENS] = bev;
 
 	DBG_DEBUG4("karte_t::step", "step factories");
-	FOR(vector_tpl<fabrik_t*>, const f, fab_list) {
-		f->step(delta_t);
+	{
+		profile_scope_t profile( profile_t::factories );
+		FOR(vector_tpl<fabrik_t*>, const f, fab_list) {
+			f->step(delta_t);
+		}
 	}
 
 	finance_history_year[0][WORLD_FACTORIES] = finance_history_month[0][WORLD_FACTORIES] = fab_list.get_count();
@@ -3824,7 +4141,10 @@ void karte_t::step()
 	}
 
 	DBG_DEBUG4("karte_t::step", "step halts");
-	haltestelle_t::step_all();
+	{
+		profile_scope_t profile( profile_t::halts );
+		haltestelle_t::step_all();
+	}
 
 	// ok, next step
 	INT_CHECK("karte_t::step 6");
@@ -3870,6 +4190,8 @@ void karte_t::step()
 		printf("Number of connected clients changed to %u", last_clients);
 #endif
 	}
+
+	update_state_digest();
 	DBG_DEBUG4("karte_t::step", "end");
 }
 
@@ -4403,26 +4725,32 @@ bool karte_t::play_sound_area_clipped(koord const pos, uint16 const idx) const
 
 
 
-void karte_t::speichern(const char *filename, const char *version_str, const char *ex_version_str, bool silent )
+void karte_t::speichern(const char *filename, const char *version_str, const char *ex_version_str, bool silent, loadsave_stream_t *stream )
 {
 DBG_MESSAGE("karte_t::speichern()", "saving game to '%s'", filename);
 
 	loadsave_t  file;
 
 	display_show_load_pointer( true );
+	const uint32 start_time = dr_time();
 	loadsave_t::mode_t mode = loadsave_t::save_mode;
 	if(umgebung_t::networkmode && !umgebung_t::server && mode == loadsave_t::bzip2)
 	{
 		// Make local saving/loading faster in network mode.
 		mode = loadsave_t::zipped;
 	}
-	if(!file.wr_open(filename, loadsave_t::save_mode, umgebung_t::objfilename.c_str(), version_str, ex_version_str )) {
+	// only autosaves, all other saves are either followed by loading the game or the user waits for a result
+	const bool background = silent  &&  umgebung_t::background_save  &&  stream==NULL;
+	// only files in blocks can be copied to a stream while writing
+	const loadsave_t::mode_t file_mode = stream ? loadsave_t::zipped_blocks : loadsave_t::save_mode;
+	if(!file.wr_open(filename, file_mode, umgebung_t::objfilename.c_str(), version_str, ex_version_str, background, stream )) {
 		create_win(new news_img("Kann Spielstand\nnicht speichern.\n"), w_info, magic_none);
 		dbg->error("karte_t::speichern()","cannot open file for writing! check permissions!");
 	}
 	else {
 		speichern(&file,silent);
 		const char *success = file.close();
+		dbg->message("karte_t::speichern()", "game stopped for %u ms while saving%s", dr_time()-start_time, background ? " (writing continues in the background)" : "" );
 		if(success) {
 			static char err_str[512];
 			sprintf( err_str, translator::translate("Error during saving:\n%s"), success );
@@ -4443,6 +4771,7 @@ DBG_MESSAGE("karte_t::speichern()", "saving game to '%s'", filename);
 
 void karte_t::speichern(loadsave_t *file,bool silent)
 {
+	profile_scope_t profile( profile_t::save );
 	bool needs_redraw = false;
 
 DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "start");
@@ -4492,6 +4821,7 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "start");
 			settings.set_player_type(i, spieler_t::EMPTY);
 		}
 	}
+	file->begin_section("settings");
 	settings.rdwr(file);
 	for(  int i=0;  i<MAX_PLAYER_COUNT;  i++  ) {
 		settings.set_player_type(i, old_sp[i]);
@@ -4530,6 +4860,7 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "start");
 		}
 	}
 
+	file->begin_section("cities");
 	FOR(weighted_vector_tpl<stadt_t*>, const i, stadt) {
 		i->rdwr(file);
 		if(silent) {
@@ -4539,6 +4870,12 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "start");
 DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved cities ok");
 
 	for(int j=0; j<get_groesse_y(); j++) {
+		if(  (j%64)==0  ) {
+			// the tiles are saved by rows, so a section per band of 64 rows
+			char section[32];
+			sprintf( section, "tiles %d", j );
+			file->begin_section(section);
+		}
 		for(int i=0; i<get_groesse_x(); i++) {
 			plan[i+j*cached_groesse_gitter_x].rdwr(this, file, koord(i,j) );
 		}
@@ -4559,6 +4896,7 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved tiles");
 	DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved hgt");
 	}
 
+	file->begin_section("factories");
 	sint32 fabs = fab_list.get_count();
 	file->rdwr_long(fabs);
 	FOR(vector_tpl<fabrik_t*>, const f, fab_list) {
@@ -4569,6 +4907,7 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved tiles");
 	}
 DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved fabs");
 
+	file->begin_section("halts");
 	sint32 haltcount=haltestelle_t::get_alle_haltestellen().get_count();
 	file->rdwr_long(haltcount);
 	FOR(slist_tpl<halthandle_t>, const s, haltestelle_t::get_alle_haltestellen()) {
@@ -4577,6 +4916,7 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved fabs");
 DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved stops");
 
 	// svae number of convois
+	file->begin_section("convoys");
 	if(  file->get_version()>=101000  ) {
 		uint16 i=convoi_array.get_count();
 		file->rdwr_short(i);
@@ -4593,6 +4933,7 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved stops");
 	}
 DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved %i convois",convoi_array.get_count());
 
+	file->begin_section("players");
 	for(int i=0; i<MAX_PLAYER_COUNT; i++) {
 // **** REMOVE IF SOON! *********
 		if(file->get_version()<101000) {
@@ -4686,6 +5027,10 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved messages");
 	file->rdwr_byte( active_player_nr );
 	rdwr_all_win(file);
 
+	if(  file->is_zipped_blocks()  ) {
+		add_savegame_info(file);
+	}
+
 	if(needs_redraw) 
 	{
 		update_map();
@@ -4693,6 +5038,52 @@ DBG_MESSAGE("karte_t::speichern(loadsave_t *file)", "saved messages");
 }
 
 
+void karte_t::add_savegame_info(loadsave_t *file) const
+{
+	cbuffer_t buf;
+	buf.printf( "size=%dx%d\n", get_groesse_x(), get_groesse_y() );
+	buf.printf( "date=%d/%d\n", letztes_jahr, letzter_monat+1 );
+	buf.printf( "cities=%d\n", stadt.get_count() );
+	buf.printf( "factories=%d\n", fab_list.get_count() );
+	buf.printf( "halts=%d\n", haltestelle_t::get_alle_haltestellen().get_count() );
+	buf.printf( "convoys=%d\n", convoi_array.get_count() );
+	for(  int i=0;  i<MAX_PLAYER_COUNT;  i++  ) {
+		if(  spieler[i]  ) {
+			buf.printf( "player=%d %s\n", i, spieler[i]->get_name() );
+		}
+	}
+	file->add_info( "summary", std::string( (const char *)buf, buf.len() ) );
+
+	// terrain of every step-th tile: width, height (16 bit little endian), then the colours by rows
+	const sint16 step = max( 1, (max( get_groesse_x(), get_groesse_y() )+127) / 128 );
+	const uint16 w = get_groesse_x() / step, h = get_groesse_y() / step;
+	std::string thumbnail;
+	thumbnail.reserve( 4 + w*h );
+	thumbnail += (char)(w & 0xFF);
+	thumbnail += (char)(w >> 8);
+	thumbnail += (char)(h & 0xFF);
+	thumbnail += (char)(h >> 8);
+	for(  uint16 y=0;  y<h;  y++  ) {
+		for(  uint16 x=0;  x<w;  x++  ) {
+			const koord k( x*step, y*step );
+			const grund_t *gr = lookup_kartenboden(k);
+			uint8 color = COL_BLACK;
+			if(  gr  ) {
+				if(  gr->get_typ()==grund_t::fundament  ) {
+					color = COL_GREY3;
+				}
+				else {
+					const sint16 hgt = gr->ist_wasser() ? lookup_hgt(k) : gr->get_hoehe();
+					color = reliefkarte_t::calc_hoehe_farbe( hgt/Z_TILE_STEP, get_grundwasser()/Z_TILE_STEP );
+				}
+			}
+			thumbnail += (char)color;
+		}
+	}
+	file->add_info( "thumbnail", thumbnail );
+}
+
+
 // store missing obj during load and their severity
 void karte_t::add_missing_paks( const char *name, missing_level_t level )
 {
@@ -4713,6 +5104,9 @@ bool karte_t::laden(const char *filename)
 	mute_sound(true);
 	display_show_load_pointer(true);
 	loadsave_t file;
+	// set, if a network game is loaded while it is received
+	network_game_stream_t *join_stream = NULL;
+	bool joining = false;
 
 	// clear hash table with missing paks (may cause some small memory loss though)
 	missing_pak_names.clear();
@@ -4725,7 +5119,7 @@ bool karte_t::laden(const char *filename)
 			network_core_shutdown();
 		}
 		chdir( umgebung_t::user_dir );
-		const char *err = network_connect(filename+4, this);
+		const char *err = network_connect(filename+4, this, join_stream);
 		if(err) {
 			create_win( new news_img(err), w_info, magic_none );
 			display_show_load_pointer(false);
@@ -4734,6 +5128,7 @@ bool karte_t::laden(const char *filename)
 		}
 		else {
 			umgebung_t::networkmode = true;
+			joining = true;
 			name.printf( "client%i-network.sve", network_get_client_id() );
 			restore_player_nr = strcmp( last_network_game.c_str(), filename )==0;
 			if(  !restore_player_nr  ) {
@@ -4774,7 +5169,7 @@ bool karte_t::laden(const char *filename)
 		name.append(filename);
 	}
 
-	if(!file.rd_open(name)) {
+	if(!(join_stream ? file.rd_open(join_stream) : file.rd_open(name))) {
 
 		if(  (sint32)file.get_version()==-1  ||  file.get_version()>loadsave_t::int_version(SAVEGAME_VER_NR, NULL, NULL).version  ) {
 			create_win( new news_img("WRONGSAVE"), w_info, magic_none );
@@ -4791,6 +5186,24 @@ DBG_MESSAGE("karte_t::laden()","Savegame version is %d", file.get_version());
 
 		laden(&file);
 
+		if(  join_stream  ) {
+			// the rest of the join follows the game on the socket
+			file.close();
+			const char *err = join_stream->finish();
+			delete join_stream;
+			join_stream = NULL;
+			if(  err==NULL  ) {
+				err = network_finish_join(this);
+			}
+			if(  err  ) {
+				dbg->warning( "karte_t::laden", err );
+				network_disconnect();
+			}
+		}
+		else if(  joining  ) {
+			network_finish_join(this);
+		}
+
 		if(  umgebung_t::networkmode  ) {
 			clear_command_queue();
 		}
@@ -4882,6 +5295,12 @@ DBG_MESSAGE("karte_t::laden()","Savegame version is %d", file.get_version());
 		werkzeug_t::update_toolbars(this);
 		set_werkzeug( werkzeug_t::general_tool[WKZ_ABFRAGE], get_active_player() );
 	}
+	if(  join_stream  ) {
+		// the game from the server could not be read
+		delete join_stream;
+		network_core_shutdown();
+		step_mode = NORMAL;
+	}
 	settings.set_filename(filename);
 	display_show_load_pointer(false);
 
@@ -4896,6 +5315,7 @@ DBG_MESSAGE("karte_t::laden()","Savegame version is %d", file.get_version());
 // handles the actual loading
 void karte_t::laden(loadsave_t *file)
 {
+	profile_scope_t profile( profile_t::load );
 	char buf[80];
 
 	intr_disable();
@@ -5500,6 +5920,9 @@ DBG_MESSAGE("karte_t::laden()", "%d factories loaded", fab_list.get_count());
 	// Added by : Knightly
 	path_explorer_t::full_instant_refresh();
 
+	// server and clients start the running digest at the same state
+	MEMZERO(state_digest);
+
 	clear_random_mode(LOAD_RANDOM);
 
 	dbg->warning("karte_t::laden()","loaded savegame from %i/%i, next month=%i, ticks=%i (per month=1<<%i)",letzter_monat,letztes_jahr,next_month_ticks,ticks,karte_t::ticks_per_world_month_shift);
@@ -6382,7 +6805,7 @@ bool karte_t::interactive(uint32 quit_month)
 						// out of sync => drop client (but we can only compare if nwt->last_sync_step is not too old)
 						else if(  is_checklist_available(nwt->last_sync_step)  &&  LCHKLST(nwt->last_sync_step)!=nwt->last_checklist  ) {
 							// lost synchronisation -> server kicks client out actively
-							char buf[256];
+							char buf[512];
 							const int offset = LCHKLST(nwt->last_sync_step).print(buf, "server");
 							nwt->last_checklist.print(buf + offset, "initiator");
 							dbg->warning("karte_t::interactive", "kicking client due to checklist mismatch : sync_step=%u %s", nwt->last_sync_step, buf);
@@ -6461,12 +6884,14 @@ bool karte_t::interactive(uint32 quit_month)
 					// this was the random number at the previous sync step on the server
 					const checklist_t &server_checklist = nwcheck->server_checklist;
 					const uint32 server_sync_step = nwcheck->server_sync_step;
-					char buf[256];
+					char buf[512];
 					const int offset = server_checklist.print(buf, "server");
 					LCHKLST(server_sync_step).print(buf + offset, "client");
 					dbg->warning("karte_t::interactive", "sync_step=%u  %s", server_sync_step, buf);
 					if( LCHKLST(server_sync_step)!=server_checklist  ) {
-						dbg->warning("karte_t::interactive", "disconnecting due to checklist mismatch" );
+						char mismatch[128];
+						LCHKLST(server_sync_step).print_digest_mismatch(mismatch, server_checklist);
+						dbg->warning("karte_t::interactive", "disconnecting due to checklist mismatch (%s)", mismatch );
 						printf("Desync due to checklist mismatch\nsync_step=%u  %s", server_sync_step, buf);
 						network_disconnect();
 #ifdef DEBUG_SIMRAND_CALLS
@@ -6481,7 +6906,7 @@ bool karte_t::interactive(uint32 quit_month)
 						nwc_tool_t *nwt = dynamic_cast<nwc_tool_t *>(nwc);
 						if(  is_checklist_available(nwt->last_sync_step)  &&  LCHKLST(nwt->last_sync_step)!=nwt->last_checklist  ) {
 							// lost synchronisation ...
-							char buf[256];
+							char buf[512];
 							const int offset = nwt->last_checklist.print(buf, "server");
 							LCHKLST(nwt->last_sync_step).print(buf + offset, "executor");
 							dbg->warning("karte_t::interactive", "skipping command due to checklist mismatch : sync_step=%u %s", nwt->last_sync_step, buf);
@@ -6552,10 +6977,10 @@ bool karte_t::interactive(uint32 quit_month)
 						network_frame_count = 0;
 					}
 					sync_steps = steps * settings.get_frames_per_step() + network_frame_count;
-					LCHKLST(sync_steps) = checklist_t(get_random_seed(), halthandle_t::get_next_check(), linehandle_t::get_next_check(), convoihandle_t::get_next_check(), industry_density_proportion, actual_industry_density,finance_history_year[0][WORLD_CITYCARS] );
+					LCHKLST(sync_steps) = checklist_t(get_random_seed(), halthandle_t::get_next_check(), linehandle_t::get_next_check(), convoihandle_t::get_next_check(), industry_density_proportion, actual_industry_density,finance_history_year[0][WORLD_CITYCARS], state_digest );
 
 #ifdef DEBUG_SIMRAND_CALLS
-					char buf[256];
+					char buf[512];
 					LCHKLST(sync_steps).print(buf, "chklist");
 					dbg->warning("karte_t::interactive", "sync_step=%u  %s", sync_steps, buf);
 #endif
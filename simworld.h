@@ -13,6 +13,10 @@
 #ifndef simworld_h
 #define simworld_h
 
+#include <stdio.h>
+#include <string.h>
+
+#include "macros.h"
 #include "simconst.h"
 #include "simtypes.h"
 #include "simunits.h"
@@ -54,9 +58,19 @@ class tunnel_besch_t;
 class network_world_command_t;
 class ware_besch_t;
 class memory_rw_t;
+class loadsave_stream_t;
 
 struct checklist_t
 {
+	/**
+	 * The digest has one hash of the state of each part of the world
+	 * (sum of the hashes of its objects, so the order does not matter).
+	 * It is a running digest: every step adds some of the objects, and
+	 * it starts again when a game is loaded, see karte_t::update_state_digest().
+	 */
+	enum { digest_convois=0, digest_halts, digest_factories, digest_players, DIGEST_COUNT };
+	static const char *digest_names[DIGEST_COUNT];
+
 	uint32 random_seed;
 	uint16 halt_entry;
 	uint16 line_entry;
@@ -66,18 +80,27 @@ struct checklist_t
 	uint32 actual_industry_density;
 	uint32 traffic;
 
-	checklist_t() : random_seed(0), halt_entry(0), line_entry(0), convoy_entry(0), industry_density_proportion(0), actual_industry_density(0), traffic(0) { }
-	checklist_t(uint32 _random_seed, uint16 _halt_entry, uint16 _line_entry, uint16 _convoy_entry, uint32 _industry_denisty_proportion, uint32 _actual_industry_density, uint32 _traffic)
-		: random_seed(_random_seed), halt_entry(_halt_entry), line_entry(_line_entry), convoy_entry(_convoy_entry), industry_density_proportion(_industry_denisty_proportion), actual_industry_density(_actual_industry_density), traffic(_traffic) { }
+	uint32 digest[DIGEST_COUNT];
+
+	checklist_t() : random_seed(0), halt_entry(0), line_entry(0), convoy_entry(0), industry_density_proportion(0), actual_industry_density(0), traffic(0) { MEMZERO(digest); }
+	checklist_t(uint32 _random_seed, uint16 _halt_entry, uint16 _line_entry, uint16 _convoy_entry, uint32 _industry_denisty_proportion, uint32 _actual_industry_density, uint32 _traffic, const uint32 *_digest)
+		: random_seed(_random_seed), halt_entry(_halt_entry), line_entry(_line_entry), convoy_entry(_convoy_entry), industry_density_proportion(_industry_denisty_proportion), actual_industry_density(_actual_industry_density), traffic(_traffic)
+	{
+		memcpy( digest, _digest, sizeof(digest) );
+	}
 
 	bool operator == (const checklist_t &other) const
 	{
-		return ( random_seed==other.random_seed && halt_entry==other.halt_entry && line_entry==other.line_entry && convoy_entry==other.convoy_entry && industry_density_proportion == other.industry_density_proportion && actual_industry_density == other.actual_industry_density);
+		return ( random_seed==other.random_seed && halt_entry==other.halt_entry && line_entry==other.line_entry && convoy_entry==other.convoy_entry && industry_density_proportion == other.industry_density_proportion && actual_industry_density == other.actual_industry_density
+			&& memcmp( digest, other.digest, sizeof(digest) )==0 );
 	}
 	bool operator != (const checklist_t &other) const { return !( (*this)==other ); }
 
 	void rdwr(memory_rw_t *buffer);
 	int print(char *buffer, const char *entity) const;
+
+	// names of the parts of the world whose digests differ
+	int print_digest_mismatch(char *buffer, const checklist_t &other) const;
 };
 
 
@@ -363,6 +386,26 @@ private:
 #define LAST_CHECKLISTS_COUNT 64
 	checklist_t last_checklists[LAST_CHECKLISTS_COUNT];
 #define LCHKLST(x) (last_checklists[(x) % LAST_CHECKLISTS_COUNT])
+
+	// state of the world after the last step, for the checklists
+	uint32 state_digest[checklist_t::DIGEST_COUNT];
+
+	// objects are added to the running digest in that many slices, one per step
+#define STATE_DIGEST_SLICES (16)
+
+	/**
+	 * Adds the hashes of the objects whose index is slice (modulo slices) to digest.
+	 * With dump, the hash of every such object is also written to it.
+	 */
+	void calc_state_digest(uint32 *digest, uint32 slice, uint32 slices, FILE *dump);
+
+	/**
+	 * Adds the next slice of the objects to state_digest (only in network games).
+	 * With umgebung_t::dump_state_digest the hash of every object is also
+	 * written to digest-<server|client>-<step>.txt, to find out which one
+	 * desynced.
+	 */
+	void update_state_digest();
 	uint8  network_frame_count;
 	uint32 fix_ratio_frame_time; // set in reset_timer()
 
@@ -426,6 +469,12 @@ private:
 	 */
 	void speichern(loadsave_t *file,bool silent);
 
+	/**
+	 * summary and terrain thumbnail for the table of contents of the savegame,
+	 * so tools need not load the game (see loadsave_t::add_info)
+	 */
+	void add_savegame_info(loadsave_t *file) const;
+
 	/**
 	 * internal loading method
 	 * @author Hj. Malthaner
@@ -1220,9 +1269,10 @@ public:
 	/**
 	 * Saves the map to a file
 	 * @param filename name of the file to write
+	 * @param stream if given, receives a copy of everything written to the file
 	 * @author Hj. Malthaner
 	 */
-	void speichern(const char *filename, const char *version, const char *ex_version, bool silent);
+	void speichern(const char *filename, const char *version, const char *ex_version, bool silent, loadsave_stream_t *stream=NULL);
 
 	/**
 	 * Loads a map from a file
@@ -1260,6 +1310,10 @@ public:
 	const checklist_t& get_last_checklist() const { return LCHKLST(sync_steps); }
 	uint32 get_last_checklist_sync_step() const { return sync_steps; }
 
+	// digest of the current state, also outside network games (for benchmarks)
+	// digest of all objects as they are now (unlike the running digest of network games)
+	void calc_full_state_digest(uint32 *digest);
+
 	void command_queue_append(network_world_command_t*) const;
 
 	void clear_command_queue() const;
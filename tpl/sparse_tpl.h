@@ -60,7 +60,7 @@ class sparse_tpl
 			resize_data(0);
 		}
 
-		koord& get_size() const {
+		const koord& get_size() const {
 			return size;
 		}
 
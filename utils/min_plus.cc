@@ -0,0 +1,151 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#include "min_plus.h"
+
+#if !defined(USE_C)  &&  ( defined(__SSE2__)  ||  defined(_M_X64)  ||  (defined(_M_IX86_FP)  &&  _M_IX86_FP >= 2) )
+#	define MIN_PLUS_SSE2
+#	include <emmintrin.h>
+#endif
+
+// AVX2 is only compiled for this function, and only used if the processor has it
+#if defined(MIN_PLUS_SSE2)  &&  GCC_ATLEAST(4, 9)  &&  !defined(__clang__)  &&  ( defined(__x86_64__)  ||  defined(__i386__) )
+#	define MIN_PLUS_AVX2
+#	include <immintrin.h>
+#endif
+
+
+typedef uint32 (*min_plus_kernel_t)(const uint16, const uint16 *const, const uint16 *const, const uint32, uint16 *const, uint16 *const);
+
+
+static uint32 relax_c(const uint16 base_time, const uint16 *const via_time, const uint16 *const target, const uint32 count,
+                      uint16 *const row_time, uint16 *const improved)
+{
+	uint32 improved_count = 0;
+	for(  uint32 k = 0;  k < count;  k++  ) {
+		const uint16 candidate = (uint16)(base_time + via_time[k]);
+		uint16 &current = row_time[ target[k] ];
+		if(  candidate < current  ) {
+			current = candidate;
+			improved[improved_count++] = (uint16)k;
+		}
+	}
+	return improved_count;
+}
+
+
+#ifdef MIN_PLUS_SSE2
+static uint32 relax_sse2(const uint16 base_time, const uint16 *const via_time, const uint16 *const target, const uint32 count,
+                         uint16 *const row_time, uint16 *const improved)
+{
+	const __m128i base = _mm_set1_epi16( (short)base_time );
+	const __m128i zero = _mm_setzero_si128();
+	uint16 current[8];
+	uint16 candidate[8];
+	uint32 improved_count = 0;
+	uint32 k = 0;
+	for(  ;  k + 8 <= count;  k += 8  ) {
+		for(  int i = 0;  i < 8;  i++  ) {
+			current[i] = row_time[ target[k + i] ];
+		}
+		const __m128i cand = _mm_add_epi16( base, _mm_loadu_si128( (const __m128i *)(via_time + k) ) );
+		// current - candidate saturates to 0 unless the candidate is smaller (SSE2 has no unsigned compare)
+		const __m128i not_better = _mm_cmpeq_epi16( _mm_subs_epu16( _mm_loadu_si128( (const __m128i *)current ), cand ), zero );
+		const uint32 mask = ~(uint32)_mm_movemask_epi8( not_better ) & 0xFFFFu;
+		if(  mask  ) {
+			_mm_storeu_si128( (__m128i *)candidate, cand );
+			for(  int i = 0;  i < 8;  i++  ) {
+				if(  mask & (1u << (i * 2))  ) {
+					row_time[ target[k + i] ] = candidate[i];
+					improved[improved_count++] = (uint16)(k + i);
+				}
+			}
+		}
+	}
+	const uint32 rest = relax_c( base_time, via_time + k, target + k, count - k, row_time, improved + improved_count );
+	for(  uint32 i = 0;  i < rest;  i++  ) {
+		improved[improved_count + i] += (uint16)k;
+	}
+	return improved_count + rest;
+}
+#endif
+
+
+#ifdef MIN_PLUS_AVX2
+__attribute__((target("avx2")))
+static uint32 relax_avx2(const uint16 base_time, const uint16 *const via_time, const uint16 *const target, const uint32 count,
+                         uint16 *const row_time, uint16 *const improved)
+{
+	const __m256i base = _mm256_set1_epi16( (short)base_time );
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i low_half = _mm256_set1_epi32( 0xFFFF );
+	uint16 candidate[16];
+	uint32 improved_count = 0;
+	uint32 k = 0;
+	for(  ;  k + 16 <= count;  k += 16  ) {
+		// gather 32 bits at each target and keep the lower (little endian) 16 bits
+		const __m256i index_lo = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)(target + k) ) );
+		const __m256i index_hi = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)(target + k + 8) ) );
+		const __m256i current_lo = _mm256_and_si256( _mm256_i32gather_epi32( (const int *)row_time, index_lo, 2 ), low_half );
+		const __m256i current_hi = _mm256_and_si256( _mm256_i32gather_epi32( (const int *)row_time, index_hi, 2 ), low_half );
+		// packing works within 128 bit lanes -> restore the order of the 64 bit blocks
+		const __m256i current = _mm256_permute4x64_epi64( _mm256_packus_epi32( current_lo, current_hi ), 0xD8 );
+
+		const __m256i cand = _mm256_add_epi16( base, _mm256_loadu_si256( (const __m256i *)(via_time + k) ) );
+		const __m256i not_better = _mm256_cmpeq_epi16( _mm256_subs_epu16( current, cand ), zero );
+		const uint32 mask = ~(uint32)_mm256_movemask_epi8( not_better );
+		if(  mask  ) {
+			_mm256_storeu_si256( (__m256i *)candidate, cand );
+			for(  int i = 0;  i < 16;  i++  ) {
+				if(  mask & (1u << (i * 2))  ) {
+					row_time[ target[k + i] ] = candidate[i];
+					improved[improved_count++] = (uint16)(k + i);
+				}
+			}
+		}
+	}
+	const uint32 rest = relax_sse2( base_time, via_time + k, target + k, count - k, row_time, improved + improved_count );
+	for(  uint32 i = 0;  i < rest;  i++  ) {
+		improved[improved_count + i] += (uint16)k;
+	}
+	return improved_count + rest;
+}
+#endif
+
+
+static const char *kernel_name = "C";
+
+static min_plus_kernel_t select_kernel()
+{
+#ifdef MIN_PLUS_AVX2
+	// may run before main(), so the cpu model must be initialised explicitly
+	__builtin_cpu_init();
+	if(  __builtin_cpu_supports( "avx2" )  ) {
+		kernel_name = "AVX2";
+		return relax_avx2;
+	}
+#endif
+#ifdef MIN_PLUS_SSE2
+	kernel_name = "SSE2";
+	return relax_sse2;
+#else
+	return relax_c;
+#endif
+}
+
+static const min_plus_kernel_t kernel = select_kernel();
+
+
+uint32 min_plus_relax(const uint16 base_time, const uint16 *const via_time, const uint16 *const target, const uint32 count,
+                      uint16 *const row_time, uint16 *const improved)
+{
+	return kernel( base_time, via_time, target, count, row_time, improved );
+}
+
+
+const char *min_plus_get_kernel_name()
+{
+	return kernel_name;
+}
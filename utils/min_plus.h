@@ -0,0 +1,33 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#ifndef utils_min_plus_h
+#define utils_min_plus_h
+
+#include "../simtypes.h"
+
+
+/**
+ * Min-plus relaxation of one row of a path matrix over one transfer, as
+ * done by the path explorer. For each k in [0, count):
+ *
+ *   candidate = base_time + via_time[k]   (16 bit arithmetic, wrapping)
+ *   if candidate < row_time[target[k]] it is stored there and k is
+ *   appended to improved.
+ *
+ * Returns the number of entries written to improved. The targets must be
+ * distinct, and row_time must have one readable entry after the largest
+ * target index (the vectorised kernels read 32 bits per target).
+ *
+ * The fastest kernel supported by the processor (AVX2, SSE2 or plain C)
+ * is selected when the program starts.
+ */
+uint32 min_plus_relax(const uint16 base_time, const uint16 *const via_time, const uint16 *const target, const uint32 count,
+                      uint16 *const row_time, uint16 *const improved);
+
+// name of the selected kernel, for diagnostics
+const char *min_plus_get_kernel_name();
+
+#endif
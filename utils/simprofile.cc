@@ -0,0 +1,232 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../macros.h"
+#include "cbuffer_t.h"
+#include "simthread.h"
+#include "simprofile.h"
+
+
+bool profile_t::enabled = false;
+uint64 profile_t::time_us[SECTION_COUNT];
+uint32 profile_t::calls[SECTION_COUNT];
+uint64 profile_t::counter[COUNTER_COUNT];
+
+uint32 profile_t::history_pos = 0;
+uint32 profile_t::history_count = 1;
+uint32 profile_t::history_time_us[HISTORY_STEPS][SECTION_COUNT];
+uint32 profile_t::history_counter[HISTORY_STEPS][COUNTER_COUNT];
+uint32 profile_t::histogram[SECTION_COUNT][BUCKET_COUNT];
+
+#ifdef MULTI_THREAD
+// route searches run on the worker threads
+static simthread_mutex_t profile_mutex;
+#define PROFILE_LOCK SIMTHREAD_LOCK( profile_mutex )
+#else
+#define PROFILE_LOCK
+#endif
+
+
+void profile_t::reset()
+{
+	PROFILE_LOCK;
+	MEMZERO(time_us);
+	MEMZERO(calls);
+	MEMZERO(counter);
+	MEMZERO(history_time_us);
+	MEMZERO(history_counter);
+	MEMZERO(histogram);
+	history_pos = 0;
+	history_count = 1;
+}
+
+
+void profile_t::record(section_t section, uint64 duration_us)
+{
+	uint32 bucket = 0;
+	while(  bucket < BUCKET_COUNT-1  &&  (duration_us >> bucket) != 0  ) {
+		bucket++;
+	}
+
+	PROFILE_LOCK;
+	time_us[section] += duration_us;
+	calls[section] ++;
+	history_time_us[history_pos][section] += duration_us < 0xFFFFFFFFu ? (uint32)duration_us : 0xFFFFFFFFu;
+	histogram[section][bucket] ++;
+}
+
+
+void profile_t::add_count(counter_t c, uint32 n)
+{
+	PROFILE_LOCK;
+	counter[c] += n;
+	history_counter[history_pos][c] += n;
+}
+
+
+void profile_t::next_step()
+{
+	if(  !enabled  ) {
+		return;
+	}
+	PROFILE_LOCK;
+	history_pos = (history_pos + 1) % HISTORY_STEPS;
+	MEMZERO(history_time_us[history_pos]);
+	MEMZERO(history_counter[history_pos]);
+	if(  history_count < HISTORY_STEPS  ) {
+		history_count ++;
+	}
+	if(  history_pos == 0  ) {
+		// older calls count less and less
+		for(  int i = 0;  i < SECTION_COUNT;  i++  ) {
+			for(  int b = 0;  b < BUCKET_COUNT;  b++  ) {
+				histogram[i][b] >>= 1;
+			}
+		}
+	}
+}
+
+
+const char *profile_t::get_name(section_t section)
+{
+	static const char *const names[SECTION_COUNT] = {
+		"step", "sync_step", "path_explorer", "convoys", "route_search", "cities", "step_passagiere", "factories", "halts", "save", "load"
+	};
+	return names[section];
+}
+
+
+const char *profile_t::get_name(counter_t c)
+{
+	static const char *const names[COUNTER_COUNT] = { "route_nodes", "routes_failed", "pax_mail_generated" };
+	return names[c];
+}
+
+
+uint64 profile_t::get_time_us()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	if(  frequency.QuadPart == 0  ) {
+		QueryPerformanceFrequency( &frequency );
+	}
+	LARGE_INTEGER now;
+	QueryPerformanceCounter( &now );
+	return (uint64)( (now.QuadPart / frequency.QuadPart) * 1000000 + ((now.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart );
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#else
+	// no monotonic clock (old Mac OS X): wall clock, may jump when it is set
+	struct timeval now;
+	gettimeofday( &now, NULL );
+	return (uint64)now.tv_sec * 1000000 + now.tv_usec;
+#endif
+}
+
+
+// upper limit of the duration of the given fraction of the calls
+static uint64 get_percentile_us(const uint32 *buckets, uint32 count, double fraction)
+{
+	uint32 total = 0;
+	for(  uint32 b = 0;  b < count;  b++  ) {
+		total += buckets[b];
+	}
+	uint32 sum = 0;
+	for(  uint32 b = 0;  b < count;  b++  ) {
+		sum += buckets[b];
+		if(  sum > 0  &&  sum >= fraction * total  ) {
+			return (uint64)1 << b;
+		}
+	}
+	return 0;
+}
+
+
+static void append_time(cbuffer_t &buf, uint64 us)
+{
+	if(  us < 10000  ) {
+		buf.printf( "%u us", (uint32)us );
+	}
+	else {
+		buf.printf( "%.1f ms", us / 1000.0 );
+	}
+}
+
+
+void profile_t::get_report(cbuffer_t &buf)
+{
+	PROFILE_LOCK;
+	// the current step is not finished yet
+	const uint32 steps = history_count > 1 ? history_count - 1 : 0;
+	buf.printf( "Profiling %s, last %u steps:\n\n", enabled ? "enabled" : "disabled", steps );
+
+	for(  int i = 0;  i < SECTION_COUNT;  i++  ) {
+		if(  calls[i] == 0  ) {
+			continue;
+		}
+		uint64 sum = 0;
+		uint32 max_step = 0;
+		for(  uint32 s = 1;  s <= steps;  s++  ) {
+			const uint32 t = history_time_us[(history_pos + HISTORY_STEPS - s) % HISTORY_STEPS][i];
+			sum += t;
+			if(  t > max_step  ) {
+				max_step = t;
+			}
+		}
+		buf.printf( "%s: ", get_name( (section_t)i ) );
+		append_time( buf, steps ? sum / steps : 0 );
+		buf.append( " per step (max " );
+		append_time( buf, max_step );
+		buf.printf( "), %u calls, ", calls[i] );
+		append_time( buf, time_us[i] );
+		buf.append( " in total\n    calls: 50% < " );
+		append_time( buf, get_percentile_us( histogram[i], BUCKET_COUNT, 0.5 ) );
+		buf.append( ", 90% < " );
+		append_time( buf, get_percentile_us( histogram[i], BUCKET_COUNT, 0.9 ) );
+		buf.append( ", 99% < " );
+		append_time( buf, get_percentile_us( histogram[i], BUCKET_COUNT, 0.99 ) );
+		buf.append( "\n" );
+	}
+	buf.append( "\n" );
+
+	for(  int c = 0;  c < COUNTER_COUNT;  c++  ) {
+		uint64 sum = 0;
+		uint32 max_step = 0;
+		for(  uint32 s = 1;  s <= steps;  s++  ) {
+			const uint32 n = history_counter[(history_pos + HISTORY_STEPS - s) % HISTORY_STEPS][c];
+			sum += n;
+			if(  n > max_step  ) {
+				max_step = n;
+			}
+		}
+		buf.printf( "%s: %u per step (max %u), %.0f in total\n", get_name( (counter_t)c ), (uint32)(steps ? sum / steps : 0), max_step, (double)counter[c] );
+	}
+}
+
+
+bool profile_t::dump(const char *filename)
+{
+	FILE *f = fopen( filename, "w" );
+	if(  f == NULL  ) {
+		return false;
+	}
+	cbuffer_t buf;
+	get_report( buf );
+	fputs( buf, f );
+	fclose( f );
+	return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#ifndef utils_simprofile_h
+#define utils_simprofile_h
+
+#include "../simtypes.h"
+
+class cbuffer_t;
+
+
+/**
+ * Wall time spent in the subsystems of the simulation and some counters.
+ * Nothing is measured unless profile_t::enabled is set (by the -benchmark
+ * command line option, the profiling window or the "profile" command of
+ * nettool); otherwise a scope costs one test of a flag.
+ *
+ * Besides the totals since the last reset(), the time per step of the last
+ * HISTORY_STEPS steps and a histogram of the duration of single calls are
+ * kept. The histogram is halved every HISTORY_STEPS steps, so it shows
+ * mostly the recent past.
+ *
+ * Sections may be nested (step contains most of the others). Sections and
+ * counters may be updated from worker threads. A call of step_passagiere is
+ * one batch: all buildings of a city due in a step.
+ */
+class profile_t
+{
+public:
+	enum section_t { step=0, sync_step, path_explorer, convoys, route_search, cities, step_passagiere, factories, halts, save, load, SECTION_COUNT };
+	enum counter_t { route_nodes=0, routes_failed, pax_mail_generated, COUNTER_COUNT };
+
+	enum { HISTORY_STEPS=128, BUCKET_COUNT=24 };
+
+	static bool enabled;
+
+	// accumulated since the last reset()
+	static uint64 time_us[SECTION_COUNT];
+	static uint32 calls[SECTION_COUNT];
+	static uint64 counter[COUNTER_COUNT];
+
+private:
+	// index of the current step in the history
+	static uint32 history_pos;
+	// number of valid steps in the history
+	static uint32 history_count;
+	static uint32 history_time_us[HISTORY_STEPS][SECTION_COUNT];
+	static uint32 history_counter[HISTORY_STEPS][COUNTER_COUNT];
+
+	// bucket b counts the calls taking less than 2^b microseconds (but not less than 2^(b-1))
+	static uint32 histogram[SECTION_COUNT][BUCKET_COUNT];
+
+	static void add_count(counter_t c, uint32 n);
+
+public:
+	static void reset();
+
+	// adds a call of the given duration, see profile_scope_t
+	static void record(section_t section, uint64 duration_us);
+
+	static void count(counter_t c, uint32 n=1)
+	{
+		if(  enabled  ) {
+			add_count( c, n );
+		}
+	}
+
+	// starts the next step in the history, called at the beginning of karte_t::step()
+	static void next_step();
+
+	static const char *get_name(section_t section);
+	static const char *get_name(counter_t c);
+
+	// monotonic clock in microseconds (not related to dr_time())
+	static uint64 get_time_us();
+
+	// human readable table of all data
+	static void get_report(cbuffer_t &buf);
+
+	// writes get_report() to a file; false if the file could not be written
+	static bool dump(const char *filename);
+};
+
+
+/**
+ * Adds the time until the end of the enclosing block to a section.
+ */
+class profile_scope_t
+{
+private:
+	const profile_t::section_t section;
+	const bool active;
+	const uint64 start;
+
+public:
+	profile_scope_t(profile_t::section_t s) :
+		section(s),
+		active(profile_t::enabled),
+		start(profile_t::enabled ? profile_t::get_time_us() : 0)
+	{ }
+
+	~profile_scope_t()
+	{
+		if(  active  ) {
+			profile_t::record( section, profile_t::get_time_us() - start );
+		}
+	}
+};
+
+#endif
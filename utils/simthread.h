@@ -0,0 +1,68 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ *
+ * Thin wrapper around the threading primitives. Everything is compiled
+ * away unless MULTI_THREAD is defined (see config.template).
+ */
+
+#ifndef utils_simthread_h
+#define utils_simthread_h
+
+#ifdef MULTI_THREAD
+
+#include <pthread.h>
+
+class simthread_mutex_t
+{
+private:
+	pthread_mutex_t mutex;
+
+	simthread_mutex_t(const simthread_mutex_t&);
+	simthread_mutex_t& operator=(const simthread_mutex_t&);
+
+public:
+	simthread_mutex_t() { pthread_mutex_init( &mutex, NULL ); }
+
+	// a recursive mutex may be locked again by the thread holding it
+	explicit simthread_mutex_t(bool recursive)
+	{
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init( &attr );
+		if(  recursive  ) {
+			pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+		}
+		pthread_mutex_init( &mutex, &attr );
+		pthread_mutexattr_destroy( &attr );
+	}
+	~simthread_mutex_t() { pthread_mutex_destroy( &mutex ); }
+
+	void lock() { pthread_mutex_lock( &mutex ); }
+	void unlock() { pthread_mutex_unlock( &mutex ); }
+
+	pthread_mutex_t *get_raw() { return &mutex; }
+};
+
+// locks the mutex for the lifetime of the object
+class simthread_lock_t
+{
+private:
+	simthread_mutex_t &mutex;
+
+	simthread_lock_t(const simthread_lock_t&);
+	simthread_lock_t& operator=(const simthread_lock_t&);
+
+public:
+	simthread_lock_t(simthread_mutex_t &m) : mutex(m) { mutex.lock(); }
+	~simthread_lock_t() { mutex.unlock(); }
+};
+
+#define SIMTHREAD_LOCK(m) simthread_lock_t simthread_lock_guard_(m)
+
+#else
+
+#define SIMTHREAD_LOCK(m)
+
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#include "../simdebug.h"
+#include "../tpl/vector_tpl.h"
+#include "simthread.h"
+#include "worker_pool.h"
+
+// hard upper limit for additional threads
+#define MAX_WORKER_THREADS (32)
+
+uint8 worker_pool_t::thread_count = 0;
+
+
+#ifdef MULTI_THREAD
+
+static pthread_t worker_threads[MAX_WORKER_THREADS];
+
+static simthread_mutex_t pool_mutex;
+static pthread_cond_t job_available_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t job_done_cond = PTHREAD_COND_INITIALIZER;
+
+// FIFO of jobs waiting for a worker; guarded by pool_mutex
+static vector_tpl<worker_job_t *> job_queue;
+
+static bool shutdown_requested = false;
+
+
+void *worker_pool_t::thread_main(void *)
+{
+	pool_mutex.lock();
+	for(;;) {
+		while(  job_queue.empty()  &&  !shutdown_requested  ) {
+			pthread_cond_wait( &job_available_cond, pool_mutex.get_raw() );
+		}
+		if(  job_queue.empty()  ) {
+			// shutdown requested and nothing left to do
+			break;
+		}
+		worker_job_t *job = job_queue[0];
+		job_queue.remove_at(0);
+		job->state = worker_job_t::job_running;
+		pool_mutex.unlock();
+
+		job->run();
+
+		pool_mutex.lock();
+		job->state = worker_job_t::job_done;
+		pthread_cond_broadcast( &job_done_cond );
+	}
+	pool_mutex.unlock();
+	return NULL;
+}
+
+#endif
+
+
+void worker_pool_t::initialise(uint8 total_threads)
+{
+	finalise();
+#ifdef MULTI_THREAD
+	uint8 wanted = total_threads > 1 ? total_threads - 1 : 0;
+	if(  wanted > MAX_WORKER_THREADS  ) {
+		wanted = MAX_WORKER_THREADS;
+	}
+	shutdown_requested = false;
+	for(  uint8 i = 0;  i < wanted;  i++  ) {
+		if(  pthread_create( &worker_threads[i], NULL, thread_main, NULL )  ) {
+			dbg->warning( "worker_pool_t::initialise()", "could only start %i of %i worker threads", i, wanted );
+			break;
+		}
+		thread_count++;
+	}
+	DBG_MESSAGE( "worker_pool_t::initialise()", "%i worker threads", thread_count );
+#else
+	(void)total_threads;
+#endif
+}
+
+
+void worker_pool_t::finalise()
+{
+#ifdef MULTI_THREAD
+	if(  thread_count == 0  ) {
+		return;
+	}
+	pool_mutex.lock();
+	shutdown_requested = true;
+	pthread_cond_broadcast( &job_available_cond );
+	pool_mutex.unlock();
+	// the workers run all jobs still queued before they exit
+	for(  uint8 i = 0;  i < thread_count;  i++  ) {
+		pthread_join( worker_threads[i], NULL );
+	}
+	assert( job_queue.empty() );
+	thread_count = 0;
+#endif
+}
+
+
+void worker_pool_t::submit(worker_job_t *job)
+{
+	assert( job->state == worker_job_t::job_idle );
+#ifdef MULTI_THREAD
+	if(  thread_count > 0  ) {
+		SIMTHREAD_LOCK( pool_mutex );
+		job->state = worker_job_t::job_queued;
+		job_queue.append( job );
+		pthread_cond_signal( &job_available_cond );
+		return;
+	}
+#endif
+	job->state = worker_job_t::job_queued;
+}
+
+
+bool worker_pool_t::is_finished(worker_job_t *job)
+{
+#ifdef MULTI_THREAD
+	if(  thread_count > 0  ) {
+		SIMTHREAD_LOCK( pool_mutex );
+		return job->state == worker_job_t::job_done;
+	}
+#endif
+	return job->state == worker_job_t::job_done;
+}
+
+
+void worker_pool_t::wait(worker_job_t *job)
+{
+	if(  job->state == worker_job_t::job_idle  ) {
+		return;
+	}
+#ifdef MULTI_THREAD
+	pool_mutex.lock();
+	if(  job->state == worker_job_t::job_queued  ) {
+		// nobody picked it up yet => do it ourselves
+		job_queue.remove( job );
+		job->state = worker_job_t::job_running;
+		pool_mutex.unlock();
+		job->run();
+		pool_mutex.lock();
+	}
+	else {
+		while(  job->state != worker_job_t::job_done  ) {
+			pthread_cond_wait( &job_done_cond, pool_mutex.get_raw() );
+		}
+	}
+	job->state = worker_job_t::job_idle;
+	pool_mutex.unlock();
+#else
+	if(  job->state == worker_job_t::job_queued  ) {
+		job->run();
+	}
+	job->state = worker_job_t::job_idle;
+#endif
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Simutrans project under the artistic license.
+ * (see license.txt)
+ */
+
+#ifndef utils_worker_pool_h
+#define utils_worker_pool_h
+
+#include "../simtypes.h"
+
+
+/**
+ * A self-contained piece of work which can be handed to the worker pool.
+ * run() must neither touch the world nor any other object which the main
+ * thread may modify until the job has been waited for.
+ */
+class worker_job_t
+{
+	friend class worker_pool_t;
+
+public:
+	enum job_state_t { job_idle = 0, job_queued, job_running, job_done };
+
+private:
+	job_state_t state;
+
+public:
+	worker_job_t() : state(job_idle) { }
+	virtual ~worker_job_t() { }
+
+	virtual void run() = 0;
+
+	// true between submit() and wait()
+	bool is_pending() const { return state != job_idle; }
+};
+
+
+/**
+ * A fixed number of worker threads processing worker_job_t objects in
+ * submission order. Results are only ever picked up by wait(), which the
+ * caller issues at a point of its own choosing, so the outcome does not
+ * depend on thread timing.
+ *
+ * Without MULTI_THREAD (or with umgebung_t::num_threads==1) there are no
+ * threads: submitted jobs are run by the caller when they are waited for.
+ */
+class worker_pool_t
+{
+private:
+	static uint8 thread_count;
+
+	static void *thread_main(void *);
+
+public:
+	// the main thread counts as one of the threads
+	static void initialise(uint8 total_threads);
+	static void finalise();
+
+	// number of additional worker threads (0 = run everything synchronously)
+	static uint8 get_thread_count() { return thread_count; }
+	static bool is_parallel() { return thread_count > 0; }
+
+	static void submit(worker_job_t *job);
+
+	// true if a submitted job has been completed and wait() will not block
+	static bool is_finished(worker_job_t *job);
+
+	/**
+	 * Blocks until the job has run. A job still in the queue is taken out
+	 * and run by the caller instead of waiting for a free worker.
+	 * Afterwards the job is idle again and may be reused or deleted.
+	 */
+	static void wait(worker_job_t *job);
+};
+
+#endif
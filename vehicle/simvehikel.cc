@@ -1231,7 +1231,14 @@ vehikel_t::vehikel_t(karte_t *welt) :
 
 bool vehikel_t::calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t* route)
 {
-	return route->calc_route(welt, start, ziel, this, max_speed, cnv != NULL ? cnv->get_heaviest_vehicle() : get_sum_weight(), 0);
+	prepare_route_search();
+	return route->calc_route(welt, start, ziel, this, max_speed, get_route_weight(), get_route_tile_length(), 0xFFFFFFFF, true);
+}
+
+
+uint32 vehikel_t::get_route_weight() const
+{
+	return cnv != NULL ? cnv->get_heaviest_vehicle() : get_sum_weight();
 }
 
 
@@ -2561,7 +2568,7 @@ automobil_t::automobil_t(karte_t *welt, loadsave_t *file, bool is_first, bool is
 
 
 // need to reset halt reservation (if there was one)
-bool automobil_t::calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t* route)
+void automobil_t::prepare_route_search()
 {
 	assert(cnv);
 	// free target reservation
@@ -2573,8 +2580,12 @@ bool automobil_t::calc_route(koord3d start, koord3d ziel, sint32 max_speed, rout
 		}
 	}
 	target_halt = halthandle_t();	// no block reserved
-	const uint32 routing_weight = cnv != NULL ? cnv->get_heaviest_vehicle() : get_sum_weight();
-	return route->calc_route(welt, start, ziel, this, max_speed, routing_weight, cnv->get_tile_length());
+}
+
+
+sint32 automobil_t::get_route_tile_length() const
+{
+	return cnv->get_tile_length();
 }
 
 
@@ -3195,7 +3206,7 @@ void waggon_t::set_convoi(convoi_t *c)
 }
 
 // need to reset halt reservation (if there was one)
-bool waggon_t::calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t* route)
+void waggon_t::prepare_route_search()
 {
 	if (ist_erstes && route_index < cnv->get_route()->get_count())
 	{
@@ -3205,7 +3216,6 @@ bool waggon_t::calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t
 				dummy, target_halt.is_bound() ? 100000 : 1, false, true);
 	}
 	target_halt = halthandle_t(); // no block reserved
-	return route->calc_route(welt, start, ziel, this, max_speed, cnv != NULL ? cnv->get_heaviest_vehicle() : get_sum_weight(), 8888 /*cnv->get_tile_length()*/ );
 }
 
 
@@ -347,6 +347,19 @@ public:
 	void darf_rauchen(bool yesno ) { rauchen = yesno;}
 
 	virtual bool calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t* route);
+
+	/**
+	* calc_route() is prepare_route_search() followed by the search itself with
+	* the weight and tile length below; split so that the search may be done by
+	* a worker thread (see convoi_t::request_route())
+	*/
+	virtual void prepare_route_search() {}
+	virtual sint32 get_route_tile_length() const { return 0; }
+	uint32 get_route_weight() const;
+	// false if calc_route() does more than that, or if the search would see
+	// a different way than after prepare_route_search() (reserved stop)
+	virtual bool can_route_in_parallel() const { return !target_halt.is_bound(); }
+
 	uint16 get_route_index() const {return route_index;}
 	const koord3d get_pos_prev() const {return pos_prev;}
 
@@ -615,7 +628,9 @@ public:
 	// how expensive to go here (for way search)
 	virtual int get_kosten(const grund_t *, const sint32, koord) const;
 
-	virtual bool calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t* route);
+	// need to reset halt reservation (if there was one)
+	virtual void prepare_route_search();
+	virtual sint32 get_route_tile_length() const;
 
 	virtual bool ist_weg_frei(int &restart_speed, bool second_check );
 
@@ -660,7 +675,8 @@ public:
 	virtual waytype_t get_waytype() const { return track_wt; }
 
 	// since we might need to unreserve previously used blocks, we must do this before calculation a new route
-	bool calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t* route);
+	virtual void prepare_route_search();
+	virtual sint32 get_route_tile_length() const { return 8888; }
 
 	// how expensive to go here (for way search)
 	virtual int get_kosten(const grund_t *, const sint32, koord) const;
@@ -877,6 +893,9 @@ public:
 
 	bool calc_route(koord3d start, koord3d ziel, sint32 max_speed, route_t* route);
 
+	// the runway searches need the world marker
+	virtual bool can_route_in_parallel() const { return false; }
+
 	typ get_typ() const { return aircraft; }
 
 	schedule_t * erzeuge_neuen_fahrplan() const;